@@ -7,6 +7,8 @@
 #include "util.h"
 
 static const char DB_DOMAIN = 'd';
+static const char DB_EXPIRY = 'e';
+static const char DB_UNDO = 'u';
 
 static const char DB_INTERNAL = 'I';
 static const char db_height = 'H';
@@ -14,15 +16,169 @@ static const char db_last_change = 'L';
 static const char db_corruption = 'C';
 static const char db_reindexing = 'R';
 static const char db_version = 'V';
-static const int db_version_num = 1;
+static const int db_version_num = 2;
 static const int db_default_height = -10;
+// undo data is kept for this many blocks, deeper reorganizations fall back to flagging a possible corruption
+static const int db_undo_depth = 1000;
+
+CBDNSDB::CBDNSDB(size_t nCacheSize, bool fMemory, bool fWipe) :
+    CDBWrapper(GetDataDir() / "bdns", nCacheSize, fMemory, fWipe),
+    blockBatch(*this),
+    blockTransaction(*this, blockBatch),
+    nBlockHeight(-1),
+    fBlockCorruption(false),
+    fDryRun(false),
+    nCacheHits(0),
+    nCacheMisses(0)
+{
+}
+
+void CBDNSDB::BeginBlock(const int &nHeight) {
+    LOCK(cs);
+
+    if (nBlockHeight != -1)
+        LogPrintf("BlockchainDNS -- %s: changes of block %d were never committed\n", __func__, nBlockHeight);
+
+    blockTransaction.Clear();
+    blockBatch.Clear();
+    mapBlockUndo.clear();
+    nBlockHeight = nHeight;
+    fBlockCorruption = false;
+    blockUndo.vRecords.clear();
+    blockUndo.vExpired.clear();
+    blockUndo.vExpiryAdded.clear();
+
+    if (fDryRun)
+        return;
+
+    blockUndo.nPrevLastChangeHeight = GetLastChangeHeight();
+
+    // the new height is only written by CommitBlock() so the index never holds a partially applied block
+    fBlockCorruption = IsHeightChangeSuspicious(nHeight, blockUndo.nPrevLastChangeHeight);
+}
+
+bool CBDNSDB::CommitBlock() {
+    LOCK(cs);
+
+    if (nBlockHeight == -1)
+        return false;
+
+    if (fDryRun) {
+        blockTransaction.Clear();
+        mapBlockUndo.clear();
+        nBlockHeight = -1;
+        fBlockCorruption = false;
+        return true;
+    }
+
+    for (const auto& p : mapBlockUndo)
+        blockUndo.vRecords.push_back(p.second);
+
+    blockTransaction.Commit();
+    blockBatch.Write(std::make_pair(DB_UNDO, nBlockHeight), blockUndo);
+    blockBatch.Erase(std::make_pair(DB_UNDO, nBlockHeight - db_undo_depth));
+    if (!mapBlockUndo.empty())
+        blockBatch.Write(std::make_pair(DB_INTERNAL, db_last_change), nBlockHeight);
+    blockBatch.Write(std::make_pair(DB_INTERNAL, db_height), nBlockHeight);
+    if (fBlockCorruption)
+        blockBatch.Write(std::make_pair(DB_INTERNAL, db_corruption), 1);
+
+    LogPrint("bdns", "BlockchainDNS -- %s: block %d changed %u records, batch size %u\n", __func__, nBlockHeight, mapBlockUndo.size(), blockBatch.SizeEstimate());
+
+    bool ret = WriteBatch(blockBatch);
+
+    for (const auto& p : mapBlockUndo) {
+        recordCache.erase(p.first);
+        missingCache.erase(p.first);
+    }
 
-CBDNSDB::CBDNSDB(size_t nCacheSize, bool fMemory, bool fWipe) : CDBWrapper(GetDataDir() / "bdns", nCacheSize, fMemory, fWipe) {}
+    blockBatch.Clear();
+    mapBlockUndo.clear();
+    nBlockHeight = -1;
+    fBlockCorruption = false;
+
+    if (!ret)
+        WriteCorruptionState(true);
+
+    return ret;
+}
+
+bool CBDNSDB::UndoBlock(const int &nHeight) {
+    LOCK(cs);
+
+    if (fDryRun)
+        return true;
+
+    BDNSBlockUndo undo;
+    bool fHaveUndo = Read(std::make_pair(DB_UNDO, nHeight), undo);
+
+    if (fHaveUndo) {
+        CDBBatch batch(*this);
+
+        // the restored records, last change height and height of the index are written at once
+        for (const auto& undoRecord : undo.vRecords) {
+            recordCache.erase(undoRecord.bdnsName);
+            missingCache.erase(undoRecord.bdnsName);
+
+            if (undoRecord.fExisted)
+                batch.Write(std::make_pair(DB_DOMAIN, undoRecord.bdnsName), undoRecord.prevRecord);
+            else
+                batch.Erase(std::make_pair(DB_DOMAIN, undoRecord.bdnsName));
+        }
+
+        for (const auto& bdnsName : undo.vExpired)
+            batch.Write(std::make_pair(DB_EXPIRY, std::make_pair(nHeight, bdnsName)), 1);
+        for (const auto& expiry : undo.vExpiryAdded)
+            batch.Erase(std::make_pair(DB_EXPIRY, expiry));
+
+        batch.Write(std::make_pair(DB_INTERNAL, db_last_change), undo.nPrevLastChangeHeight);
+        batch.Write(std::make_pair(DB_INTERNAL, db_height), nHeight - 1);
+        if (IsHeightChangeSuspicious(nHeight - 1, undo.nPrevLastChangeHeight))
+            batch.Write(std::make_pair(DB_INTERNAL, db_corruption), 1);
+        batch.Erase(std::make_pair(DB_UNDO, nHeight));
+
+        if (WriteBatch(batch))
+            return true;
+
+        fHaveUndo = false;
+    }
+
+    // without undo data the height check flags a possible corruption if the block changed any records
+    if (!SetHeight(nHeight - 1))
+        LogPrintf("BlockchainDNS -- %s: failed to set the BDNS height\n", __func__);
+
+    return fHaveUndo;
+}
+
+void CBDNSDB::SetDryRun(bool fDryRunIn) {
+    LOCK(cs);
+    fDryRun = fDryRunIn;
+}
+
+bool CBDNSDB::RecordUndo(const std::string &bdnsName) {
+    AssertLockHeld(cs);
+
+    if (nBlockHeight == -1) {
+        LogPrintf("BlockchainDNS -- %s: changing domain %s outside of a block\n", __func__, bdnsName);
+        return false;
+    }
+
+    if (mapBlockUndo.count(bdnsName))
+        return true;
+
+    // the state before the block is the one on disk, the block's own changes are still in the transaction
+    BDNSUndoRecord undoRecord;
+    undoRecord.bdnsName = bdnsName;
+    undoRecord.fExisted = Read(std::make_pair(DB_DOMAIN, bdnsName), undoRecord.prevRecord);
+    mapBlockUndo.emplace(bdnsName, undoRecord);
+
+    return true;
+}
 
 bool CBDNSDB::GetContentFromBDNSRecord(const std::string &bdnsName, std::string &content) {
     BDNSRecord storedValue;
 
-    if (Read(std::make_pair(DB_DOMAIN, bdnsName), storedValue)) {
+    if (ReadBDNSRecord(bdnsName, storedValue)) {
         content = storedValue.content;
 
         return true;
@@ -31,50 +187,189 @@ bool CBDNSDB::GetContentFromBDNSRecord(const std::string &bdnsName, std::string
     return false;
 }
 
+void CBDNSDB::GetCacheStats(uint64_t &nHits, uint64_t &nMisses, size_t &nRecords, size_t &nMissing) {
+    LOCK(cs);
+    nHits = nCacheHits;
+    nMisses = nCacheMisses;
+    nRecords = recordCache.size();
+    nMissing = missingCache.size();
+}
+
+bool CBDNSDB::ReadCachedBDNSRecord(const std::string &bdnsName, BDNSRecord &bdnsRecord) {
+    AssertLockHeld(cs);
+
+    if (recordCache.get(bdnsName, bdnsRecord)) {
+        nCacheHits++;
+        return true;
+    }
+
+    if (missingCache.exists(bdnsName)) {
+        nCacheHits++;
+        return false;
+    }
+
+    nCacheMisses++;
+
+    if (Read(std::make_pair(DB_DOMAIN, bdnsName), bdnsRecord)) {
+        recordCache.insert(bdnsName, bdnsRecord);
+        return true;
+    }
+
+    missingCache.insert(bdnsName, true);
+    return false;
+}
+
 bool CBDNSDB::HasBDNSRecord(const std::string &bdnsName) {
-    return Exists(std::make_pair(DB_DOMAIN, bdnsName));
+    LOCK(cs);
+
+    // the block being processed has to see its own changes, the caches only hold committed records
+    if (nBlockHeight != -1)
+        return blockTransaction.Exists(std::make_pair(DB_DOMAIN, bdnsName));
+
+    BDNSRecord bdnsRecord;
+    return ReadCachedBDNSRecord(bdnsName, bdnsRecord);
 }
 
 bool CBDNSDB::ReadBDNSRecord(const std::string &bdnsName, BDNSRecord& bdnsRecord) {
-    return Read(std::make_pair(DB_DOMAIN, bdnsName), bdnsRecord);
+    LOCK(cs);
+
+    if (nBlockHeight != -1)
+        return blockTransaction.Read(std::make_pair(DB_DOMAIN, bdnsName), bdnsRecord);
+
+    return ReadCachedBDNSRecord(bdnsName, bdnsRecord);
 }
 
 bool CBDNSDB::WriteBDNSRecord(const std::string &bdnsName, const BDNSRecord &bdnsRecord) {
-    if (Write(std::make_pair(DB_DOMAIN, bdnsName), bdnsRecord)) {
-        SetLastChangeHeight();
-        return true;
-    }
+    LOCK(cs);
 
-    return false;
+    if (!RecordUndo(bdnsName))
+        return false;
+
+    blockTransaction.Write(std::make_pair(DB_DOMAIN, bdnsName), bdnsRecord);
+    return true;
 }
 
 bool CBDNSDB::UpdateBDNSRecord(const std::string &bdnsName, const std::string &content, const uint256 &updateTxid) {
+    LOCK(cs);
     BDNSRecord storedValue;
 
-    if (Read(std::make_pair(DB_DOMAIN, bdnsName), storedValue)) {
+    if (blockTransaction.Read(std::make_pair(DB_DOMAIN, bdnsName), storedValue)) {
+        if (!RecordUndo(bdnsName))
+            return false;
+
         storedValue.content = content;
         storedValue.lastUpdateTxid = updateTxid;
-        
-        if (Write(std::make_pair(DB_DOMAIN, bdnsName), storedValue)) {
-            SetLastChangeHeight();
-            return true;
-        }
+
+        blockTransaction.Write(std::make_pair(DB_DOMAIN, bdnsName), storedValue);
+        return true;
     }
 
     return false;
 }
 
 bool CBDNSDB::EraseBDNSRecord(const std::string &bdnsName) {
-    if (Erase(std::make_pair(DB_DOMAIN, bdnsName))) {
-        SetLastChangeHeight();
-        return true;
+    LOCK(cs);
+
+    if (!RecordUndo(bdnsName))
+        return false;
+
+    blockTransaction.Erase(std::make_pair(DB_DOMAIN, bdnsName));
+    return true;
+}
+
+bool CBDNSDB::WriteBDNSExpiry(const std::string &bdnsName, const int &nExpiryHeight) {
+    LOCK(cs);
+
+    if (nBlockHeight == -1) {
+        LogPrintf("BlockchainDNS -- %s: scheduling expiry of domain %s outside of a block\n", __func__, bdnsName);
+        return false;
     }
 
-    return false;
+    blockTransaction.Write(std::make_pair(DB_EXPIRY, std::make_pair(nExpiryHeight, bdnsName)), 1);
+    blockUndo.vExpiryAdded.emplace_back(nExpiryHeight, bdnsName);
+    return true;
+}
+
+bool CBDNSDB::ExpireBDNSRecords(std::vector<std::string> &vExpiredNames) {
+    LOCK(cs);
+
+    if (nBlockHeight == -1)
+        return false;
+
+    // entries of one height share the key prefix, entries of the current block can't expire in it so the disk is enough
+    std::unique_ptr<CDBIterator> pcursor(NewIterator());
+    pcursor->Seek(std::make_pair(DB_EXPIRY, std::make_pair(nBlockHeight, std::string())));
+
+    while (pcursor->Valid()) {
+        std::pair<char, std::pair<int, std::string> > key;
+
+        if (!pcursor->GetKey(key) || key.first != DB_EXPIRY || key.second.first != nBlockHeight)
+            break;
+
+        vExpiredNames.push_back(key.second.second);
+        pcursor->Next();
+    }
+
+    for (const auto& bdnsName : vExpiredNames) {
+        if (!RecordUndo(bdnsName))
+            return false;
+
+        blockTransaction.Erase(std::make_pair(DB_DOMAIN, bdnsName));
+        blockTransaction.Erase(std::make_pair(DB_EXPIRY, std::make_pair(nBlockHeight, bdnsName)));
+        blockUndo.vExpired.push_back(bdnsName);
+    }
+
+    return true;
+}
+
+// names are serialized with their length first so the ones sharing a prefix are grouped by length, each group is reached with one seek
+void CBDNSDB::ListBDNSRecords(const std::string &prefix, std::string &cursor, size_t nCount, std::vector<std::pair<std::string, BDNSRecord> > &vRecords) {
+    LOCK(cs);
+    std::unique_ptr<CDBIterator> pcursor(NewIterator());
+
+    pcursor->Seek(std::make_pair(DB_DOMAIN, cursor.empty() ? prefix : cursor));
+    cursor.clear();
+
+    while (pcursor->Valid()) {
+        std::pair<char, std::string> key;
+
+        if (!pcursor->GetKey(key) || key.first != DB_DOMAIN)
+            break;
+
+        const std::string &bdnsName = key.second;
+
+        if (bdnsName.compare(0, prefix.size(), prefix) == 0) {
+            if (vRecords.size() == nCount) {
+                cursor = bdnsName;
+                break;
+            }
+
+            BDNSRecord bdnsRecord;
+            if (pcursor->GetValue(bdnsRecord))
+                vRecords.emplace_back(bdnsName, bdnsRecord);
+
+            pcursor->Next();
+            continue;
+        }
+
+        // continue with the first name of the current length carrying the prefix, or of the next length if that one is already passed
+        std::string nextName = prefix;
+        if (bdnsName.size() >= prefix.size()) {
+            nextName.resize(bdnsName.size(), '\0');
+            if (bdnsName > nextName)
+                nextName.resize(bdnsName.size() + 1, '\0');
+        }
+
+        pcursor->Seek(std::make_pair(DB_DOMAIN, nextName));
+    }
 }
 
 // clears all records in the database, old or new format and writes the initial DB internals
 bool CBDNSDB::CleanDatabase() {
+    LOCK(cs);
+    recordCache.clear();
+    missingCache.clear();
+
     std::unique_ptr<CDBIterator> pcursor(NewIterator());
     size_t batch_size = 1 << 20;
     CDBBatch batch(*this);
@@ -82,40 +377,28 @@ bool CBDNSDB::CleanDatabase() {
 
     pcursor->SeekToFirst();
 
-    if (!CheckVersion()) {
-        std::string oldKey;
-
-        while (pcursor->Valid()) {
-            if (pcursor->GetKey(oldKey))
-                batch.Erase(oldKey);
-            
-            if (batch.SizeEstimate() > batch_size) {
-                ret = ret && WriteBatch(batch);
-                batch.Clear();
-            }
+    // keys are erased raw, whatever format or version they were written with
+    while (pcursor->Valid()) {
+        batch.Erase(pcursor->GetKey());
 
-            pcursor->Next();
+        if (batch.SizeEstimate() > batch_size) {
+            ret = ret && WriteBatch(batch);
+            batch.Clear();
         }
-    } else {
-        std::pair<unsigned char, std::string> newKey;
-
-        while (pcursor->Valid()) {
-            if (pcursor->GetKey(newKey))
-                batch.Erase(newKey);
-            
-            if (batch.SizeEstimate() > batch_size) {
-                ret = ret && WriteBatch(batch);
-                batch.Clear();
-            }
 
-            pcursor->Next();
-        }
+        pcursor->Next();
     }
 
     ret = ret && WriteBatch(batch);
     CompactFull();
 
-    return ret && WriteVersion() && SetHeight(db_default_height) && SetLastChangeHeight() && WriteCorruptionState(false);
+    // the corruption flag was erased together with everything else
+    batch.Clear();
+    batch.Write(std::make_pair(DB_INTERNAL, db_version), db_version_num);
+    batch.Write(std::make_pair(DB_INTERNAL, db_height), db_default_height);
+    batch.Write(std::make_pair(DB_INTERNAL, db_last_change), db_default_height);
+
+    return ret && WriteBatch(batch);
 }
 
 bool CBDNSDB::CheckVersion() {
@@ -128,10 +411,6 @@ bool CBDNSDB::CheckVersion() {
     return false;
 }
 
-bool CBDNSDB::WriteVersion() {
-    return Write(std::make_pair(DB_INTERNAL, db_version), db_version_num);
-}
-
 int CBDNSDB::GetLastChangeHeight() {
     int storedValue;
 
@@ -142,29 +421,21 @@ int CBDNSDB::GetLastChangeHeight() {
     return db_default_height;
 }
 
-bool CBDNSDB::SetLastChangeHeight() {
-    int storedValue;
-
-    if (Read(std::make_pair(DB_INTERNAL, db_height), storedValue))
-        if (Write(std::make_pair(DB_INTERNAL, db_last_change), storedValue))
-            return true;
-
-    // failling to set the last change height correctly leads to corruption
-    WriteCorruptionState(true);
-    return false;
-}
-
 // if the new height is smaller than the height of the last recorded change that means we're dealing with a BDNS index corruption
-bool CBDNSDB::SetHeight(const int &nHeight) {
+bool CBDNSDB::IsHeightChangeSuspicious(const int &nHeight, const int &nLastChangeHeight) {
     int prevHeight;
 
     if (Read(std::make_pair(DB_INTERNAL, db_height), prevHeight)) {
         // if certain heights were skipped that implies a possible corruption
         if (prevHeight != db_default_height && nHeight != db_default_height && !(nHeight == (prevHeight + 1) || nHeight == (prevHeight - 1)))
-            WriteCorruptionState(true);
+            return true;
     }
 
-    if (nHeight < GetLastChangeHeight())
+    return nHeight < nLastChangeHeight;
+}
+
+bool CBDNSDB::SetHeight(const int &nHeight) {
+    if (IsHeightChangeSuspicious(nHeight, GetLastChangeHeight()))
         WriteCorruptionState(true);
 
     if (Write(std::make_pair(DB_INTERNAL, db_height), nHeight))
@@ -176,6 +447,14 @@ bool CBDNSDB::SetHeight(const int &nHeight) {
 }
 
 bool CBDNSDB::WriteCorruptionState(bool fPossibleCorruption) {
+    LOCK(cs);
+
+    // while a block is open the flag becomes part of its batch
+    if (fPossibleCorruption && nBlockHeight != -1) {
+        fBlockCorruption = true;
+        return true;
+    }
+
     if (fPossibleCorruption)
         return Write(std::make_pair(DB_INTERNAL, db_corruption), 1);
     else
@@ -183,6 +462,11 @@ bool CBDNSDB::WriteCorruptionState(bool fPossibleCorruption) {
 }
 
 bool CBDNSDB::PossibleCorruption() {
+    LOCK(cs);
+
+    if (nBlockHeight != -1 && fBlockCorruption)
+        return true;
+
     return Exists(std::make_pair(DB_INTERNAL, db_corruption));
 }
 
@@ -7,9 +7,17 @@
 
 #include "uint256.h"
 #include "dbwrapper.h"
+#include "sync.h"
+#include "unordered_lru_cache.h"
 
+#include <functional>
+#include <map>
 #include <string>
 #include <utility>
+#include <vector>
+
+/** Maximum number of records returned by one page of a BDNS listing */
+static const int MAX_BDNS_LIST_COUNT = 1000;
 
 struct BDNSRecord {
     std::string content;
@@ -30,23 +38,111 @@ struct BDNSRecord {
     }
 };
 
-/** Access to the BDNS database (bdns/) */
+/** State of a BDNS record before a block changed it */
+struct BDNSUndoRecord {
+    std::string bdnsName;
+    bool fExisted;
+    BDNSRecord prevRecord;
+
+    template<typename Stream>
+    void Serialize(Stream &s) const {
+        s << bdnsName;
+        s << fExisted;
+        if (fExisted)
+            s << prevRecord;
+    }
+
+    template<typename Stream>
+    void Unserialize(Stream& s) {
+        s >> bdnsName;
+        s >> fExisted;
+        if (fExisted)
+            s >> prevRecord;
+    }
+};
+
+/** Everything needed to revert the BDNS changes of one block */
+struct BDNSBlockUndo {
+    int nPrevLastChangeHeight;
+    std::vector<BDNSUndoRecord> vRecords;
+    std::vector<std::string> vExpired; // expiry entries consumed by the block
+    std::vector<std::pair<int, std::string> > vExpiryAdded; // expiry entries added by the block
+
+    template<typename Stream>
+    void Serialize(Stream &s) const {
+        s << nPrevLastChangeHeight;
+        s << vRecords;
+        s << vExpired;
+        s << vExpiryAdded;
+    }
+
+    template<typename Stream>
+    void Unserialize(Stream& s) {
+        s >> nPrevLastChangeHeight;
+        s >> vRecords;
+        s >> vExpired;
+        s >> vExpiryAdded;
+    }
+};
+
+/** Access to the BDNS database (bdns/)
+ *
+ * Record changes are collected per block between BeginBlock() and CommitBlock() and then
+ * written in one batch together with the new height, the corruption flag and the undo data
+ * that lets UndoBlock() revert them exactly when the block gets disconnected.
+ */
 class CBDNSDB : public CDBWrapper
 {
 private:
-    bool WriteVersion();
+    typedef CDBTransaction<CDBWrapper, CDBBatch> BlockTransaction;
+
+    CCriticalSection cs;
+    CDBBatch blockBatch;
+    BlockTransaction blockTransaction;
+    int nBlockHeight; // height of the block whose changes are being collected, -1 if none
+    bool fBlockCorruption; // a possible corruption was detected while processing the current block
+    BDNSBlockUndo blockUndo;
+    std::map<std::string, BDNSUndoRecord> mapBlockUndo; // first change of each name within the block
+    bool fDryRun;
+
+    // committed records and names without a record, only used while no block is being processed
+    unordered_lru_cache<std::string, BDNSRecord, std::hash<std::string>, 10000> recordCache;
+    unordered_lru_cache<std::string, bool, std::hash<std::string>, 50000> missingCache;
+    uint64_t nCacheHits;
+    uint64_t nCacheMisses;
+
     int GetLastChangeHeight();
-    bool SetLastChangeHeight();
+    bool IsHeightChangeSuspicious(const int &nHeight, const int &nLastChangeHeight);
+    bool RecordUndo(const std::string &bdnsName);
+    bool ReadCachedBDNSRecord(const std::string &bdnsName, BDNSRecord &bdnsRecord);
 
 public:
     CBDNSDB(size_t nCacheSize, bool fMemory = false, bool fWipe = false);
 
+    /** Begin collecting the record changes of the block at nHeight */
+    void BeginBlock(const int &nHeight);
+    /** Write the record changes of the current block together with their undo data in one batch */
+    bool CommitBlock();
+    /** Revert the record changes of the block at nHeight, returns false if no undo data was found */
+    bool UndoBlock(const int &nHeight);
+    /** While set, block changes and undos are discarded instead of written (see VerifyDB) */
+    void SetDryRun(bool fDryRunIn);
+    /** Number of record lookups answered by the record caches and number of lookups that went to the database */
+    void GetCacheStats(uint64_t &nHits, uint64_t &nMisses, size_t &nRecords, size_t &nMissing);
+
     bool GetContentFromBDNSRecord(const std::string &bdnsName, std::string &content);
     bool HasBDNSRecord(const std::string &bdnsName);
     bool ReadBDNSRecord(const std::string &bdnsName, BDNSRecord &bdnsRecord);
     bool WriteBDNSRecord(const std::string &bdnsName, const BDNSRecord &bdnsRecord);
     bool UpdateBDNSRecord(const std::string &bdnsName, const std::string &content, const uint256 &updateTxid);
     bool EraseBDNSRecord(const std::string &bdnsName);
+    /** Schedule bdnsName to expire when the block at nExpiryHeight gets connected */
+    bool WriteBDNSExpiry(const std::string &bdnsName, const int &nExpiryHeight);
+    /** Erase the records scheduled to expire at the height of the current block */
+    bool ExpireBDNSRecords(std::vector<std::string> &vExpiredNames);
+    /** Read up to nCount committed records whose names start with prefix, in key order and starting with the name in cursor.
+     *  Afterwards cursor holds the name to continue with or is empty if no records are left. */
+    void ListBDNSRecords(const std::string &prefix, std::string &cursor, size_t nCount, std::vector<std::pair<std::string, BDNSRecord> > &vRecords);
     
     bool CleanDatabase();
     bool CheckVersion();
@@ -60,4 +156,15 @@ public:
     bool PossibleCorruption();
 };
 
+/** Keeps a CBDNSDB in dry run mode for the lifetime of the object */
+class CBDNSDryRunScope
+{
+private:
+    CBDNSDB &db;
+
+public:
+    explicit CBDNSDryRunScope(CBDNSDB &dbIn) : db(dbIn) { db.SetDryRun(true); }
+    ~CBDNSDryRunScope() { db.SetDryRun(false); }
+};
+
 #endif // ADOT_BDNSDB_H
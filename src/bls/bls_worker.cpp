@@ -958,3 +958,17 @@ void CBLSWorker::PushSigVerifyBatch()
     sigVerifyBatchesInProgress++;
     workerPool.push(f, batch);
 }
+
+std::future<void> CBLSWorker::AsyncRun(std::function<void()> job)
+{
+    if (workerPool.size() == 0) {
+        std::packaged_task<void()> task(std::move(job));
+        auto f = task.get_future();
+        task();
+        return f;
+    }
+
+    return workerPool.push([job](int threadId) {
+        job();
+    });
+}
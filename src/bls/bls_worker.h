@@ -139,6 +139,10 @@ public:
     std::future<bool> AsyncVerifySig(const CBLSSignature& sig, const CBLSPublicKey& pubKey, const uint256& msgHash, CancelCond cancelCond = [] { return false; });
     bool IsAsyncVerifyInProgress();
 
+    // Runs job on the worker pool, used by callers which do their own batching (e.g. batched sig share verification)
+    // If the pool was not started, the job is executed on the calling thread
+    std::future<void> AsyncRun(std::function<void()> job);
+
 private:
     void PushSigVerifyBatch();
 };
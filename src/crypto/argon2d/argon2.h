@@ -92,6 +92,9 @@ extern "C" {
 #define ARGON2_DEFAULT_FLAGS UINT32_C(0)
 #define ARGON2_FLAG_CLEAR_PASSWORD (UINT32_C(1) << 0)
 #define ARGON2_FLAG_CLEAR_SECRET (UINT32_C(1) << 1)
+/* Alterdot: skip wiping the memory matrix on free, for inputs that are not secret
+ * (proof-of-work hashing of public block headers). */
+#define ARGON2_FLAG_NO_WIPE_MEMORY (UINT32_C(1) << 2)
 
 /* Global flag to determine if we are wiping internal memory buffers. This flag
  * is defined in core.c and deafults to 1 (wipe internal memory). */
@@ -18,9 +18,23 @@
 
 #include <univalue.h>
 
+#include <mutex>
+
 static const std::string DB_LIST_SNAPSHOT = "dmn_S";
 static const std::string DB_LIST_DIFF = "dmn_D";
 
+// lists with fewer scored MNs are hashed on the calling thread
+static const size_t MIN_PARALLEL_SCORES_COUNT = 1024;
+static const int MAX_SCORES_THREADS = 4;
+
+// rough estimate for a masternode's map nodes, its shared objects and its unique property entries
+static const size_t MN_LIST_ENTRY_MEMORY_USAGE = sizeof(CDeterministicMN) + sizeof(CDeterministicMNState) + 256;
+
+static size_t EstimateListMemoryUsage(size_t nEntries)
+{
+    return sizeof(CDeterministicMNList) + nEntries * MN_LIST_ENTRY_MEMORY_USAGE;
+}
+
 CDeterministicMNManager* deterministicMNManager;
 
 std::string CDeterministicMNState::ToString() const
@@ -240,12 +254,13 @@ std::vector<CDeterministicMNCPtr> CDeterministicMNList::GetProjectedMNPayees(int
     }
 
     std::vector<CDeterministicMNCPtr> result;
-    result.reserve(nCount);
+    result.reserve(GetValidMNsCount());
 
     ForEachMN(true, [&](const CDeterministicMNCPtr& dmn) {
         result.emplace_back(dmn);
     });
-    std::sort(result.begin(), result.end(), [&](const CDeterministicMNCPtr& a, const CDeterministicMNCPtr& b) {
+    // only the first nCount need to be in order
+    std::partial_sort(result.begin(), result.begin() + nCount, result.end(), [&](const CDeterministicMNCPtr& a, const CDeterministicMNCPtr& b) {
         return CompareByLastPaid(a, b);
     });
 
@@ -258,24 +273,36 @@ std::vector<CDeterministicMNCPtr> CDeterministicMNList::CalculateQuorum(size_t m
 {
     auto scores = CalculateScores(modifier);
 
-    // sort is descending order
-    std::sort(scores.rbegin(), scores.rend(), [](const std::pair<arith_uint256, CDeterministicMNCPtr>& a, std::pair<arith_uint256, CDeterministicMNCPtr>& b) {
+    // only the top maxSize entries are selected and sorted, in descending order
+    size_t count = std::min(maxSize, scores.size());
+    std::partial_sort(scores.begin(), scores.begin() + count, scores.end(), [](const std::pair<arith_uint256, CDeterministicMNCPtr>& a, const std::pair<arith_uint256, CDeterministicMNCPtr>& b) {
         if (a.first == b.first) {
             // this should actually never happen, but we should stay compatible with how the non deterministic MNs did the sorting
-            return a.second->collateralOutpoint < b.second->collateralOutpoint;
+            return b.second->collateralOutpoint < a.second->collateralOutpoint;
         }
-        return a.first < b.first;
+        return b.first < a.first;
     });
 
     // take top maxSize entries and return it
     std::vector<CDeterministicMNCPtr> result;
-    result.resize(std::min(maxSize, scores.size()));
+    result.resize(count);
     for (size_t i = 0; i < result.size(); i++) {
         result[i] = std::move(scores[i].second);
     }
     return result;
 }
 
+static ctpl::thread_pool& GetScoresWorkerPool()
+{
+    static ctpl::thread_pool workerPool;
+    static std::once_flag initFlag;
+    std::call_once(initFlag, [] {
+        workerPool.resize(std::max(1, std::min(GetNumCores() - 1, MAX_SCORES_THREADS)));
+        RenameThreadPool(workerPool, "alterdot-mnscores");
+    });
+    return workerPool;
+}
+
 std::vector<std::pair<arith_uint256, CDeterministicMNCPtr>> CDeterministicMNList::CalculateScores(const uint256& modifier) const
 {
     std::vector<std::pair<arith_uint256, CDeterministicMNCPtr>> scores;
@@ -286,19 +313,48 @@ std::vector<std::pair<arith_uint256, CDeterministicMNCPtr>> CDeterministicMNList
             // future quorums
             return;
         }
-        // calculate sha256(sha256(proTxHash, confirmedHash), modifier) per MN
-        // Please note that this is not a double-sha256 but a single-sha256
-        // The first part is already precalculated (confirmedHashWithProRegTxHash)
-        // TODO When https://github.com/bitcoin/bitcoin/pull/13191 gets backported, implement something that is similar but for single-sha256
-        uint256 h;
-        CSHA256 sha256;
-        sha256.Write(dmn->pdmnState->confirmedHashWithProRegTxHash.begin(), dmn->pdmnState->confirmedHashWithProRegTxHash.size());
-        sha256.Write(modifier.begin(), modifier.size());
-        sha256.Finalize(h.begin());
-
-        scores.emplace_back(UintToArith256(h), dmn);
+        scores.emplace_back(arith_uint256(), dmn);
     });
 
+    auto calcScores = [&scores, &modifier](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; i++) {
+            auto& dmn = scores[i].second;
+            // calculate sha256(sha256(proTxHash, confirmedHash), modifier) per MN
+            // Please note that this is not a double-sha256 but a single-sha256
+            // The first part is already precalculated (confirmedHashWithProRegTxHash)
+            // TODO When https://github.com/bitcoin/bitcoin/pull/13191 gets backported, implement something that is similar but for single-sha256
+            uint256 h;
+            CSHA256 sha256;
+            sha256.Write(dmn->pdmnState->confirmedHashWithProRegTxHash.begin(), dmn->pdmnState->confirmedHashWithProRegTxHash.size());
+            sha256.Write(modifier.begin(), modifier.size());
+            sha256.Finalize(h.begin());
+
+            scores[i].first = UintToArith256(h);
+        }
+    };
+
+    if (scores.size() < MIN_PARALLEL_SCORES_COUNT) {
+        calcScores(0, scores.size());
+        return scores;
+    }
+
+    // split the list between the workers and this thread
+    auto& workerPool = GetScoresWorkerPool();
+    size_t chunkCount = (size_t)workerPool.size() + 1;
+    size_t chunkSize = (scores.size() + chunkCount - 1) / chunkCount;
+
+    std::vector<std::future<void>> futures;
+    for (size_t begin = chunkSize; begin < scores.size(); begin += chunkSize) {
+        size_t end = std::min(begin + chunkSize, scores.size());
+        futures.emplace_back(workerPool.push([&calcScores, begin, end](int threadId) {
+            calcScores(begin, end);
+        }));
+    }
+    calcScores(0, chunkSize);
+    for (auto& f : futures) {
+        f.get();
+    }
+
     return scores;
 }
 
@@ -498,9 +554,18 @@ void CDeterministicMNList::RemoveMN(const uint256& proTxHash)
     mnInternalIdMap = mnInternalIdMap.erase(dmn->internalId);
 }
 
-CDeterministicMNManager::CDeterministicMNManager(CEvoDB& _evoDb) :
-    evoDb(_evoDb)
+CDeterministicMNManager::CDeterministicMNManager(CEvoDB& _evoDb, size_t _nMaxListsCacheMemory) :
+    evoDb(_evoDb),
+    nMaxListsCacheMemory(_nMaxListsCacheMemory)
 {
+    assert(nMaxListsCacheMemory != 0);
+}
+
+CDeterministicMNManager::~CDeterministicMNManager()
+{
+    // pending prefetches are dropped, only the one currently running is waited for
+    prefetchPool.clear_queue();
+    prefetchPool.stop(true);
 }
 
 bool CDeterministicMNManager::ProcessBlock(const CBlock& block, const CBlockIndex* pindex, CValidationState& _state, bool fJustCheck)
@@ -561,9 +626,6 @@ bool CDeterministicMNManager::ProcessBlock(const CBlock& block, const CBlockInde
         LogPrintf("CDeterministicMNManager::%s -- DIP3 is enforced now. nHeight=%d\n", __func__, nHeight);
     }
 
-    LOCK(cs);
-    CleanupCache(nHeight);
-
     return true;
 }
 
@@ -588,7 +650,9 @@ bool CDeterministicMNManager::UndoBlock(const CBlock& block, const CBlockIndex*
         evoDb.Erase(std::make_pair(DB_LIST_DIFF, blockHash));
         evoDb.Erase(std::make_pair(DB_LIST_SNAPSHOT, blockHash));
 
-        mnListsCache.erase(blockHash);
+        EraseCachedList(blockHash);
+        lastBuiltListPrevIndex = nullptr;
+        lastBuiltListTxs.clear();
     }
 
     if (diff.HasChanges()) {
@@ -616,6 +680,12 @@ bool CDeterministicMNManager::BuildNewListFromBlock(const CBlock& block, const C
 {
     AssertLockHeld(cs);
 
+    // the list only depends on the previous block and the transactions, compared by pointer as they're shared
+    if (pindexPrev == lastBuiltListPrevIndex && block.vtx == lastBuiltListTxs) {
+        mnListRet = lastBuiltList;
+        return true;
+    }
+
     int nHeight = pindexPrev->nHeight + 1;
 
     CDeterministicMNList oldList = GetListForBlock(pindexPrev);
@@ -848,6 +918,10 @@ bool CDeterministicMNManager::BuildNewListFromBlock(const CBlock& block, const C
 
     mnListRet = std::move(newList);
 
+    lastBuiltListPrevIndex = pindexPrev;
+    lastBuiltListTxs = block.vtx;
+    lastBuiltList = mnListRet;
+
     return true;
 }
 
@@ -897,21 +971,19 @@ CDeterministicMNList CDeterministicMNManager::GetListForBlock(const CBlockIndex*
 
     while (true) {
         // try using cache before reading from disk
-        auto it = mnListsCache.find(pindex->GetBlockHash());
-        if (it != mnListsCache.end()) {
-            snapshot = it->second;
+        if (GetCachedList(pindex->GetBlockHash(), snapshot)) {
             break;
         }
 
         if (evoDb.Read(std::make_pair(DB_LIST_SNAPSHOT, pindex->GetBlockHash()), snapshot)) {
-            mnListsCache.emplace(pindex->GetBlockHash(), snapshot);
+            AddCachedList(snapshot, EstimateListMemoryUsage(snapshot.GetAllMNsCount()));
             break;
         }
 
         CDeterministicMNListDiff diff;
         if (!evoDb.Read(std::make_pair(DB_LIST_DIFF, pindex->GetBlockHash()), diff)) {
             snapshot = CDeterministicMNList(pindex->GetBlockHash(), -1, 0);
-            mnListsCache.emplace(pindex->GetBlockHash(), snapshot);
+            AddCachedList(snapshot, EstimateListMemoryUsage(0));
             break;
         }
 
@@ -919,9 +991,16 @@ CDeterministicMNList CDeterministicMNManager::GetListForBlock(const CBlockIndex*
         pindex = pindex->pprev;
     }
 
-    for (const auto& p : listDiff) {
-        auto diffIndex = p.first;
-        auto& diff = p.second;
+    // Lists close to the tip are needed for block processing and share nearly everything with each other, so all of
+    // them are kept. Historical ones are only kept at an interval so that the next lookup nearby applies a few diffs
+    // instead of walking back to the last snapshot on disk again
+    int nRecentHeight = tipIndex ? tipIndex->nHeight - LISTS_CACHE_SIZE : -1;
+    int nInterval = GetCacheSnapshotInterval();
+    size_t nPendingMemoryUsage = 0;
+
+    for (auto it = listDiff.begin(); it != listDiff.end(); ++it) {
+        auto diffIndex = it->first;
+        auto& diff = it->second;
         if (diff.HasChanges()) {
             snapshot = snapshot.ApplyDiff(diffIndex, diff);
         } else {
@@ -929,7 +1008,13 @@ CDeterministicMNList CDeterministicMNManager::GetListForBlock(const CBlockIndex*
             snapshot.SetHeight(diffIndex->nHeight);
         }
 
-        mnListsCache.emplace(diffIndex->GetBlockHash(), snapshot);
+        // a list owns the changes of all the lists skipped since the last cached one
+        nPendingMemoryUsage += EstimateListMemoryUsage(diff.addedMNs.size() + diff.updatedMNs.size() + diff.removedMns.size());
+
+        if (std::next(it) == listDiff.end() || diffIndex->nHeight >= nRecentHeight || (diffIndex->nHeight % nInterval) == 0) {
+            AddCachedList(snapshot, nPendingMemoryUsage);
+            nPendingMemoryUsage = 0;
+        }
     }
 
     return snapshot;
@@ -977,19 +1062,129 @@ bool CDeterministicMNManager::IsDIP3Enforced(int nHeight)
     return nHeight >= Params().GetConsensus().DIP0003EnforcementHeight;
 }
 
-void CDeterministicMNManager::CleanupCache(int nHeight)
+void CDeterministicMNManager::PrefetchListsAfter(const CBlockIndex* pindex)
 {
-    AssertLockHeld(cs);
+    std::vector<const CBlockIndex*> vIndexes;
+    {
+        LOCK(cs);
+
+        // recent lists are cached anyway and lists off the active chain are not worth it
+        if (!tipIndex || pindex->nHeight >= tipIndex->nHeight - LISTS_CACHE_SIZE || tipIndex->GetAncestor(pindex->nHeight) != pindex) {
+            return;
+        }
+
+        int nInterval = GetCacheSnapshotInterval();
+        int nHeight = pindex->nHeight - (pindex->nHeight % nInterval);
+        for (int i = 0; i < LISTS_PREFETCH_COUNT; i++) {
+            nHeight += nInterval;
+            if (nHeight > tipIndex->nHeight) {
+                break;
+            }
+            vIndexes.emplace_back(tipIndex->GetAncestor(nHeight));
+        }
+    }
+
+    PrefetchLists(vIndexes);
+}
+
+void CDeterministicMNManager::PrefetchLists(const std::vector<const CBlockIndex*>& vIndexes)
+{
+    LOCK(cs);
 
-    std::vector<uint256> toDelete;
-    for (const auto& p : mnListsCache) {
-        if (p.second.GetHeight() + LISTS_CACHE_SIZE < nHeight) {
-            toDelete.emplace_back(p.first);
+    std::vector<const CBlockIndex*> vMissing;
+    for (const auto pindex : vIndexes) {
+        if (pindex && !mnListsCache.count(pindex->GetBlockHash()) && setPrefetching.emplace(pindex->GetBlockHash()).second) {
+            vMissing.emplace_back(pindex);
         }
     }
-    for (const auto& h : toDelete) {
-        mnListsCache.erase(h);
+    if (vMissing.empty()) {
+        return;
+    }
+
+    // lower lists first, so that each one is built on top of the previous one
+    std::sort(vMissing.begin(), vMissing.end(), [](const CBlockIndex* a, const CBlockIndex* b) {
+        return a->nHeight < b->nHeight;
+    });
+
+    if (prefetchPool.size() == 0) {
+        prefetchPool.resize(1);
+        RenameThreadPool(prefetchPool, "alterdot-mnlist-prefetch");
+    }
+
+    prefetchPool.push([this, vMissing](int threadId) {
+        for (const auto pindex : vMissing) {
+            {
+                LOCK(cs);
+                setPrefetching.erase(pindex->GetBlockHash());
+                // the diffs of disconnected blocks are gone, loading one of them would cache an empty list
+                if (!tipIndex || tipIndex->GetAncestor(pindex->nHeight) != pindex) {
+                    continue;
+                }
+            }
+            // cs is released in between so that block processing doesn't wait for the whole batch
+            GetListForBlock(pindex);
+        }
+    });
+}
+
+void CDeterministicMNManager::GetCacheStats(size_t& nEntriesRet, size_t& nMemoryUsageRet, size_t& nMaxMemoryUsageRet)
+{
+    LOCK(cs);
+    nEntriesRet = mnListsCache.size();
+    nMemoryUsageRet = nListsCacheMemory;
+    nMaxMemoryUsageRet = nMaxListsCacheMemory;
+}
+
+bool CDeterministicMNManager::GetCachedList(const uint256& blockHash, CDeterministicMNList& mnListRet)
+{
+    AssertLockHeld(cs);
+
+    auto it = mnListsCache.find(blockHash);
+    if (it == mnListsCache.end()) {
+        return false;
     }
+    mnListsLru.splice(mnListsLru.begin(), mnListsLru, it->second.itLru);
+    mnListRet = it->second.mnList;
+    return true;
+}
+
+void CDeterministicMNManager::AddCachedList(const CDeterministicMNList& mnList, size_t nMemoryUsage)
+{
+    AssertLockHeld(cs);
+
+    EraseCachedList(mnList.GetBlockHash());
+
+    mnListsLru.emplace_front(mnList.GetBlockHash());
+    mnListsCache.emplace(mnList.GetBlockHash(), CachedList{mnList, nMemoryUsage, mnListsLru.begin()});
+    nListsCacheMemory += nMemoryUsage;
+
+    // the list just added is always kept, even if it exceeds the limit on its own
+    while (nListsCacheMemory > nMaxListsCacheMemory && mnListsLru.size() > 1) {
+        uint256 blockHash = mnListsLru.back();
+        EraseCachedList(blockHash);
+    }
+}
+
+void CDeterministicMNManager::EraseCachedList(const uint256& blockHash)
+{
+    AssertLockHeld(cs);
+
+    auto it = mnListsCache.find(blockHash);
+    if (it == mnListsCache.end()) {
+        return;
+    }
+    nListsCacheMemory -= it->second.nMemoryUsage;
+    mnListsLru.erase(it->second.itLru);
+    mnListsCache.erase(it);
+}
+
+int CDeterministicMNManager::GetCacheSnapshotInterval()
+{
+    AssertLockHeld(cs);
+
+    // double the interval for every quarter of the cache in use
+    size_t nQuarters = std::min<size_t>(nListsCacheMemory * 4 / nMaxListsCacheMemory, 4);
+    return std::min(MIN_CACHE_SNAPSHOT_INTERVAL << nQuarters, MAX_CACHE_SNAPSHOT_INTERVAL);
 }
 
 bool CDeterministicMNManager::UpgradeDiff(CDBBatch& batch, const CBlockIndex* pindexNext, const CDeterministicMNList& curMNList, CDeterministicMNList& newMNList)
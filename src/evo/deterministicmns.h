@@ -7,16 +7,20 @@
 
 #include "arith_uint256.h"
 #include "bls/bls.h"
+#include "ctpl.h"
 #include "dbwrapper.h"
 #include "evodb.h"
 #include "providertx.h"
+#include "saltedhasher.h"
 #include "simplifiedmns.h"
 #include "sync.h"
 
 #include "immer/map.hpp"
 #include "immer/map_transient.hpp"
 
+#include <list>
 #include <map>
+#include <unordered_map>
 
 class CBlock;
 class CBlockIndex;
@@ -626,19 +630,49 @@ public:
 class CDeterministicMNManager
 {
     static const int SNAPSHOT_LIST_PERIOD = 576; // once per day
+    // every list this close to the tip is cached, older ones only at the in-memory snapshot interval
     static const int LISTS_CACHE_SIZE = 576;
+    // in-memory snapshots of historical lists are taken more sparsely the fuller the cache gets
+    static const int MIN_CACHE_SNAPSHOT_INTERVAL = 16;
+    static const int MAX_CACHE_SNAPSHOT_INTERVAL = 256;
+    // number of in-memory snapshots warmed ahead of a historical lookup
+    static const int LISTS_PREFETCH_COUNT = 8;
 
 public:
+    static const size_t DEFAULT_LISTS_CACHE_MEMORY = 64 * 1024 * 1024;
+
     CCriticalSection cs;
 
 private:
+    struct CachedList {
+        CDeterministicMNList mnList;
+        // estimated memory only owned by this list, lists created by applying a diff share most of it with their base
+        size_t nMemoryUsage;
+        std::list<uint256>::iterator itLru;
+    };
+
     CEvoDB& evoDb;
 
-    std::map<uint256, CDeterministicMNList> mnListsCache;
+    // LRU of lists by block hash, bounded by the estimated memory usage
+    std::unordered_map<uint256, CachedList, StaticSaltedHasher> mnListsCache;
+    std::list<uint256> mnListsLru; // most recently used first
+    size_t nListsCacheMemory{0};
+    size_t nMaxListsCacheMemory;
+
     const CBlockIndex* tipIndex{nullptr};
 
+    // warms the cache for historical lookups, started on first use
+    ctpl::thread_pool prefetchPool;
+    std::set<uint256> setPrefetching;
+
+    // last list built by BuildNewListFromBlock, ProcessBlock and the CbTx merkle root check both build it for a block
+    const CBlockIndex* lastBuiltListPrevIndex{nullptr};
+    std::vector<CTransactionRef> lastBuiltListTxs;
+    CDeterministicMNList lastBuiltList;
+
 public:
-    CDeterministicMNManager(CEvoDB& _evoDb);
+    CDeterministicMNManager(CEvoDB& _evoDb, size_t _nMaxListsCacheMemory = DEFAULT_LISTS_CACHE_MEMORY);
+    ~CDeterministicMNManager();
 
     bool ProcessBlock(const CBlock& block, const CBlockIndex* pindex, CValidationState& state, bool fJustCheck);
     bool UndoBlock(const CBlock& block, const CBlockIndex* pindex);
@@ -653,6 +687,13 @@ public:
     CDeterministicMNList GetListForBlock(const CBlockIndex* pindex);
     CDeterministicMNList GetListAtChainTip();
 
+    // Load the lists following a historical block in the background, for callers walking the chain forward
+    void PrefetchListsAfter(const CBlockIndex* pindex);
+    // Load the lists of the given blocks in the background
+    void PrefetchLists(const std::vector<const CBlockIndex*>& vIndexes);
+
+    void GetCacheStats(size_t& nEntriesRet, size_t& nMemoryUsageRet, size_t& nMaxMemoryUsageRet);
+
     // Test if given TX is a ProRegTx which also contains the collateral at index n
     bool IsProTxWithCollateral(const CTransactionRef& tx, uint32_t n);
 
@@ -664,7 +705,10 @@ public:
     void UpgradeDBIfNeeded();
 
 private:
-    void CleanupCache(int nHeight);
+    bool GetCachedList(const uint256& blockHash, CDeterministicMNList& mnListRet);
+    void AddCachedList(const CDeterministicMNList& mnList, size_t nMemoryUsage);
+    void EraseCachedList(const uint256& blockHash);
+    int GetCacheSnapshotInterval();
 };
 
 extern CDeterministicMNManager* deterministicMNManager;
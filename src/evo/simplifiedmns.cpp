@@ -5,6 +5,7 @@
 #include "cbtx.h"
 #include "core_io.h"
 #include "deterministicmns.h"
+#include "evodb.h"
 #include "llmq/quorums.h"
 #include "llmq/quorums_blockprocessor.h"
 #include "llmq/quorums_commitment.h"
@@ -14,9 +15,19 @@
 #include "base58.h"
 #include "chainparams.h"
 #include "consensus/merkle.h"
+#include "saltedhasher.h"
 #include "univalue.h"
+#include "unordered_lru_cache.h"
 #include "validation.h"
 
+static const std::string DB_CBTX_PROOF = "sml_cbp";
+// proofs are only kept for the most recent blocks, older ones are rebuilt from the block on disk
+static const int CBTX_PROOF_KEEP_BLOCKS = 576;
+
+// recently built diffs keyed by (baseBlockHash, blockHash) as requested, SPV clients tend to ask for the same ones
+static CCriticalSection cs_mnListDiffCache;
+static unordered_lru_cache<std::pair<uint256, uint256>, CSimplifiedMNListDiff, StaticSaltedHasher, 64> mnListDiffCache;
+
 CSimplifiedMNListEntry::CSimplifiedMNListEntry(const CDeterministicMN& dmn) :
     proRegTxHash(dmn.proTxHash),
     confirmedHash(dmn.pdmnState->confirmedHash),
@@ -88,6 +99,92 @@ uint256 CSimplifiedMNList::CalcMerkleRoot(bool* pmutated) const
     return ComputeMerkleRoot(leaves, pmutated);
 }
 
+uint256 CSimplifiedMNListMerkleTree::Update(const CDeterministicMNList& mnList)
+{
+    nEpoch++;
+
+    // lists share the states of unchanged masternodes, so only entries with a new state need to be hashed again
+    mnList.ForEachMN(false, [&](const CDeterministicMNCPtr& dmn) {
+        Leaf& leaf = leaves[dmn->proTxHash];
+        if (leaf.pdmnState != dmn->pdmnState) {
+            leaf.pdmnState = dmn->pdmnState;
+            leaf.hash = CSimplifiedMNListEntry(*dmn).CalcHash();
+        }
+        leaf.nEpoch = nEpoch;
+    });
+    for (auto it = leaves.begin(); it != leaves.end(); ) {
+        if (it->second.nEpoch != nEpoch) {
+            it = leaves.erase(it);
+        } else {
+            ++it;
+        }
+    }
+
+    std::vector<uint256> newLeaves;
+    newLeaves.reserve(leaves.size());
+    for (const auto& p : leaves) {
+        newLeaves.emplace_back(p.second.hash);
+    }
+
+    if (levels.empty()) {
+        levels.emplace_back();
+    }
+
+    // positions that changed, after an added or removed leaf this is every following position
+    std::vector<size_t> vDirty;
+    for (size_t i = 0; i < newLeaves.size(); i++) {
+        if (i >= levels[0].size() || levels[0][i] != newLeaves[i]) {
+            vDirty.emplace_back(i);
+        }
+    }
+    bool fResized = levels[0].size() != newLeaves.size();
+    levels[0] = std::move(newLeaves);
+
+    size_t nLevel = 0;
+    for (; levels[nLevel].size() > 1; nLevel++) {
+        if (levels.size() == nLevel + 1) {
+            levels.emplace_back();
+        }
+        const auto& nodes = levels[nLevel];
+        auto& parents = levels[nLevel + 1];
+
+        size_t nParents = (nodes.size() + 1) / 2;
+        bool fParentsResized = parents.size() != nParents;
+        parents.resize(nParents);
+
+        std::vector<size_t> vParentsDirty;
+        for (size_t i : vDirty) {
+            if (vParentsDirty.empty() || vParentsDirty.back() != i / 2) {
+                vParentsDirty.emplace_back(i / 2);
+            }
+        }
+        // when a level shrinks its last node might have lost its sibling and now gets paired with itself
+        if (fResized && (vParentsDirty.empty() || vParentsDirty.back() != nParents - 1)) {
+            vParentsDirty.emplace_back(nParents - 1);
+        }
+
+        for (size_t i : vParentsDirty) {
+            const uint256& left = nodes[i * 2];
+            const uint256& right = i * 2 + 1 < nodes.size() ? nodes[i * 2 + 1] : left;
+            parents[i] = Hash(left.begin(), left.end(), right.begin(), right.end());
+        }
+
+        vDirty = std::move(vParentsDirty);
+        fResized = fParentsResized;
+    }
+    levels.resize(nLevel + 1);
+
+    return GetRoot();
+}
+
+uint256 CSimplifiedMNListMerkleTree::GetRoot() const
+{
+    if (levels.empty() || levels.back().empty()) {
+        return uint256();
+    }
+    return levels.back()[0];
+}
+
 CSimplifiedMNListDiff::CSimplifiedMNListDiff()
 {
 }
@@ -185,68 +282,119 @@ void CSimplifiedMNListDiff::ToJson(UniValue& obj) const
     }
 }
 
+CSimplifiedMNListCbTxProof::CSimplifiedMNListCbTxProof(const CBlock& block) :
+    cbTx(block.vtx[0])
+{
+    std::vector<uint256> vHashes;
+    std::vector<bool> vMatch(block.vtx.size(), false);
+    for (const auto& tx : block.vtx) {
+        vHashes.emplace_back(tx->GetHash());
+    }
+    vMatch[0] = true; // only coinbase matches
+    cbTxMerkleTree = CPartialMerkleTree(vHashes, vMatch);
+}
+
+void WriteCbTxProof(const CBlock& block, const CBlockIndex* pindex)
+{
+    evoDb->Write(std::make_pair(DB_CBTX_PROOF, pindex->GetBlockHash()), CSimplifiedMNListCbTxProof(block));
+
+    const CBlockIndex* pindexPrune = pindex->GetAncestor(pindex->nHeight - CBTX_PROOF_KEEP_BLOCKS);
+    if (pindexPrune) {
+        evoDb->Erase(std::make_pair(DB_CBTX_PROOF, pindexPrune->GetBlockHash()));
+    }
+}
+
+void EraseCbTxProof(const CBlockIndex* pindex)
+{
+    evoDb->Erase(std::make_pair(DB_CBTX_PROOF, pindex->GetBlockHash()));
+}
+
 bool BuildSimplifiedMNListDiff(const uint256& baseBlockHash, const uint256& blockHash, CSimplifiedMNListDiff& mnListDiffRet, std::string& errorRet)
 {
-    AssertLockHeld(cs_main);
     mnListDiffRet = CSimplifiedMNListDiff();
 
-    const CBlockIndex* baseBlockIndex = chainActive.Genesis();
-    if (!baseBlockHash.IsNull()) {
-        auto it = mapBlockIndex.find(baseBlockHash);
-        if (it == mapBlockIndex.end()) {
-            errorRet = strprintf("block %s not found", baseBlockHash.ToString());
+    const CBlockIndex* baseBlockIndex;
+    const CBlockIndex* blockIndex;
+    CDeterministicMNList baseDmnList;
+    CDeterministicMNList dmnList;
+    CSimplifiedMNListDiff quorumsDiff;
+
+    {
+        LOCK(cs_main);
+
+        baseBlockIndex = chainActive.Genesis();
+        if (!baseBlockHash.IsNull()) {
+            auto it = mapBlockIndex.find(baseBlockHash);
+            if (it == mapBlockIndex.end()) {
+                errorRet = strprintf("block %s not found", baseBlockHash.ToString());
+                return false;
+            }
+            baseBlockIndex = it->second;
+        }
+        auto blockIt = mapBlockIndex.find(blockHash);
+        if (blockIt == mapBlockIndex.end()) {
+            errorRet = strprintf("block %s not found", blockHash.ToString());
             return false;
         }
-        baseBlockIndex = it->second;
-    }
-    auto blockIt = mapBlockIndex.find(blockHash);
-    if (blockIt == mapBlockIndex.end()) {
-        errorRet = strprintf("block %s not found", blockHash.ToString());
-        return false;
-    }
-    const CBlockIndex* blockIndex = blockIt->second;
+        blockIndex = blockIt->second;
 
-    if (!chainActive.Contains(baseBlockIndex) || !chainActive.Contains(blockIndex)) {
-        errorRet = strprintf("block %s and %s are not in the same chain", baseBlockHash.ToString(), blockHash.ToString());
-        return false;
-    }
-    if (baseBlockIndex->nHeight > blockIndex->nHeight) {
-        errorRet = strprintf("base block %s is higher then block %s", baseBlockHash.ToString(), blockHash.ToString());
-        return false;
-    }
+        if (!chainActive.Contains(baseBlockIndex) || !chainActive.Contains(blockIndex)) {
+            errorRet = strprintf("block %s and %s are not in the same chain", baseBlockHash.ToString(), blockHash.ToString());
+            return false;
+        }
+        if (baseBlockIndex->nHeight > blockIndex->nHeight) {
+            errorRet = strprintf("base block %s is higher then block %s", baseBlockHash.ToString(), blockHash.ToString());
+            return false;
+        }
+
+        // a diff only depends on the two blocks so once both are known to be in the active chain a cached one can be used
+        {
+            LOCK(cs_mnListDiffCache);
+            if (mnListDiffCache.get(std::make_pair(baseBlockHash, blockHash), mnListDiffRet)) {
+                return true;
+            }
+        }
+
+        baseDmnList = deterministicMNManager->GetListForBlock(baseBlockIndex);
+        dmnList = deterministicMNManager->GetListForBlock(blockIndex);
+        // clients syncing the list request consecutive diffs
+        deterministicMNManager->PrefetchListsAfter(blockIndex);
 
-    LOCK(deterministicMNManager->cs);
+        if (!quorumsDiff.BuildQuorumsDiff(baseBlockIndex, blockIndex)) {
+            errorRet = strprintf("failed to build quorums diff");
+            return false;
+        }
+    }
 
-    auto baseDmnList = deterministicMNManager->GetListForBlock(baseBlockIndex);
-    auto dmnList = deterministicMNManager->GetListForBlock(blockIndex);
+    // the lists are copies and everything below is keyed by block hash, so the rest is done without cs_main
     mnListDiffRet = baseDmnList.BuildSimplifiedDiff(dmnList);
 
     // We need to return the value that was provided by the other peer as it otherwise won't be able to recognize the
     // response. This will usually be identical to the block found in baseBlockIndex. The only difference is when a
     // null block hash was provided to get the diff from the genesis block.
     mnListDiffRet.baseBlockHash = baseBlockHash;
-
-    if (!mnListDiffRet.BuildQuorumsDiff(baseBlockIndex, blockIndex)) {
-        errorRet = strprintf("failed to build quorums diff");
-        return false;
-    }
-
-    // TODO store coinbase TX in CBlockIndex
-    CBlock block;
-    if (!ReadBlockFromDisk(block, blockIndex, Params().GetConsensus())) {
-        errorRet = strprintf("failed to read block %s from disk", blockHash.ToString());
-        return false;
+    mnListDiffRet.deletedQuorums = std::move(quorumsDiff.deletedQuorums);
+    mnListDiffRet.newQuorums = std::move(quorumsDiff.newQuorums);
+
+    CSimplifiedMNListCbTxProof cbTxProof;
+    if (!evoDb->Read(std::make_pair(DB_CBTX_PROOF, blockHash), cbTxProof)) {
+        // proof was pruned or the block was connected before proofs were stored
+        CBlock block;
+        {
+            LOCK(cs_main);
+            if (!ReadBlockFromDisk(block, blockIndex, Params().GetConsensus())) {
+                errorRet = strprintf("failed to read block %s from disk", blockHash.ToString());
+                return false;
+            }
+        }
+        cbTxProof = CSimplifiedMNListCbTxProof(block);
     }
 
-    mnListDiffRet.cbTx = block.vtx[0];
+    mnListDiffRet.cbTx = cbTxProof.cbTx;
+    mnListDiffRet.cbTxMerkleTree = cbTxProof.cbTxMerkleTree;
 
-    std::vector<uint256> vHashes;
-    std::vector<bool> vMatch(block.vtx.size(), false);
-    for (const auto& tx : block.vtx) {
-        vHashes.emplace_back(tx->GetHash());
-    }
-    vMatch[0] = true; // only coinbase matches
-    mnListDiffRet.cbTxMerkleTree = CPartialMerkleTree(vHashes, vMatch);
+    LOCK(cs_mnListDiffCache);
+    mnListDiffCache.insert(std::make_pair(baseBlockHash, blockHash), mnListDiffRet);
 
     return true;
 }
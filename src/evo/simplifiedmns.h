@@ -12,9 +12,15 @@
 #include "serialize.h"
 #include "version.h"
 
+#include <map>
+#include <memory>
+
 class UniValue;
+class CBlock;
+class CBlockIndex;
 class CDeterministicMNList;
 class CDeterministicMN;
+class CDeterministicMNState;
 
 namespace llmq
 {
@@ -84,6 +90,28 @@ public:
     uint256 CalcMerkleRoot(bool* pmutated = NULL) const;
 };
 
+/// Merkle tree over the SML entries of a deterministic MN list which is updated with the differences between the lists
+/// passed to Update() instead of being rebuilt. Leaves are sorted by proRegTxHash like in CSimplifiedMNList, so updating
+/// an entry rehashes its path to the root while adding or removing one rehashes the nodes right of it as leaves move.
+class CSimplifiedMNListMerkleTree
+{
+private:
+    struct Leaf {
+        std::shared_ptr<const CDeterministicMNState> pdmnState;
+        uint256 hash;
+        uint64_t nEpoch;
+    };
+
+    std::map<uint256, Leaf> leaves;
+    std::vector<std::vector<uint256>> levels;
+    uint64_t nEpoch{0};
+
+public:
+    // returns the same root as CSimplifiedMNList(mnList).CalcMerkleRoot()
+    uint256 Update(const CDeterministicMNList& mnList);
+    uint256 GetRoot() const;
+};
+
 /// P2P messages
 
 class CGetSimplifiedMNListDiff
@@ -145,6 +173,32 @@ public:
     void ToJson(UniValue& obj) const;
 };
 
+/// Coinbase of a block together with the proof of its inclusion, stored for recent blocks when they are connected
+/// so that diffs can be served without reading the block from disk
+class CSimplifiedMNListCbTxProof
+{
+public:
+    CTransactionRef cbTx;
+    CPartialMerkleTree cbTxMerkleTree;
+
+public:
+    CSimplifiedMNListCbTxProof() {}
+    CSimplifiedMNListCbTxProof(const CBlock& block);
+
+    ADD_SERIALIZE_METHODS;
+
+    template <typename Stream, typename Operation>
+    inline void SerializationOp(Stream& s, Operation ser_action)
+    {
+        READWRITE(cbTx);
+        READWRITE(cbTxMerkleTree);
+    }
+};
+
+void WriteCbTxProof(const CBlock& block, const CBlockIndex* pindex);
+void EraseCbTxProof(const CBlockIndex* pindex);
+
+// cs_main is only taken for the block index lookups and the parts reading the current evoDb state
 bool BuildSimplifiedMNListDiff(const uint256& baseBlockHash, const uint256& blockHash, CSimplifiedMNListDiff& mnListDiffRet, std::string& errorRet);
 
 #endif //ADOT_SIMPLIFIEDMNS_H
@@ -12,6 +12,7 @@
 
 #include "cbtx.h"
 #include "deterministicmns.h"
+#include "simplifiedmns.h"
 #include "specialtx.h"
 
 #include "llmq/quorums_commitment.h"
@@ -127,6 +128,10 @@ bool ProcessSpecialTxsInBlock(const CBlock& block, const CBlockIndex* pindex, CV
         return false;
     }
 
+    if (!fJustCheck && block.vtx[0]->nType == TRANSACTION_COINBASE) {
+        WriteCbTxProof(block, pindex);
+    }
+
     int64_t nTime5 = GetTimeMicros(); nTimeMerkle += nTime5 - nTime4;
     LogPrint("bench", "        - CheckCbTxMerkleRoots: %.2fms [%.2fs]\n", 0.001 * (nTime5 - nTime4), nTimeMerkle * 0.000001);
 
@@ -134,7 +139,8 @@ bool ProcessSpecialTxsInBlock(const CBlock& block, const CBlockIndex* pindex, CV
 
     // TODO_ADOT_COMMENT BDNS transactions from incoming blocks get processed only when pbdnsdb doesn't have the Reindexing flag set
     // the unindexed transactions from these new blocks are covered in the last section of ReindexBdnsRecords in validation.cpp
-    if (!pbdnsdb->AwaitsReindexing() && pindex->nHeight >= consensusParams.nHardForkEight)
+    // blocks that are only checked (e.g. TestBlockValidity for block templates) must not leave changes in the BDNS
+    if (!fJustCheck && pindex->nHeight >= consensusParams.nHardForkEight && !pbdnsdb->AwaitsReindexing())
         ProcessBdnsTransactions(block, *pindex, consensusParams);
 
     int64_t nTime6 = GetTimeMicros(); nTimeBDNS += nTime6 - nTime5;
@@ -160,9 +166,14 @@ bool UndoSpecialTxsInBlock(const CBlock& block, const CBlockIndex* pindex)
         return false;
     }
 
-    // the indexing of the BDNS doesn't currently handle chain re-organizations so we have to set the new height and let the index set its flags accordingly
-    if (!pbdnsdb->SetHeight(pindex->nHeight - 1))
-        LogPrintf("BlockchainDNS -- %s: failed to set the BDNS height\n", __func__);
+    EraseCbTxProof(pindex);
+
+    // restore the BDNS records changed by this block, without undo data the index flags a possible corruption by itself
+    if (pbdnsdb->AwaitsReindexing()) {
+        if (!pbdnsdb->SetHeight(pindex->nHeight - 1))
+            LogPrintf("BlockchainDNS -- %s: failed to set the BDNS height\n", __func__);
+    } else if (!pbdnsdb->UndoBlock(pindex->nHeight))
+        LogPrint("bdns", "BlockchainDNS -- %s: no undo data for block %s\n", __func__, pindex->GetBlockHash().ToString());
 
     return true;
 }
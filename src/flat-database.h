@@ -8,14 +8,85 @@
 #include "chainparams.h"
 #include "clientversion.h"
 #include "hash.h"
+#include "random.h"
 #include "streams.h"
 #include "util.h"
 
 #include <boost/filesystem.hpp>
 
+#include <algorithm>
+#include <vector>
+
+/** Default interval in minutes between background dumps of the cache files, 0 disables them */
+static const unsigned int DEFAULT_FLATDB_DUMP_INTERVAL = 15;
+
+/** Size of the chunks the cache files are written in */
+static const size_t FLATDB_CHUNK_SIZE = 1 << 16;
+
+/** Writes to a file in chunks of FLATDB_CHUNK_SIZE while hashing everything that was written */
+class CHashedChunkWriter
+{
+private:
+    CAutoFile& fileout;
+    CHashWriter hasher;
+    std::vector<char> vchChunk;
+
+public:
+    explicit CHashedChunkWriter(CAutoFile& fileoutIn) :
+        fileout(fileoutIn),
+        hasher(fileoutIn.GetType(), fileoutIn.GetVersion())
+    {
+        vchChunk.reserve(FLATDB_CHUNK_SIZE);
+    }
+
+    int GetType() const { return fileout.GetType(); }
+    int GetVersion() const { return fileout.GetVersion(); }
+
+    void write(const char* pch, size_t nSize)
+    {
+        while (nSize > 0) {
+            size_t nNow = std::min(nSize, FLATDB_CHUNK_SIZE - vchChunk.size());
+            vchChunk.insert(vchChunk.end(), pch, pch + nNow);
+            pch += nNow;
+            nSize -= nNow;
+            if (vchChunk.size() == FLATDB_CHUNK_SIZE) {
+                Flush();
+            }
+        }
+    }
+
+    void Flush()
+    {
+        if (vchChunk.empty()) {
+            return;
+        }
+        hasher.write(vchChunk.data(), vchChunk.size());
+        fileout.write(vchChunk.data(), vchChunk.size());
+        vchChunk.clear();
+    }
+
+    // flushes the remaining data, invalidates the object
+    uint256 GetHash()
+    {
+        Flush();
+        return hasher.GetHash();
+    }
+
+    template<typename T>
+    CHashedChunkWriter& operator<<(const T& obj)
+    {
+        ::Serialize(*this, obj);
+        return (*this);
+    }
+};
+
 /** 
 *   Generic Dumping and Loading
 *   ---------------------------
+*
+*   Files consist of a magic message, the network magic number, the serialized object and the
+*   double-SHA256 of everything before it. Both directions stream through the file and hash on
+*   the fly, so no copy of the whole file is ever held in memory.
 */
 
 template<typename T>
@@ -37,92 +108,65 @@ private:
     std::string strFilename;
     std::string strMagicMessage;
 
-    bool Write(const T& objToSave)
+    // Write payload (the object itself or a snapshot of its serialization) to a temporary file and move it into place
+    template<typename Payload>
+    bool WriteFile(const Payload& payload)
     {
-        // LOCK(objToSave.cs);
-
-        int64_t nStart = GetTimeMillis();
-
-        // serialize, checksum data up to that point, then append checksum
-        CDataStream ssObj(SER_DISK, CLIENT_VERSION);
-        ssObj << strMagicMessage; // specific magic message for this type of object
-        ssObj << FLATDATA(Params().MessageStart()); // network specific magic number
-        ssObj << objToSave;
-        uint256 hash = Hash(ssObj.begin(), ssObj.end());
-        ssObj << hash;
+        unsigned short randv = 0;
+        GetRandBytes((unsigned char*)&randv, sizeof(randv));
+        boost::filesystem::path pathTmp = GetDataDir() / strprintf("%s.%04x", strFilename, randv);
 
         // open output file, and associate with CAutoFile
-        FILE *file = fopen(pathDB.string().c_str(), "wb");
+        FILE *file = fopen(pathTmp.string().c_str(), "wb");
         CAutoFile fileout(file, SER_DISK, CLIENT_VERSION);
         if (fileout.IsNull())
-            return error("%s: Failed to open file %s", __func__, pathDB.string());
+            return error("%s: Failed to open file %s", __func__, pathTmp.string());
 
-        // Write and commit header, data
+        // serialize and checksum data in chunks, then append checksum
         try {
-            fileout << ssObj;
+            CHashedChunkWriter writer(fileout);
+            writer << strMagicMessage; // specific magic message for this type of object
+            writer << FLATDATA(Params().MessageStart()); // network specific magic number
+            writer << payload;
+            uint256 hash = writer.GetHash();
+            fileout << hash;
         }
         catch (std::exception &e) {
+            fileout.fclose();
+            boost::filesystem::remove(pathTmp);
             return error("%s: Serialize or I/O error - %s", __func__, e.what());
         }
+        FileCommit(fileout.Get());
         fileout.fclose();
 
-        LogPrintf("Written info to %s  %dms\n", strFilename, GetTimeMillis() - nStart);
-        LogPrintf("     %s\n", objToSave.ToString());
+        // replace the existing file only once the new one is complete
+        if (!RenameOver(pathTmp, pathDB))
+            return error("%s: Rename-into-place failed", __func__);
 
         return true;
     }
 
-    ReadResult Read(T& objToLoad, bool fDryRun = false)
+    bool Write(const T& objToSave)
     {
-        //LOCK(objToLoad.cs);
-
         int64_t nStart = GetTimeMillis();
-        // open input file, and associate with CAutoFile
-        FILE *file = fopen(pathDB.string().c_str(), "rb");
-        CAutoFile filein(file, SER_DISK, CLIENT_VERSION);
-        if (filein.IsNull())
-        {
-            error("%s: Failed to open file %s", __func__, pathDB.string());
-            return FileError;
-        }
-
-        // use file size to size memory buffer
-        int fileSize = boost::filesystem::file_size(pathDB);
-        int dataSize = fileSize - sizeof(uint256);
-        // Don't try to resize to a negative number if file is small
-        if (dataSize < 0)
-            dataSize = 0;
-        std::vector<unsigned char> vchData;
-        vchData.resize(dataSize);
-        uint256 hashIn;
-
-        // read data and checksum from file
-        try {
-            filein.read((char *)&vchData[0], dataSize);
-            filein >> hashIn;
-        }
-        catch (std::exception &e) {
-            error("%s: Deserialize or I/O error - %s", __func__, e.what());
-            return HashReadError;
-        }
-        filein.fclose();
 
-        CDataStream ssObj(vchData, SER_DISK, CLIENT_VERSION);
+        if (!WriteFile(objToSave))
+            return false;
 
-        // verify stored checksum matches input data
-        uint256 hashTmp = Hash(ssObj.begin(), ssObj.end());
-        if (hashIn != hashTmp)
-        {
-            error("%s: Checksum mismatch, data corrupted", __func__);
-            return IncorrectHash;
-        }
+        LogPrintf("Written info to %s  %dms\n", strFilename, GetTimeMillis() - nStart);
+        LogPrintf("     %s\n", objToSave.ToString());
 
+        return true;
+    }
 
+    template<typename Stream>
+    ReadResult ReadHeader(Stream& stream)
+    {
         unsigned char pchMsgTmp[4];
         std::string strMagicMessageTmp;
         try {
             // de-serialize file header (file specific magic message) and ..
-            ssObj >> strMagicMessageTmp;
+            stream >> strMagicMessageTmp;
 
             // ... verify the message matches predefined one
             if (strMagicMessage != strMagicMessageTmp)
@@ -133,7 +177,7 @@ private:
 
 
             // de-serialize file header (network specific magic number) and ..
-            ssObj >> FLATDATA(pchMsgTmp);
+            stream >> FLATDATA(pchMsgTmp);
 
             // ... verify the network matches ours
             if (memcmp(pchMsgTmp, Params().MessageStart(), sizeof(pchMsgTmp)))
@@ -141,9 +185,70 @@ private:
                 error("%s: Invalid network magic number", __func__);
                 return IncorrectMagicNumber;
             }
+        }
+        catch (std::exception &e) {
+            error("%s: Deserialize or I/O error - %s", __func__, e.what());
+            return IncorrectFormat;
+        }
+
+        return Ok;
+    }
+
+    // Only check the header, this is enough to know that the file is ours and may be overwritten
+    ReadResult VerifyHeader()
+    {
+        FILE *file = fopen(pathDB.string().c_str(), "rb");
+        CAutoFile filein(file, SER_DISK, CLIENT_VERSION);
+        if (filein.IsNull())
+        {
+            error("%s: Failed to open file %s", __func__, pathDB.string());
+            return FileError;
+        }
+
+        return ReadHeader(filein);
+    }
+
+    ReadResult Read(T& objToLoad)
+    {
+        //LOCK(objToLoad.cs);
+
+        int64_t nStart = GetTimeMillis();
+        // open input file, and associate with CAutoFile
+        FILE *file = fopen(pathDB.string().c_str(), "rb");
+        CAutoFile filein(file, SER_DISK, CLIENT_VERSION);
+        if (filein.IsNull())
+        {
+            error("%s: Failed to open file %s", __func__, pathDB.string());
+            return FileError;
+        }
+
+        boost::system::error_code ec;
+        uintmax_t nFileSize = boost::filesystem::file_size(pathDB, ec);
+        if (ec || nFileSize < sizeof(uint256))
+        {
+            error("%s: Failed to get size of file %s", __func__, pathDB.string());
+            return IncorrectFormat;
+        }
+        // size of everything in front of the checksum
+        const uintmax_t nDataSize = nFileSize - sizeof(uint256);
 
+        // hash everything while it is being read, the checksum is only known at the end of the file
+        CHashVerifier<CAutoFile> verifier(&filein);
+
+        ReadResult headerResult = ReadHeader(verifier);
+        if (headerResult != Ok)
+            return headerResult;
+
+        try {
             // de-serialize data into T object
-            ssObj >> objToLoad;
+            verifier >> objToLoad;
+
+            // objects stop reading early when they find data of another version,
+            // the remainder still has to be hashed to get to the checksum
+            long nPos = ftell(filein.Get());
+            if (nPos < 0 || (uintmax_t)nPos > nDataSize)
+                throw std::ios_base::failure("Payload overlaps the checksum");
+            verifier.ignore(nDataSize - nPos);
         }
         catch (std::exception &e) {
             objToLoad.Clear();
@@ -151,13 +256,31 @@ private:
             return IncorrectFormat;
         }
 
+        // read checksum from file
+        uint256 hashIn;
+        try {
+            filein >> hashIn;
+        }
+        catch (std::exception &e) {
+            objToLoad.Clear();
+            error("%s: Deserialize or I/O error - %s", __func__, e.what());
+            return HashReadError;
+        }
+        filein.fclose();
+
+        // verify stored checksum matches input data
+        if (hashIn != verifier.GetHash())
+        {
+            objToLoad.Clear();
+            error("%s: Checksum mismatch, data corrupted", __func__);
+            return IncorrectHash;
+        }
+
         LogPrintf("Loaded info from %s  %dms\n", strFilename, GetTimeMillis() - nStart);
         LogPrintf("     %s\n", objToLoad.ToString());
-        if(!fDryRun) {
-            LogPrintf("%s: Cleaning....\n", __func__);
-            objToLoad.CheckAndRemove();
-            LogPrintf("     %s\n", objToLoad.ToString());
-        }
+        LogPrintf("%s: Cleaning....\n", __func__);
+        objToLoad.CheckAndRemove();
+        LogPrintf("     %s\n", objToLoad.ToString());
 
         return Ok;
     }
@@ -198,8 +321,7 @@ public:
         int64_t nStart = GetTimeMillis();
 
         LogPrintf("Verifying %s format...\n", strFilename);
-        T tmpObjToLoad;
-        ReadResult readResult = Read(tmpObjToLoad, true);
+        ReadResult readResult = VerifyHeader();
 
         // there was an error and it was not an error on file opening => do not proceed
         if (readResult == FileError)
@@ -223,6 +345,27 @@ public:
         return true;
     }
 
+    /**
+     * Dump while the node keeps running. The object is only locked (by its own serialization code)
+     * while it gets serialized into memory, hashing and writing the file happens without any lock held.
+     * The file was checked by Load() on startup, so its format is not verified again.
+     */
+    bool DumpSnapshot(const T& objToSave)
+    {
+        int64_t nStart = GetTimeMillis();
+
+        CDataStream ssObj(SER_DISK, CLIENT_VERSION);
+        ssObj << objToSave;
+        int64_t nSnapshotTime = GetTimeMillis() - nStart;
+
+        if (!WriteFile(ssObj))
+            return false;
+
+        LogPrintf("%s snapshot written, %d bytes  %dms (serialization %dms)\n", strFilename, ssObj.size(), GetTimeMillis() - nStart, nSnapshotTime);
+
+        return true;
+    }
+
 };
 
 
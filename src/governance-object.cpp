@@ -224,6 +224,20 @@ bool CGovernanceObject::ProcessVote(CNode* pfrom,
     return true;
 }
 
+void CGovernanceObject::LoadVote(const CGovernanceVote& vote)
+{
+    LOCK(cs);
+
+    vote_instance_t& voteInstanceRef = mapCurrentMNVotes[vote.GetMasternodeOutpoint()].mapInstances[int(vote.GetSignal())];
+    // same rules as in ProcessVote, the newest vote wins and equal timestamps are decided by the outcome
+    if (vote.GetTimestamp() > voteInstanceRef.nCreationTime ||
+        (vote.GetTimestamp() == voteInstanceRef.nCreationTime && vote.GetOutcome() >= voteInstanceRef.eOutcome)) {
+        voteInstanceRef = vote_instance_t(vote.GetOutcome(), vote.GetTimestamp(), vote.GetTimestamp());
+    }
+    fileVotes.LoadVote(vote);
+    fDirtyCache = true;
+}
+
 void CGovernanceObject::ClearMasternodeVotes()
 {
     LOCK(cs);
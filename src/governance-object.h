@@ -320,13 +320,9 @@ public:
             READWRITE(vchSig);
         }
         if (s.GetType() & SER_DISK) {
-            // Only include these for the disk file format
-            LogPrint("gobject", "CGovernanceObject::SerializationOp Reading/writing votes from/to disk\n");
+            // Only include these for the disk file format, votes are stored separately (see CGovernanceDB)
             READWRITE(nDeletionTime);
             READWRITE(fExpired);
-            READWRITE(mapCurrentMNVotes);
-            READWRITE(fileVotes);
-            LogPrint("gobject", "CGovernanceObject::SerializationOp hash = %s, vote count = %d\n", GetHash().ToString(), fileVotes.GetVoteCount());
         }
 
         // AFTER DESERIALIZATION OCCURS, CACHED VARIABLES MUST BE CALCULATED MANUALLY
@@ -342,6 +338,9 @@ private:
         CGovernanceException& exception,
         CConnman& connman);
 
+    /// Restore a vote read from the database, the vote was validated when it was first processed
+    void LoadVote(const CGovernanceVote& vote);
+
     /// Called when MN's which have voted on this object have been removed
     void ClearMasternodeVotes();
 
@@ -4,19 +4,107 @@
 
 #include "governance-votedb.h"
 
+#include "util.h"
+
+const char CGovernanceDB::DB_OBJECT = 'o';
+const char CGovernanceDB::DB_VOTE = 'v';
+
+CGovernanceDB* pgovernancedb = nullptr;
+
+CGovernanceDB::CGovernanceDB(size_t nCacheSize, bool fMemory, bool fWipe) :
+    CDBWrapper(GetDataDir() / "governance", nCacheSize, fMemory, fWipe)
+{
+}
+
+bool CGovernanceDB::EraseObject(const uint256& nHash)
+{
+    LOCK(cs);
+
+    CDBBatch batch(*this);
+    batch.Erase(std::make_pair(DB_OBJECT, nHash));
+
+    std::unique_ptr<CDBIterator> pcursor(NewIterator());
+    pcursor->Seek(std::make_pair(DB_VOTE, std::make_pair(nHash, uint256())));
+
+    while (pcursor->Valid()) {
+        std::pair<char, vote_key_t> key;
+        if (!pcursor->GetKey(key) || key.first != DB_VOTE || key.second.first != nHash) {
+            break;
+        }
+        batch.Erase(key);
+        voteCache.erase(key.second);
+        pcursor->Next();
+    }
+
+    return WriteBatch(batch);
+}
+
+bool CGovernanceDB::UpdateVotes(const uint256& nParentHash, const std::vector<CGovernanceVote>& vecWrite, const std::vector<uint256>& vecErase)
+{
+    LOCK(cs);
+
+    CDBBatch batch(*this);
+    for (const auto& nHash : vecErase) {
+        vote_key_t voteKey(nParentHash, nHash);
+        batch.Erase(std::make_pair(DB_VOTE, voteKey));
+        voteCache.erase(voteKey);
+    }
+    for (const auto& vote : vecWrite) {
+        vote_key_t voteKey(nParentHash, vote.GetHash());
+        batch.Write(std::make_pair(DB_VOTE, voteKey), vote);
+        voteCache.insert(voteKey, std::make_shared<const CGovernanceVote>(vote));
+    }
+
+    return WriteBatch(batch);
+}
+
+std::shared_ptr<const CGovernanceVote> CGovernanceDB::ReadVote(const uint256& nParentHash, const uint256& nHash)
+{
+    LOCK(cs);
+
+    vote_key_t voteKey(nParentHash, nHash);
+    std::shared_ptr<const CGovernanceVote> pvote;
+    if (voteCache.get(voteKey, pvote)) {
+        return pvote;
+    }
+    auto pvoteRead = std::make_shared<CGovernanceVote>();
+    if (!Read(std::make_pair(DB_VOTE, voteKey), *pvoteRead)) {
+        return nullptr;
+    }
+    voteCache.insert(voteKey, pvoteRead);
+    return pvoteRead;
+}
+
+void CGovernanceDB::ReadVotes(const uint256& nParentHash, std::vector<CGovernanceVote>& vecVotes)
+{
+    LOCK(cs);
+
+    std::unique_ptr<CDBIterator> pcursor(NewIterator());
+    pcursor->Seek(std::make_pair(DB_VOTE, std::make_pair(nParentHash, uint256())));
+
+    while (pcursor->Valid()) {
+        std::pair<char, vote_key_t> key;
+        if (!pcursor->GetKey(key) || key.first != DB_VOTE || key.second.first != nParentHash) {
+            break;
+        }
+        CGovernanceVote vote;
+        if (pcursor->GetValue(vote)) {
+            vecVotes.push_back(vote);
+        }
+        pcursor->Next();
+    }
+}
+
 CGovernanceObjectVoteFile::CGovernanceObjectVoteFile() :
-    nMemoryVotes(0),
-    listVotes(),
+    nParentHash(),
     mapVoteIndex()
 {
 }
 
 CGovernanceObjectVoteFile::CGovernanceObjectVoteFile(const CGovernanceObjectVoteFile& other) :
-    nMemoryVotes(other.nMemoryVotes),
-    listVotes(other.listVotes),
-    mapVoteIndex()
+    nParentHash(other.nParentHash),
+    mapVoteIndex(other.mapVoteIndex)
 {
-    RebuildIndex();
 }
 
 void CGovernanceObjectVoteFile::AddVote(const CGovernanceVote& vote)
@@ -25,10 +113,17 @@ void CGovernanceObjectVoteFile::AddVote(const CGovernanceVote& vote)
     // make sure to never add/update already known votes
     if (HasVote(nHash))
         return;
-    listVotes.push_front(vote);
-    mapVoteIndex.emplace(nHash, listVotes.begin());
-    ++nMemoryVotes;
-    RemoveOldVotes(vote);
+    nParentHash = vote.GetParentHash();
+    std::vector<uint256> vecErased;
+    RemoveOldVotes(vote, vecErased);
+    pgovernancedb->UpdateVotes(nParentHash, {vote}, vecErased);
+    LoadVote(vote);
+}
+
+void CGovernanceObjectVoteFile::LoadVote(const CGovernanceVote& vote)
+{
+    nParentHash = vote.GetParentHash();
+    mapVoteIndex.emplace(vote.GetHash(), vote_index_t{vote.GetMasternodeOutpoint(), int(vote.GetSignal()), vote.GetTimestamp()});
 }
 
 bool CGovernanceObjectVoteFile::HasVote(const uint256& nHash) const
@@ -38,91 +133,93 @@ bool CGovernanceObjectVoteFile::HasVote(const uint256& nHash) const
 
 bool CGovernanceObjectVoteFile::SerializeVoteToStream(const uint256& nHash, CDataStream& ss) const
 {
-    vote_m_cit it = mapVoteIndex.find(nHash);
-    if (it == mapVoteIndex.end()) {
+    if (!HasVote(nHash)) {
+        return false;
+    }
+    auto pvote = pgovernancedb->ReadVote(nParentHash, nHash);
+    if (!pvote) {
         return false;
     }
-    ss << *(it->second);
+    ss << *pvote;
     return true;
 }
 
 std::vector<CGovernanceVote> CGovernanceObjectVoteFile::GetVotes() const
 {
     std::vector<CGovernanceVote> vecResult;
-    for (vote_l_cit it = listVotes.begin(); it != listVotes.end(); ++it) {
-        vecResult.push_back(*it);
+    if (mapVoteIndex.empty()) {
+        return vecResult;
+    }
+    vecResult.reserve(mapVoteIndex.size());
+    pgovernancedb->ReadVotes(nParentHash, vecResult);
+    return vecResult;
+}
+
+std::vector<uint256> CGovernanceObjectVoteFile::GetVoteHashes() const
+{
+    std::vector<uint256> vecResult;
+    vecResult.reserve(mapVoteIndex.size());
+    for (const auto& p : mapVoteIndex) {
+        vecResult.push_back(p.first);
     }
     return vecResult;
 }
 
 void CGovernanceObjectVoteFile::RemoveVotesFromMasternode(const COutPoint& outpointMasternode)
 {
-    vote_l_it it = listVotes.begin();
-    while (it != listVotes.end()) {
-        if (it->GetMasternodeOutpoint() == outpointMasternode) {
-            --nMemoryVotes;
-            mapVoteIndex.erase(it->GetHash());
-            listVotes.erase(it++);
+    std::vector<uint256> vecErased;
+    vote_m_it it = mapVoteIndex.begin();
+    while (it != mapVoteIndex.end()) {
+        if (it->second.masternodeOutpoint == outpointMasternode) {
+            vecErased.push_back(it->first);
+            mapVoteIndex.erase(it++);
         } else {
             ++it;
         }
     }
+    if (!vecErased.empty()) {
+        pgovernancedb->UpdateVotes(nParentHash, {}, vecErased);
+    }
 }
 
 std::set<uint256> CGovernanceObjectVoteFile::RemoveInvalidVotes(const COutPoint& outpointMasternode, bool fProposal)
 {
     std::set<uint256> removedVotes;
+    std::vector<uint256> vecErased;
 
-    vote_l_it it = listVotes.begin();
-    while (it != listVotes.end()) {
-        if (it->GetMasternodeOutpoint() == outpointMasternode) {
-            bool useVotingKey = fProposal && (it->GetSignal() == VOTE_SIGNAL_FUNDING);
-            if (!it->IsValid(useVotingKey)) {
-                removedVotes.emplace(it->GetHash());
-                --nMemoryVotes;
-                mapVoteIndex.erase(it->GetHash());
-                listVotes.erase(it++);
+    vote_m_it it = mapVoteIndex.begin();
+    while (it != mapVoteIndex.end()) {
+        if (it->second.masternodeOutpoint == outpointMasternode) {
+            bool useVotingKey = fProposal && (it->second.nSignal == VOTE_SIGNAL_FUNDING);
+            auto pvote = pgovernancedb->ReadVote(nParentHash, it->first);
+            if (!pvote || !pvote->IsValid(useVotingKey)) {
+                removedVotes.emplace(it->first);
+                vecErased.push_back(it->first);
+                mapVoteIndex.erase(it++);
                 continue;
             }
         }
         ++it;
     }
+    if (!vecErased.empty()) {
+        pgovernancedb->UpdateVotes(nParentHash, {}, vecErased);
+    }
 
     return removedVotes;
 }
 
-void CGovernanceObjectVoteFile::RemoveOldVotes(const CGovernanceVote& vote)
+void CGovernanceObjectVoteFile::RemoveOldVotes(const CGovernanceVote& vote, std::vector<uint256>& vecErased)
 {
-    vote_l_it it = listVotes.begin();
-    while (it != listVotes.end()) {
-        if (it->GetMasternodeOutpoint() == vote.GetMasternodeOutpoint() // same masternode
-            && it->GetParentHash() == vote.GetParentHash() // same governance object (e.g. same proposal)
-            && it->GetSignal() == vote.GetSignal() // same signal (e.g. "funding", "delete", etc.)
-            && it->GetTimestamp() < vote.GetTimestamp()) // older than new vote
+    vote_m_it it = mapVoteIndex.begin();
+    while (it != mapVoteIndex.end()) {
+        if (it->second.masternodeOutpoint == vote.GetMasternodeOutpoint() // same masternode
+            && it->second.nSignal == int(vote.GetSignal()) // same signal (e.g. "funding", "delete", etc.)
+            && it->second.nTimestamp < vote.GetTimestamp()) // older than new vote
         {
-            --nMemoryVotes;
-            mapVoteIndex.erase(it->GetHash());
-            listVotes.erase(it++);
+            vecErased.push_back(it->first);
+            mapVoteIndex.erase(it++);
         } else {
             ++it;
         }
     }
 }
-
-void CGovernanceObjectVoteFile::RebuildIndex()
-{
-    mapVoteIndex.clear();
-    nMemoryVotes = 0;
-    vote_l_it it = listVotes.begin();
-    while (it != listVotes.end()) {
-        CGovernanceVote& vote = *it;
-        uint256 nHash = vote.GetHash();
-        if (mapVoteIndex.find(nHash) == mapVoteIndex.end()) {
-            mapVoteIndex[nHash] = it;
-            ++nMemoryVotes;
-            ++it;
-        } else {
-            listVotes.erase(it++);
-        }
-    }
-}
@@ -5,43 +5,106 @@
 #ifndef GOVERNANCE_VOTEDB_H
 #define GOVERNANCE_VOTEDB_H
 
-#include <list>
 #include <map>
+#include <memory>
+#include <set>
+#include <utility>
+#include <vector>
 
+#include "dbwrapper.h"
 #include "governance-vote.h"
+#include "saltedhasher.h"
 #include "serialize.h"
 #include "streams.h"
+#include "sync.h"
 #include "uint256.h"
+#include "unordered_lru_cache.h"
+
+/**
+ * Append-only store for governance objects and their votes (governance/)
+ *
+ * Objects are keyed by their hash and votes by the hash of their parent object followed
+ * by their own hash, so all votes of an object can be read or dropped with one range scan.
+ * Recently written or read votes are kept in a small cache as these are the ones peers ask for.
+ */
+class CGovernanceDB : public CDBWrapper
+{
+public:
+    static const char DB_OBJECT;
+    static const char DB_VOTE;
+
+    static const size_t VOTE_CACHE_SIZE = 10000;
+
+private:
+    typedef std::pair<uint256, uint256> vote_key_t;
+
+    CCriticalSection cs;
+    unordered_lru_cache<vote_key_t, std::shared_ptr<const CGovernanceVote>, StaticSaltedHasher, VOTE_CACHE_SIZE> voteCache;
+
+public:
+    CGovernanceDB(size_t nCacheSize, bool fMemory = false, bool fWipe = false);
+
+    template <typename T>
+    bool WriteObject(const uint256& nHash, const T& obj)
+    {
+        return Write(std::make_pair(DB_OBJECT, nHash), obj);
+    }
+
+    /** Read all stored objects into mapObjectsOut, objects that are already present are left untouched */
+    template <typename T>
+    void ReadObjects(std::map<uint256, T>& mapObjectsOut)
+    {
+        std::unique_ptr<CDBIterator> pcursor(NewIterator());
+        pcursor->Seek(std::make_pair(DB_OBJECT, uint256()));
+
+        while (pcursor->Valid()) {
+            std::pair<char, uint256> key;
+            if (!pcursor->GetKey(key) || key.first != DB_OBJECT) {
+                break;
+            }
+            auto objpair = mapObjectsOut.emplace(key.second, T());
+            if (objpair.second && !pcursor->GetValue(objpair.first->second)) {
+                mapObjectsOut.erase(objpair.first);
+            }
+            pcursor->Next();
+        }
+    }
+
+    /** Erase an object together with all of its votes */
+    bool EraseObject(const uint256& nHash);
+
+    /** Write vecWrite and erase the votes in vecErase for the object nParentHash in one batch */
+    bool UpdateVotes(const uint256& nParentHash, const std::vector<CGovernanceVote>& vecWrite, const std::vector<uint256>& vecErase);
+    /** Returns nullptr if the vote is not stored */
+    std::shared_ptr<const CGovernanceVote> ReadVote(const uint256& nParentHash, const uint256& nHash);
+    void ReadVotes(const uint256& nParentHash, std::vector<CGovernanceVote>& vecVotes);
+};
+
+extern CGovernanceDB* pgovernancedb;
 
 /**
  * Represents the collection of votes associated with a given CGovernanceObject
- * Recently received votes are held in memory until a maximum size is reached after
- * which older votes a flushed to a disk file.
  *
- * Note: This is a stub implementation that doesn't limit the number of votes held
- * in memory and doesn't flush to disk.
+ * Only a compact index of the votes is held in memory, the votes themselves are written to
+ * pgovernancedb as they arrive and read back from there whenever they are needed.
  */
 class CGovernanceObjectVoteFile
 {
 public: // Types
-    typedef std::list<CGovernanceVote> vote_l_t;
+    struct vote_index_t {
+        COutPoint masternodeOutpoint;
+        int nSignal;
+        int64_t nTimestamp;
+    };
 
-    typedef vote_l_t::iterator vote_l_it;
-
-    typedef vote_l_t::const_iterator vote_l_cit;
-
-    typedef std::map<uint256, vote_l_it> vote_m_t;
+    typedef std::map<uint256, vote_index_t> vote_m_t;
 
     typedef vote_m_t::iterator vote_m_it;
 
     typedef vote_m_t::const_iterator vote_m_cit;
 
 private:
-    static const int MAX_MEMORY_VOTES = -1;
-
-    int nMemoryVotes;
-
-    vote_l_t listVotes;
+    uint256 nParentHash;
 
     vote_m_t mapVoteIndex;
 
@@ -51,47 +114,39 @@ public:
     CGovernanceObjectVoteFile(const CGovernanceObjectVoteFile& other);
 
     /**
-     * Add a vote to the file
+     * Add a vote to the file and write it to the database
      */
     void AddVote(const CGovernanceVote& vote);
 
     /**
-     * Return true if the vote with this hash is currently cached in memory
+     * Add a vote that was read from the database to the index
+     */
+    void LoadVote(const CGovernanceVote& vote);
+
+    /**
+     * Return true if the vote with this hash is part of the file
      */
     bool HasVote(const uint256& nHash) const;
 
     /**
-     * Retrieve a vote cached in memory
+     * Read a vote from the database
      */
     bool SerializeVoteToStream(const uint256& nHash, CDataStream& ss) const;
 
-    int GetVoteCount()
+    int GetVoteCount() const
     {
-        return nMemoryVotes;
+        return mapVoteIndex.size();
     }
 
     std::vector<CGovernanceVote> GetVotes() const;
+    std::vector<uint256> GetVoteHashes() const;
 
     void RemoveVotesFromMasternode(const COutPoint& outpointMasternode);
     std::set<uint256> RemoveInvalidVotes(const COutPoint& outpointMasternode, bool fProposal);
 
-    ADD_SERIALIZE_METHODS;
-
-    template <typename Stream, typename Operation>
-    inline void SerializationOp(Stream& s, Operation ser_action)
-    {
-        READWRITE(nMemoryVotes);
-        READWRITE(listVotes);
-        if (ser_action.ForRead()) {
-            RebuildIndex();
-        }
-    }
-
 private:
     // Drop older votes for the same gobject from the same masternode
-    void RemoveOldVotes(const CGovernanceVote& vote);
-
-    void RebuildIndex();
+    void RemoveOldVotes(const CGovernanceVote& vote, std::vector<uint256>& vecErased);
 };
 
 #endif
@@ -24,7 +24,7 @@ CGovernanceManager governance;
 
 int nSubmittedFinalBudget;
 
-const std::string CGovernanceManager::SERIALIZATION_VERSION_STRING = "CGovernanceManager-Version-15";
+const std::string CGovernanceManager::SERIALIZATION_VERSION_STRING = "CGovernanceManager-Version-16";
 const int CGovernanceManager::MAX_TIME_FUTURE_DEVIATION = 60 * 60;
 const int CGovernanceManager::RELIABLE_PROPAGATION_TIME = 60;
 
@@ -40,6 +40,7 @@ CGovernanceManager::CGovernanceManager() :
     mapLastMasternodeObject(),
     setRequestedObjects(),
     fRateChecksEnabled(true),
+    fCacheLoaded(false),
     cs()
 {
 }
@@ -324,6 +325,8 @@ void CGovernanceManager::AddGovernanceObject(CGovernanceObject& govobj, CConnman
         return;
     }
 
+    pgovernancedb->WriteObject(nHash, govobj);
+
     // SHOULD WE ADD THIS OBJECT TO ANY OTHER MANANGERS?
 
     LogPrint("gobject", "CGovernanceManager::AddGovernanceObject -- Before trigger block, GetDataAsPlainString = %s, nObjectType = %d\n",
@@ -336,6 +339,7 @@ void CGovernanceManager::AddGovernanceObject(CGovernanceObject& govobj, CConnman
             objref.fCachedDelete = true;
             if (objref.nDeletionTime == 0) {
                 objref.nDeletionTime = GetAdjustedTime();
+                pgovernancedb->WriteObject(nHash, objref);
             }
             return;
         }
@@ -377,6 +381,15 @@ void CGovernanceManager::UpdateCachesAndClean()
 
     ScopedLockBool guard(cs, fRateChecksEnabled, false);
 
+    // Triggers get marked for deletion or expired by the trigger manager, remember
+    // how they were before so the changes get written to pgovernancedb below
+    std::map<uint256, std::pair<int64_t, bool> > mapPrevTriggerState;
+    for (const auto& objpair : mapObjects) {
+        if (objpair.second.GetObjectType() == GOVERNANCE_OBJECT_TRIGGER) {
+            mapPrevTriggerState.emplace(objpair.first, std::make_pair(objpair.second.GetDeletionTime(), objpair.second.IsSetExpired()));
+        }
+    }
+
     // Clean up any expired or invalid triggers
     triggerman.CleanAndRemove();
 
@@ -393,6 +406,12 @@ void CGovernanceManager::UpdateCachesAndClean()
 
         uint256 nHash = it->first;
         std::string strHash = nHash.ToString();
+        int64_t nPrevDeletionTime = pObj->GetDeletionTime();
+        bool fPrevExpired = pObj->IsSetExpired();
+        auto itPrevTriggerState = mapPrevTriggerState.find(nHash);
+        if (itPrevTriggerState != mapPrevTriggerState.end()) {
+            std::tie(nPrevDeletionTime, fPrevExpired) = itPrevTriggerState->second;
+        }
 
         // IF CACHE IS NOT DIRTY, WHY DO THIS?
         if (pObj->IsSetDirtyCache()) {
@@ -439,6 +458,7 @@ void CGovernanceManager::UpdateCachesAndClean()
             }
 
             mapErasedGovernanceObjects.insert(std::make_pair(nHash, nTimeExpired));
+            pgovernancedb->EraseObject(nHash);
             mapObjects.erase(it++);
         } else {
             // NOTE: triggers are handled via triggerman
@@ -452,6 +472,9 @@ void CGovernanceManager::UpdateCachesAndClean()
                     }
                 }
             }
+            if (pObj->GetDeletionTime() != nPrevDeletionTime || pObj->IsSetExpired() != fPrevExpired) {
+                pgovernancedb->WriteObject(nHash, *pObj);
+            }
             ++it;
         }
     }
@@ -999,10 +1022,10 @@ void CGovernanceManager::RequestGovernanceObject(CNode* pfrom, const uint256& nH
 
         if (pObj) {
             filter = CBloomFilter(Params().GetConsensus().nGovernanceFilterElements, GOVERNANCE_FILTER_FP_RATE, GetRandInt(999999), BLOOM_UPDATE_ALL);
-            std::vector<CGovernanceVote> vecVotes = pObj->GetVoteFile().GetVotes();
-            nVoteCount = vecVotes.size();
-            for (const auto& vote : vecVotes) {
-                filter.insert(vote.GetHash());
+            std::vector<uint256> vecVoteHashes = pObj->GetVoteFile().GetVoteHashes();
+            nVoteCount = vecVoteHashes.size();
+            for (const auto& nVoteHash : vecVoteHashes) {
+                filter.insert(nVoteHash);
             }
         }
     }
@@ -1156,9 +1179,8 @@ void CGovernanceManager::RebuildIndexes()
     cmapVoteToObject.Clear();
     for (auto& objPair : mapObjects) {
         CGovernanceObject& govobj = objPair.second;
-        std::vector<CGovernanceVote> vecVotes = govobj.GetVoteFile().GetVotes();
-        for (size_t i = 0; i < vecVotes.size(); ++i) {
-            cmapVoteToObject.Insert(vecVotes[i].GetHash(), &govobj);
+        for (const auto& nVoteHash : govobj.GetVoteFile().GetVoteHashes()) {
+            cmapVoteToObject.Insert(nVoteHash, &govobj);
         }
     }
 }
@@ -1178,16 +1200,33 @@ void CGovernanceManager::AddCachedTriggers()
             govobj.fCachedDelete = true;
             if (govobj.nDeletionTime == 0) {
                 govobj.nDeletionTime = GetAdjustedTime();
+                pgovernancedb->WriteObject(objpair.first, govobj);
             }
         }
     }
 }
 
+void CGovernanceManager::LoadObjectsFromDb()
+{
+    LOCK(cs);
+
+    pgovernancedb->ReadObjects(mapObjects);
+
+    for (auto& objpair : mapObjects) {
+        std::vector<CGovernanceVote> vecVotes;
+        pgovernancedb->ReadVotes(objpair.first, vecVotes);
+        for (const auto& vote : vecVotes) {
+            objpair.second.LoadVote(vote);
+        }
+    }
+}
+
 void CGovernanceManager::InitOnLoad()
 {
     LOCK(cs);
     int64_t nStart = GetTimeMillis();
     LogPrintf("Preparing masternode indexes and governance triggers...\n");
+    LoadObjectsFromDb();
     RebuildIndexes();
     AddCachedTriggers();
     LogPrintf("Masternode indexes and governance triggers prepared  %dms\n", GetTimeMillis() - nStart);
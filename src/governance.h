@@ -264,6 +264,9 @@ private:
     // used to check for changed voting keys
     CDeterministicMNList lastMNListForVotingKeys;
 
+    // true once a complete cache of the current version was read from governance.dat
+    bool fCacheLoaded;
+
     class ScopedLockBool
     {
         bool& ref;
@@ -329,6 +332,7 @@ public:
         cmapInvalidVotes.Clear();
         cmmapOrphanVotes.Clear();
         mapLastMasternodeObject.clear();
+        fCacheLoaded = false;
     }
 
     std::string ToString() const;
@@ -355,11 +359,16 @@ public:
         READWRITE(mapErasedGovernanceObjects);
         READWRITE(cmapInvalidVotes);
         READWRITE(cmmapOrphanVotes);
-        READWRITE(mapObjects);
         READWRITE(mapLastMasternodeObject);
         READWRITE(lastMNListForVotingKeys);
+        if (ser_action.ForRead()) {
+            fCacheLoaded = true;
+        }
     }
 
+    /// pgovernancedb can only be used together with the cache it was written with
+    bool IsCacheLoaded() const { LOCK(cs); return fCacheLoaded; }
+
     void UpdatedBlockTip(const CBlockIndex* pindex, CConnman& connman);
     int64_t GetLastDiffTime() const { return nTimeLastDiff; }
     void UpdateLastDiffTime(int64_t nTimeIn) { nTimeLastDiff = nTimeIn; }
@@ -444,6 +453,13 @@ private:
 
     void CheckOrphanVotes(CGovernanceObject& govobj, CGovernanceException& exception, CConnman& connman);
 
+    /**
+     * Read the objects and their votes from pgovernancedb.
+     * All stored votes are read to rebuild the vote counts, so this still takes time in
+     * proportion to the vote history and one index entry per vote stays in memory.
+     */
+    void LoadObjectsFromDb();
+
     void RebuildIndexes();
 
     void AddCachedTriggers();
@@ -7,6 +7,154 @@
 #include "crypto/hmac_sha512.h"
 #include "pubkey.h"
 
+#if defined(HAVE_CONFIG_H)
+#include "config/alterdot-config.h"
+#endif
+
+#ifdef WIN32
+#ifdef _WIN32_WINNT
+#undef _WIN32_WINNT
+#endif
+#define _WIN32_WINNT 0x0501
+#define WIN32_LEAN_AND_MEAN 1
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <sys/mman.h> // for mmap
+#include <unistd.h> // for sysconf
+#endif
+
+#include <map>
+#include <mutex>
+
+// Some systems (at least OS X) do not define MAP_ANONYMOUS yet and define
+// MAP_ANON which is deprecated
+#if !defined(WIN32) && !defined(MAP_ANONYMOUS)
+#define MAP_ANONYMOUS MAP_ANON
+#endif
+
+namespace {
+
+/**
+ * Pool of Argon2d memory arenas.
+ *
+ * Every block hash needs a full Argon2d memory matrix (16 MB since the algorithm
+ * change). Arenas are mapped once, hinted for transparent huge pages where the OS
+ * supports it, pre-faulted and then recycled between hashes. A thread takes an
+ * arena for the duration of one hash, so the pool never holds more arenas per
+ * size than there were threads hashing at the same time.
+ */
+class CArgon2dArenaPool
+{
+private:
+    //! Maximum number of idle arenas kept around per size
+    static const size_t MAX_IDLE_ARENAS = 32;
+
+    std::mutex cs;
+    std::map<size_t, std::vector<uint8_t*> > mapIdle;
+    size_t nPageSize;
+
+    size_t AlignUp(size_t nBytes) const
+    {
+        return (nBytes + nPageSize - 1) & ~(nPageSize - 1);
+    }
+
+    uint8_t* Map(size_t nLen)
+    {
+#ifdef WIN32
+        void* addr = VirtualAlloc(nullptr, nLen, MEM_COMMIT | MEM_RESERVE, PAGE_READWRITE);
+#else
+        void* addr = mmap(nullptr, nLen, PROT_READ|PROT_WRITE, MAP_PRIVATE|MAP_ANONYMOUS, -1, 0);
+        if (addr == MAP_FAILED)
+            return nullptr;
+#ifdef MADV_HUGEPAGE
+        madvise(addr, nLen, MADV_HUGEPAGE);
+#endif
+#endif
+        if (addr) {
+            // pre-fault, the first hash shouldn't pay for thousands of page faults
+            memset(addr, 0, nLen);
+        }
+        return (uint8_t*)addr;
+    }
+
+    void Unmap(uint8_t* p, size_t nLen)
+    {
+#ifdef WIN32
+        VirtualFree(p, 0, MEM_RELEASE);
+#else
+        munmap(p, nLen);
+#endif
+    }
+
+public:
+    CArgon2dArenaPool()
+    {
+#ifdef WIN32
+        SYSTEM_INFO sSysInfo;
+        GetSystemInfo(&sSysInfo);
+        nPageSize = sSysInfo.dwPageSize;
+#else
+        nPageSize = sysconf(_SC_PAGESIZE);
+#endif
+    }
+
+    ~CArgon2dArenaPool()
+    {
+        for (auto& p : mapIdle) {
+            for (uint8_t* pArena : p.second) {
+                Unmap(pArena, p.first);
+            }
+        }
+    }
+
+    uint8_t* Acquire(size_t nBytes)
+    {
+        size_t nLen = AlignUp(nBytes);
+        {
+            std::lock_guard<std::mutex> lock(cs);
+            auto it = mapIdle.find(nLen);
+            if (it != mapIdle.end() && !it->second.empty()) {
+                uint8_t* pArena = it->second.back();
+                it->second.pop_back();
+                return pArena;
+            }
+        }
+        return Map(nLen);
+    }
+
+    void Release(uint8_t* pArena, size_t nBytes)
+    {
+        size_t nLen = AlignUp(nBytes);
+        {
+            std::lock_guard<std::mutex> lock(cs);
+            std::vector<uint8_t*>& vIdle = mapIdle[nLen];
+            if (vIdle.size() < MAX_IDLE_ARENAS) {
+                vIdle.push_back(pArena);
+                return;
+            }
+        }
+        Unmap(pArena, nLen);
+    }
+};
+
+CArgon2dArenaPool argon2dArenaPool;
+
+} // namespace
+
+int Argon2dArenaAllocate(uint8_t **memory, size_t bytes_to_allocate)
+{
+    *memory = argon2dArenaPool.Acquire(bytes_to_allocate);
+    return *memory ? ARGON2_OK : ARGON2_MEMORY_ALLOCATION_ERROR;
+}
+
+void Argon2dArenaFree(uint8_t *memory, size_t bytes_to_allocate)
+{
+    argon2dArenaPool.Release(memory, bytes_to_allocate);
+}
+
 
 inline uint32_t ROTL32(uint32_t x, int8_t r)
 {
@@ -306,6 +306,11 @@ public:
 uint64_t SipHashUint256(uint64_t k0, uint64_t k1, const uint256& val);
 uint64_t SipHashUint256Extra(uint64_t k0, uint64_t k1, const uint256& val, uint32_t extra);
 
+/** Argon2d allocator callbacks backed by a pool of reusable, pre-faulted memory
+ *  arenas, so block hashing doesn't map, fault in and free 16 MB for every hash. */
+int Argon2dArenaAllocate(uint8_t **memory, size_t bytes_to_allocate);
+void Argon2dArenaFree(uint8_t *memory, size_t bytes_to_allocate);
+
     /* ----------- Alterdot Hash ------------------------------------------------ */
     /// Argon2i, Argon2d, and Argon2id are parametrized by:
     /// A time cost, which defines the amount of computation realized and therefore the execution time, given in number of iterations
@@ -339,9 +344,9 @@ inline int Argon2d_Phase1_Hash(const void *in,const size_t size, const void *out
     context.secretlen = 0;
     context.ad = NULL;
     context.adlen = 0;
-    context.allocate_cbk = NULL;
-    context.free_cbk = NULL;
-    context.flags = DEFAULT_ARGON2_FLAG; // = ARGON2_DEFAULT_FLAGS
+    context.allocate_cbk = Argon2dArenaAllocate;
+    context.free_cbk = Argon2dArenaFree;
+    context.flags = DEFAULT_ARGON2_FLAG | ARGON2_FLAG_NO_WIPE_MEMORY; // nothing secret to wipe in a block header
     // main configurable Argon2 hash parameters
     context.m_cost = 250; // Memory in KiB (~256KB)
     context.lanes = 4;    // Degree of Parallelism
@@ -378,9 +383,9 @@ inline int Argon2d_Phase2_Hash(const void *in, const size_t size, const void *ou
     context.secretlen = 0;
     context.ad = NULL;
     context.adlen = 0;
-    context.allocate_cbk = NULL;
-    context.free_cbk = NULL;
-    context.flags = DEFAULT_ARGON2_FLAG; // = ARGON2_DEFAULT_FLAGS
+    context.allocate_cbk = Argon2dArenaAllocate;
+    context.free_cbk = Argon2dArenaFree;
+    context.flags = DEFAULT_ARGON2_FLAG | ARGON2_FLAG_NO_WIPE_MEMORY; // nothing secret to wipe in a block header
     // main configurable Argon2 hash parameters
     context.m_cost = 16000; // Memory in KiB (~16384KB)
     context.lanes = 1;    // Degree of Parallelism
@@ -216,6 +216,17 @@ void Interrupt(boost::thread_group& threadGroup)
     threadGroup.interrupt_all();
 }
 
+/** Write the cache files while the node keeps running so that an unclean stop loses less state */
+static void DumpCacheFilesSnapshot()
+{
+    CFlatDB<CMasternodeMetaMan>("mncache.dat", "magicMasternodeCache").DumpSnapshot(mmetaman);
+    CFlatDB<CGovernanceManager>("governance.dat", "magicGovernanceCache").DumpSnapshot(governance);
+    CFlatDB<CNetFulfilledRequestManager>("netfulfilled.dat", "magicFulfilledCache").DumpSnapshot(netfulfilledman);
+    if (fEnableInstantSend)
+        CFlatDB<CInstantSend>("instantsend.dat", "magicInstantSendCache").DumpSnapshot(instantsend);
+    CFlatDB<CSporkManager>("sporks.dat", "magicSporkCache").DumpSnapshot(sporkManager);
+}
+
 /** Preparing steps before shutting down or restarting the wallet */
 void PrepareShutdown()
 {
@@ -237,6 +248,9 @@ void PrepareShutdown()
     StopHTTPServer();
     llmq::StopLLMQSystem();
 
+    // The scheduler thread is gone already, deliver the queued notifications here
+    GetMainSignals().FlushBackgroundCallbacks();
+
     // fRPCInWarmup should be `false` if we completed the loading sequence
     // before a shutdown request was received
     std::string statusmessage;
@@ -315,6 +329,8 @@ void PrepareShutdown()
         deterministicMNManager = NULL;
         delete evoDb;
         evoDb = NULL;
+        delete pgovernancedb;
+        pgovernancedb = NULL;
     }
 #ifdef ENABLE_WALLET
     if (pwalletMain)
@@ -349,6 +365,7 @@ void PrepareShutdown()
         LogPrintf("%s: Unable to remove pidfile: %s\n", __func__, e.what());
     }
 #endif
+    GetMainSignals().UnregisterBackgroundSignalScheduler();
     UnregisterAllValidationInterfaces();
 }
 
@@ -590,6 +607,7 @@ std::string HelpMessage(HelpMessageMode mode)
     strUsage += HelpMessageOpt("-litemode", strprintf(_("Disable all Alterdot specific functionality (Masternodes, PrivateSend, InstantSend, Governance) (0-1, default: %u)"), 0));
     strUsage += HelpMessageOpt("-sporkaddr=<alterdotaddress>", strprintf(_("Override spork address. Only useful for regtest and devnet. Using this on mainnet or testnet will ban you.")));
     strUsage += HelpMessageOpt("-minsporkkeys=<n>", strprintf(_("Overrides minimum spork signers to change spork value. Only useful for regtest and devnet. Using this on mainnet or testnet will ban you.")));
+    strUsage += HelpMessageOpt("-cachedumpinterval=<n>", strprintf(_("Write the masternode, governance, InstantSend and spork caches to disk every <n> minutes while running (0 to disable, default: %u)"), DEFAULT_FLATDB_DUMP_INTERVAL));
 
     strUsage += HelpMessageGroup(_("Masternode options:"));
     strUsage += HelpMessageOpt("-masternode", strprintf(_("Enable the client to act as a masternode (0-1, default: %u)"), 0));
@@ -1505,6 +1523,8 @@ bool AppInitMain(boost::thread_group& threadGroup, CScheduler& scheduler)
     if (nScriptCheckThreads) {
         for (int i=0; i<nScriptCheckThreads-1; i++)
             threadGroup.create_thread(&ThreadScriptCheck);
+        for (int i=0; i<nScriptCheckThreads-1; i++)
+            threadGroup.create_thread(&ThreadHeaderCheck);
     }
 
     std::vector<std::string> vSporkAddresses;
@@ -1535,6 +1555,8 @@ bool AppInitMain(boost::thread_group& threadGroup, CScheduler& scheduler)
     CScheduler::Function serviceLoop = boost::bind(&CScheduler::serviceQueue, &scheduler);
     threadGroup.create_thread(boost::bind(&TraceThread<CScheduler::Function>, "scheduler", serviceLoop));
 
+    GetMainSignals().RegisterBackgroundSignalScheduler(scheduler);
+
     /* Start the RPC server already.  It will be started in "warmup" mode
      * and not really process calls already (but it will signify connections
      * that the server is there and will be ready later).  Warmup mode will
@@ -1718,7 +1740,7 @@ bool AppInitMain(boost::thread_group& threadGroup, CScheduler& scheduler)
     pzmqNotificationInterface = CZMQNotificationInterface::Create();
 
     if (pzmqNotificationInterface) {
-        RegisterValidationInterface(pzmqNotificationInterface);
+        RegisterValidationInterface(pzmqNotificationInterface, true);
     }
 #endif
 
@@ -1754,6 +1776,7 @@ bool AppInitMain(boost::thread_group& threadGroup, CScheduler& scheduler)
     nCoinCacheUsage = nTotalCache; // the rest goes to in-memory cache
     int64_t nMempoolSizeMax = GetArg("-maxmempool", DEFAULT_MAX_MEMPOOL_SIZE) * 1000000;
     int64_t nEvoDbCache = 1024 * 1024 * 16; // TODO
+    int64_t nGovernanceDbCache = 1024 * 1024 * 8;
     LogPrintf("Cache configuration:\n");
     LogPrintf("* Using %.1fMiB for block index database\n", nBlockTreeDBCache * (1.0 / 1024 / 1024));
     LogPrintf("* Using %.1fMiB for chain state database\n", nCoinDBCache * (1.0 / 1024 / 1024));
@@ -2025,6 +2048,9 @@ bool AppInitMain(boost::thread_group& threadGroup, CScheduler& scheduler)
     // LOAD SERIALIZED DAT FILES INTO DATA CACHES FOR INTERNAL USE
 
     bool fIgnoreCacheFiles = fLiteMode || fReindex || fReindexChainState;
+    // governance objects and votes are kept in their own database which is only valid together with governance.dat,
+    // it is wiped below if the latter could not be loaded
+    pgovernancedb = new CGovernanceDB(nGovernanceDbCache, false, fIgnoreCacheFiles);
     if (!fIgnoreCacheFiles) {
         boost::filesystem::path pathDB = GetDataDir();
         std::string strDBName;
@@ -2042,6 +2068,12 @@ bool AppInitMain(boost::thread_group& threadGroup, CScheduler& scheduler)
         if(!flatdb3.Load(governance)) {
             return InitError(_("Failed to load governance cache from") + "\n" + (pathDB / strDBName).string());
         }
+        // Load() recreates a missing or outdated file, the objects and votes stored for it are of no use then
+        if (!governance.IsCacheLoaded()) {
+            LogPrintf("%s was not loaded, wiping governance database\n", strDBName);
+            delete pgovernancedb;
+            pgovernancedb = new CGovernanceDB(nGovernanceDbCache, false, true);
+        }
         governance.InitOnLoad();
 
         strDBName = "netfulfilled.dat";
@@ -2073,6 +2105,10 @@ bool AppInitMain(boost::thread_group& threadGroup, CScheduler& scheduler)
 
         scheduler.scheduleEvery(boost::bind(&CInstantSend::DoMaintenance, boost::ref(instantsend)), 60 * 1000);
 
+        int64_t nCacheDumpInterval = GetArg("-cachedumpinterval", DEFAULT_FLATDB_DUMP_INTERVAL);
+        if (nCacheDumpInterval > 0)
+            scheduler.scheduleEvery(&DumpCacheFilesSnapshot, nCacheDumpInterval * 60 * 1000);
+
         if (fMasternodeMode)
             scheduler.scheduleEvery(boost::bind(&CPrivateSendServer::DoMaintenance, boost::ref(privateSendServer), boost::ref(*g_connman)), 1 * 1000);
 #ifdef ENABLE_WALLET
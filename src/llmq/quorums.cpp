@@ -26,6 +26,7 @@ namespace llmq
 
 static const std::string DB_QUORUM_SK_SHARE = "q_Qsk";
 static const std::string DB_QUORUM_QUORUM_VVEC = "q_Qqvvec";
+static const std::string DB_QUORUM_PUBKEY_SHARES = "q_Qpkshares";
 
 CQuorumManager* quorumManager;
 
@@ -40,6 +41,17 @@ static uint256 MakeQuorumKey(const CQuorum& q)
     return hw.GetHash();
 }
 
+// Integrity tag for persisted public key shares. It binds the shares to the quorum and to the verification vector
+// they were recovered from, so that stale or damaged entries are detected and the shares get recovered again
+static uint256 MakePubKeySharesTag(const uint256& dbKey, const BLSVerificationVector& quorumVvec, const std::vector<CBLSLazyPublicKey>& pubKeyShares)
+{
+    CHashWriter hw(SER_NETWORK, 0);
+    hw << dbKey;
+    hw << quorumVvec;
+    hw << pubKeyShares;
+    return hw.GetHash();
+}
+
 CQuorum::~CQuorum()
 {
     // most likely the thread is already done
@@ -84,6 +96,12 @@ CBLSPublicKey CQuorum::GetPubKeyShare(size_t memberIdx) const
     if (quorumVvec == nullptr || memberIdx >= members.size() || !qc.validMembers[memberIdx]) {
         return CBLSPublicKey();
     }
+    if (!persistedPubKeyShares.empty()) {
+        const CBLSPublicKey& pubKeyShare = persistedPubKeyShares[memberIdx].Get();
+        if (pubKeyShare.IsValid()) {
+            return pubKeyShare;
+        }
+    }
     auto& m = members[memberIdx];
     return blsCache.BuildPubKeyShare(m->proTxHash, quorumVvec, CBLSId::FromHash(m->proTxHash));
 }
@@ -133,7 +151,43 @@ bool CQuorum::ReadContributions(CEvoDB& evoDb)
     return true;
 }
 
-void CQuorum::StartCachePopulatorThread(std::shared_ptr<CQuorum> _this)
+void CQuorum::WritePubKeyShares(CEvoDB& evoDb) const
+{
+    uint256 dbKey = MakeQuorumKey(*this);
+
+    std::vector<CBLSLazyPublicKey> pubKeyShares(members.size());
+    for (size_t i = 0; i < members.size(); i++) {
+        if (qc.validMembers[i]) {
+            pubKeyShares[i].Set(GetPubKeyShare(i));
+        }
+    }
+
+    uint256 tag = MakePubKeySharesTag(dbKey, *quorumVvec, pubKeyShares);
+    evoDb.GetRawDB().Write(std::make_pair(DB_QUORUM_PUBKEY_SHARES, dbKey), std::make_pair(tag, pubKeyShares));
+}
+
+bool CQuorum::ReadPubKeyShares(CEvoDB& evoDb)
+{
+    if (quorumVvec == nullptr) {
+        return false;
+    }
+
+    uint256 dbKey = MakeQuorumKey(*this);
+
+    std::pair<uint256, std::vector<CBLSLazyPublicKey>> record;
+    if (!evoDb.GetRawDB().Read(std::make_pair(DB_QUORUM_PUBKEY_SHARES, dbKey), record)) {
+        return false;
+    }
+    if (record.second.size() != members.size() || record.first != MakePubKeySharesTag(dbKey, *quorumVvec, record.second)) {
+        LogPrintf("CQuorum::%s -- ignoring invalid public key shares for quorum %s\n", __func__, qc.quorumHash.ToString());
+        return false;
+    }
+
+    persistedPubKeyShares = std::move(record.second);
+    return true;
+}
+
+void CQuorum::StartCachePopulatorThread(std::shared_ptr<CQuorum> _this, CEvoDB& evoDb)
 {
     if (_this->quorumVvec == nullptr) {
         return;
@@ -144,13 +198,18 @@ void CQuorum::StartCachePopulatorThread(std::shared_ptr<CQuorum> _this)
 
     // this thread will exit after some time
     // when then later some other thread tries to get keys, it will be much faster
-    _this->cachePopulatorThread = std::thread([_this, t]() {
+    _this->cachePopulatorThread = std::thread([_this, t, &evoDb]() {
         RenameThread("alterdot-q-cachepop");
-        for (size_t i = 0; i < _this->members.size() && !_this->stopCachePopulatorThread && !ShutdownRequested(); i++) {
+        size_t i = 0;
+        for (; i < _this->members.size() && !_this->stopCachePopulatorThread && !ShutdownRequested(); i++) {
             if (_this->qc.validMembers[i]) {
                 _this->GetPubKeyShare(i);
             }
         }
+        // persist the shares so that the next start doesn't have to recover them again
+        if (i == _this->members.size() && !_this->stopCachePopulatorThread && !ShutdownRequested()) {
+            _this->WritePubKeyShares(evoDb);
+        }
         LogPrint("llmq", "CQuorum::StartCachePopulatorThread -- done. time=%d\n", t.count());
     });
 }
@@ -250,10 +309,14 @@ bool CQuorumManager::BuildQuorumFromCommitment(const CFinalCommitment& qc, const
     }
 
     if (hasValidVvec) {
-        // pre-populate caches in the background
-        // recovering public key shares is quite expensive and would result in serious lags for the first few signing
-        // sessions if the shares would be calculated on-demand
-        CQuorum::StartCachePopulatorThread(quorum);
+        if (quorum->ReadPubKeyShares(evoDb)) {
+            LogPrint("llmq", "CQuorumManager::%s -- loaded public key shares for quorum %s\n", __func__, qc.quorumHash.ToString());
+        } else {
+            // pre-populate caches in the background
+            // recovering public key shares is quite expensive and would result in serious lags for the first few signing
+            // sessions if the shares would be calculated on-demand
+            CQuorum::StartCachePopulatorThread(quorum, evoDb);
+        }
     }
 
     return true;
@@ -182,7 +182,25 @@ void CSigSharesNodeState::RemoveSession(const uint256& signHash)
 
 //////////////////////
 
-CSigSharesManager::CSigSharesManager()
+UniValue CSigSharesVerifyStats::ToJson() const
+{
+    UniValue ret(UniValue::VOBJ);
+    ret.push_back(Pair("rounds", rounds));
+    ret.push_back(Pair("batches", batches));
+    ret.push_back(Pair("sigShares", sigShares));
+    ret.push_back(Pair("lastBatchTime", lastBatchTime));
+    ret.push_back(Pair("maxBatchTime", maxBatchTime));
+    ret.push_back(Pair("avgBatchTime", batches ? totalBatchTime / (int64_t)batches : 0));
+    ret.push_back(Pair("lastRoundTime", lastRoundTime));
+    ret.push_back(Pair("pendingSigShares", (uint64_t)pendingSigShares));
+    ret.push_back(Pair("maxPendingSigShares", (uint64_t)maxPendingSigShares));
+    return ret;
+}
+
+//////////////////////
+
+CSigSharesManager::CSigSharesManager(CBLSWorker& _blsWorker) :
+    blsWorker(_blsWorker)
 {
     workInterrupt.reset();
 }
@@ -511,8 +529,10 @@ bool CSigSharesManager::PreVerifyBatchedSigShares(NodeId nodeId, const CSigShare
 void CSigSharesManager::CollectPendingSigSharesToVerify(
         size_t maxUniqueSessions,
         std::unordered_map<NodeId, std::vector<CSigShare>>& retSigShares,
-        std::unordered_map<std::pair<Consensus::LLMQType, uint256>, CQuorumCPtr, StaticSaltedHasher>& retQuorums)
+        std::unordered_map<std::pair<Consensus::LLMQType, uint256>, CQuorumCPtr, StaticSaltedHasher>& retQuorums,
+        size_t& retPendingCount)
 {
+    retPendingCount = 0;
     {
         LOCK(cs);
         if (nodeStates.empty()) {
@@ -543,6 +563,10 @@ void CSigSharesManager::CollectPendingSigSharesToVerify(
             return !ns.pendingIncomingSigShares.Empty();
         }, rnd);
 
+        for (auto& p : nodeStates) {
+            retPendingCount += p.second.pendingIncomingSigShares.Size();
+        }
+
         if (retSigShares.empty()) {
             return;
         }
@@ -574,15 +598,26 @@ bool CSigSharesManager::ProcessPendingSigShares(CConnman& connman)
 {
     std::unordered_map<NodeId, std::vector<CSigShare>> sigSharesByNodes;
     std::unordered_map<std::pair<Consensus::LLMQType, uint256>, CQuorumCPtr, StaticSaltedHasher> quorums;
+    size_t pendingCount;
 
-    CollectPendingSigSharesToVerify(32, sigSharesByNodes, quorums);
+    CollectPendingSigSharesToVerify(32, sigSharesByNodes, quorums, pendingCount);
+    {
+        LOCK(cs_verifyStats);
+        verifyStats.pendingSigShares = pendingCount;
+        verifyStats.maxPendingSigShares = std::max(verifyStats.maxPendingSigShares, pendingCount);
+    }
     if (sigSharesByNodes.empty()) {
         return false;
     }
 
+    // Shares are verified in one batch per signing session (which also implies the quorum). All shares of a session
+    // sign the same hash, so each batch stays cheap to verify, and the batches are verified in parallel on the BLS
+    // worker pool. A node sending an invalid share only makes the batches it contributed to fall back to per-share
+    // verification.
     // It's ok to perform insecure batched verification here as we verify against the quorum public key shares,
     // which are not craftable by individual entities, making the rogue public key attack impossible
-    CBLSBatchVerifier<NodeId, SigShareKey> batchVerifier(false, true);
+    typedef CBLSBatchVerifier<NodeId, SigShareKey> SigShareBatchVerifier;
+    std::unordered_map<uint256, std::unique_ptr<SigShareBatchVerifier>, StaticSaltedHasher> batchVerifiers;
 
     size_t verifyCount = 0;
     for (auto& p : sigSharesByNodes) {
@@ -612,22 +647,67 @@ bool CSigSharesManager::ProcessPendingSigShares(CConnman& connman)
                 assert(false);
             }
 
-            batchVerifier.PushMessage(nodeId, sigShare.GetKey(), sigShare.GetSignHash(), sigShare.sigShare.Get(), pubKeyShare);
+            auto& batchVerifier = batchVerifiers[sigShare.GetSignHash()];
+            if (!batchVerifier) {
+                batchVerifier = std::make_unique<SigShareBatchVerifier>(false, true);
+            }
+            batchVerifier->PushMessage(nodeId, sigShare.GetKey(), sigShare.GetSignHash(), sigShare.sigShare.Get(), pubKeyShare);
             verifyCount++;
         }
     }
 
     cxxtimer::Timer verifyTimer(true);
-    batchVerifier.Verify();
+    std::vector<int64_t> batchTimes(batchVerifiers.size());
+    std::vector<std::future<void>> futures;
+    futures.reserve(batchVerifiers.size());
+    size_t batchIdx = 0;
+    for (auto& p : batchVerifiers) {
+        SigShareBatchVerifier* batchVerifier = p.second.get();
+        int64_t* batchTime = &batchTimes[batchIdx++];
+        auto job = [batchVerifier, batchTime]() {
+            cxxtimer::Timer batchTimer(true);
+            batchVerifier->Verify();
+            batchTimer.stop();
+            *batchTime = batchTimer.count<std::chrono::microseconds>();
+        };
+        if (batchVerifiers.size() == 1) {
+            // not worth the hand-off to the worker pool
+            job();
+        } else {
+            futures.emplace_back(blsWorker.AsyncRun(job));
+        }
+    }
+    for (auto& f : futures) {
+        f.get();
+    }
     verifyTimer.stop();
 
-    LogPrint("llmq-sigs", "CSigSharesManager::%s -- verified sig shares. count=%d, vt=%d, nodes=%d\n", __func__, verifyCount, verifyTimer.count(), sigSharesByNodes.size());
+    std::set<NodeId> badSources;
+    for (auto& p : batchVerifiers) {
+        badSources.insert(p.second->badSources.begin(), p.second->badSources.end());
+    }
+
+    {
+        LOCK(cs_verifyStats);
+        verifyStats.rounds++;
+        verifyStats.batches += batchVerifiers.size();
+        verifyStats.sigShares += verifyCount;
+        for (int64_t batchTime : batchTimes) {
+            verifyStats.lastBatchTime = batchTime;
+            verifyStats.maxBatchTime = std::max(verifyStats.maxBatchTime, batchTime);
+            verifyStats.totalBatchTime += batchTime;
+        }
+        verifyStats.lastRoundTime = verifyTimer.count<std::chrono::microseconds>();
+    }
+
+    LogPrint("llmq-sigs", "CSigSharesManager::%s -- verified sig shares. count=%d, batches=%d, vt=%d, nodes=%d, pending=%d\n", __func__,
+             verifyCount, batchVerifiers.size(), verifyTimer.count(), sigSharesByNodes.size(), pendingCount);
 
     for (auto& p : sigSharesByNodes) {
         auto nodeId = p.first;
         auto& v = p.second;
 
-        if (batchVerifier.badSources.count(nodeId)) {
+        if (badSources.count(nodeId)) {
             LogPrintf("CSigSharesManager::%s -- invalid sig shares from other node, banning peer=%d\n",
                      __func__, nodeId);
             // this will also cause re-requesting of the shares that were sent by this node
@@ -1371,6 +1451,12 @@ void CSigSharesManager::WorkThreadMain()
     }
 }
 
+CSigSharesVerifyStats CSigSharesManager::GetVerifyStats() const
+{
+    LOCK(cs_verifyStats);
+    return verifyStats;
+}
+
 void CSigSharesManager::AsyncSign(const CQuorumCPtr& quorum, const uint256& id, const uint256& msgHash)
 {
     LOCK(cs);
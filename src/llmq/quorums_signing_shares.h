@@ -14,6 +14,7 @@
 #include "sync.h"
 #include "tinyformat.h"
 #include "uint256.h"
+#include "univalue.h"
 
 #include "llmq/quorums.h"
 
@@ -328,6 +329,25 @@ public:
     void RemoveSession(const uint256& signHash);
 };
 
+// Counters about sig share verification, exposed through "quorum sigsharestats"
+struct CSigSharesVerifyStats
+{
+    uint64_t rounds{0};
+    uint64_t batches{0};
+    uint64_t sigShares{0};
+    // verification time of single batches in microseconds
+    int64_t lastBatchTime{0};
+    int64_t maxBatchTime{0};
+    int64_t totalBatchTime{0};
+    // wall time of a whole verification round in microseconds
+    int64_t lastRoundTime{0};
+    // number of sig shares that were still waiting for verification after the last round
+    size_t pendingSigShares{0};
+    size_t maxPendingSigShares{0};
+
+    UniValue ToJson() const;
+};
+
 class CSigSharesManager : public CRecoveredSigsListener
 {
     static const int64_t SESSION_NEW_SHARES_TIMEOUT = 60;
@@ -343,6 +363,8 @@ class CSigSharesManager : public CRecoveredSigsListener
 private:
     CCriticalSection cs;
 
+    CBLSWorker& blsWorker;
+
     std::thread workThread;
     CThreadInterrupt workInterrupt;
 
@@ -363,8 +385,11 @@ private:
     int64_t lastCleanupTime{0};
     std::atomic<uint32_t> recoveredSigsCounter{0};
 
+    mutable CCriticalSection cs_verifyStats;
+    CSigSharesVerifyStats verifyStats;
+
 public:
-    CSigSharesManager();
+    CSigSharesManager(CBLSWorker& _blsWorker);
     ~CSigSharesManager();
 
     void StartWorkerThread();
@@ -382,6 +407,8 @@ public:
 
     void HandleNewRecoveredSig(const CRecoveredSig& recoveredSig);
 
+    CSigSharesVerifyStats GetVerifyStats() const;
+
 private:
     // all of these return false when the currently processed message should be aborted (as each message actually contains multiple messages)
     bool ProcessMessageSigSesAnn(CNode* pfrom, const CSigSesAnn& ann, CConnman& connman);
@@ -394,7 +421,8 @@ private:
 
     void CollectPendingSigSharesToVerify(size_t maxUniqueSessions,
             std::unordered_map<NodeId, std::vector<CSigShare>>& retSigShares,
-            std::unordered_map<std::pair<Consensus::LLMQType, uint256>, CQuorumCPtr, StaticSaltedHasher>& retQuorums);
+            std::unordered_map<std::pair<Consensus::LLMQType, uint256>, CQuorumCPtr, StaticSaltedHasher>& retQuorums,
+            size_t& retPendingCount);
     bool ProcessPendingSigShares(CConnman& connman);
 
     void ProcessPendingSigSharesFromNode(NodeId nodeId,
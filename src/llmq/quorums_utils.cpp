@@ -7,17 +7,39 @@
 
 #include "chainparams.h"
 #include "random.h"
+#include "saltedhasher.h"
+#include "unordered_lru_cache.h"
 #include "validation.h"
 
 namespace llmq
 {
 
+// the members only depend on the list at the quorum block, so they never change for a quorum hash
+static CCriticalSection cs_quorumMembersCache;
+static unordered_lru_cache<std::pair<Consensus::LLMQType, uint256>, std::vector<CDeterministicMNCPtr>, StaticSaltedHasher, 256> quorumMembersCache;
+
 std::vector<CDeterministicMNCPtr> CLLMQUtils::GetAllQuorumMembers(Consensus::LLMQType llmqType, const CBlockIndex* pindexQuorum)
 {
+    auto cacheKey = std::make_pair(llmqType, pindexQuorum->GetBlockHash());
+    std::vector<CDeterministicMNCPtr> members;
+    {
+        LOCK(cs_quorumMembersCache);
+        if (quorumMembersCache.get(cacheKey, members)) {
+            return members;
+        }
+    }
+
     auto& params = Params().GetConsensus().llmqs.at(llmqType);
     auto allMns = deterministicMNManager->GetListForBlock(pindexQuorum);
     auto modifier = ::SerializeHash(std::make_pair((uint8_t) llmqType, pindexQuorum->GetBlockHash()));
-    return allMns.CalculateQuorum(params.size, modifier);
+    members = allMns.CalculateQuorum(params.size, modifier);
+
+    // an unknown list means the block wasn't processed (yet), don't remember that
+    if (allMns.GetHeight() != -1) {
+        LOCK(cs_quorumMembersCache);
+        quorumMembersCache.insert(cacheKey, members);
+    }
+    return members;
 }
 
 uint256 CLLMQUtils::BuildCommitmentHash(uint8_t llmqType, const uint256& blockHash, const std::vector<bool>& validMembers, const CBLSPublicKey& pubKey, const uint256& vvecHash)
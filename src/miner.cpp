@@ -678,7 +678,7 @@ void static AlterdotMiner(const CChainParams& chainparams)
                 uint256 hash;
                 while (true)
                 {
-                    hash = pblock->GetHash();
+                    hash = pblock->ComputeHash();
 
                     if (UintToArith256(hash) <= hashTarget)
                     {
@@ -2677,6 +2677,11 @@ bool static ProcessMessage(CNode* pfrom, const std::string& strCommand, CDataStr
             return true;
         }
 
+        // Argon2d hashing dominates header processing, spread it over the header check
+        // threads before taking cs_main. The continuity check below and
+        // ProcessNewBlockHeaders then reuse the memoized hashes.
+        PreHashBlockHeaders(headers, chainparams.GetConsensus());
+
         const CBlockIndex *pindexLast = NULL;
         {
         LOCK(cs_main);
@@ -3052,14 +3057,14 @@ bool static ProcessMessage(CNode* pfrom, const std::string& strCommand, CDataStr
         CGetSimplifiedMNListDiff cmd;
         vRecv >> cmd;
 
-        LOCK(cs_main);
-
+        // takes cs_main only for the parts that need it, diffs are served off the validation lock
         CSimplifiedMNListDiff mnListDiff;
         std::string strError;
         if (BuildSimplifiedMNListDiff(cmd.baseBlockHash, cmd.blockHash, mnListDiff, strError)) {
             connman.PushMessage(pfrom, msgMaker.Make(NetMsgType::MNLISTDIFF, mnListDiff));
         } else {
             LogPrint("net", "getmnlistdiff failed for baseBlockHash=%s, blockHash=%s. error=%s\n", cmd.baseBlockHash.ToString(), cmd.blockHash.ToString(), strError);
+            LOCK(cs_main);
             Misbehaving(pfrom->id, 1);
         }
     }
@@ -11,6 +11,78 @@
 #include "utilstrencodings.h"
 #include "crypto/common.h"
 
+CBlockHeaderHashMemo::CBlockHeaderHashMemo(const CBlockHeaderHashMemo& other) : fValid(false)
+{
+    *this = other;
+}
+
+CBlockHeaderHashMemo& CBlockHeaderHashMemo::operator=(const CBlockHeaderHashMemo& other)
+{
+    if (this == &other)
+        return *this;
+
+    bool fOtherValid;
+    unsigned char vchOtherHeader[HEADER_SIZE];
+    uint256 otherHash;
+    {
+        std::lock_guard<std::mutex> lock(other.cs);
+        fOtherValid = other.fValid;
+        if (fOtherValid) {
+            memcpy(vchOtherHeader, other.vchHeader, HEADER_SIZE);
+            otherHash = other.hash;
+        }
+    }
+
+    std::lock_guard<std::mutex> lock(cs);
+    fValid = fOtherValid;
+    if (fValid) {
+        memcpy(vchHeader, vchOtherHeader, HEADER_SIZE);
+        hash = otherHash;
+    }
+    return *this;
+}
+
+bool CBlockHeaderHashMemo::Get(const char* pbegin, const char* pend, uint256& hashRet) const
+{
+    if (pend - pbegin != (ptrdiff_t)HEADER_SIZE)
+        return false;
+
+    std::lock_guard<std::mutex> lock(cs);
+    if (!fValid || memcmp(vchHeader, pbegin, HEADER_SIZE) != 0)
+        return false;
+    hashRet = hash;
+    return true;
+}
+
+void CBlockHeaderHashMemo::Set(const char* pbegin, const char* pend, const uint256& hashIn) const
+{
+    if (pend - pbegin != (ptrdiff_t)HEADER_SIZE)
+        return;
+
+    std::lock_guard<std::mutex> lock(cs);
+    memcpy(vchHeader, pbegin, HEADER_SIZE);
+    hash = hashIn;
+    fValid = true;
+}
+
+void CBlockHeaderHashMemo::Clear()
+{
+    std::lock_guard<std::mutex> lock(cs);
+    fValid = false;
+}
+
+uint256 CBlockHeader::GetHash() const
+{
+    uint256 hash;
+    if (hashMemo.Get(BEGIN(nVersion), END(nNonce), hash))
+        return hash;
+
+    // hash outside of the memo lock, a concurrent caller at worst does the same work
+    hash = ComputeHash();
+    hashMemo.Set(BEGIN(nVersion), END(nNonce), hash);
+    return hash;
+}
+
 std::string CBlock::ToString() const
 {
     std::stringstream s;
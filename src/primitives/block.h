@@ -12,8 +12,37 @@
 #include "uint256.h"
 #include "utilstrencodings.h"
 
+#include <mutex>
+
 const uint32_t nTimeOfAlgorithmChange = 1612029600;
 
+/** Memory-only memo of a block header's proof-of-work hash.
+ * Argon2d is far too expensive to run again for every GetHash() call, so the
+ * result is kept together with the header bytes it was computed from. A header
+ * that was mutated afterwards no longer matches and simply gets hashed again.
+ * Blocks are shared between threads, hence the lock.
+ */
+class CBlockHeaderHashMemo
+{
+public:
+    static const size_t HEADER_SIZE = 80;
+
+private:
+    mutable std::mutex cs;
+    mutable bool fValid;
+    mutable unsigned char vchHeader[HEADER_SIZE];
+    mutable uint256 hash;
+
+public:
+    CBlockHeaderHashMemo() : fValid(false) {}
+    CBlockHeaderHashMemo(const CBlockHeaderHashMemo& other);
+    CBlockHeaderHashMemo& operator=(const CBlockHeaderHashMemo& other);
+
+    bool Get(const char* pbegin, const char* pend, uint256& hashRet) const;
+    void Set(const char* pbegin, const char* pend, const uint256& hashIn) const;
+    void Clear();
+};
+
 /** Nodes collect new transactions into a block, hash them into a hash tree,
  * and scan through nonce values to make the block's hash satisfy proof-of-work
  * requirements.  When they solve the proof-of-work, they broadcast the block
@@ -32,6 +61,9 @@ public:
     uint32_t nBits;
     uint32_t nNonce;
 
+    // memory only
+    CBlockHeaderHashMemo hashMemo;
+
     CBlockHeader()
     {
         SetNull();
@@ -57,6 +89,7 @@ public:
         nTime = 0;
         nBits = 0;
         nNonce = 0;
+        hashMemo.Clear();
     }
 
     bool IsNull() const
@@ -64,7 +97,9 @@ public:
         return (nBits == 0);
     }
 
-    uint256 GetHash() const
+    /** Runs Argon2d over the header, bypassing the memo. Meant for the miner,
+     * which changes nNonce between every call. */
+    uint256 ComputeHash() const
     {
         if (nTime > nTimeOfAlgorithmChange)
             return hash_Argon2d(BEGIN(nVersion), END(nNonce), 2);
@@ -72,6 +107,15 @@ public:
             return hash_Argon2d(BEGIN(nVersion), END(nNonce), 1);
     }
 
+    uint256 GetHash() const;
+
+    /** Memoize a hash already known to belong to this exact header, e.g. the hash of a
+     * block index entry whose header fields were compared against this one. */
+    void MemoizeHash(const uint256& hash) const
+    {
+        hashMemo.Set(BEGIN(nVersion), END(nNonce), hash);
+    }
+
     int64_t GetBlockTime() const
     {
         return (int64_t)nTime;
@@ -116,14 +160,8 @@ public:
 
     CBlockHeader GetBlockHeader() const
     {
-        CBlockHeader block;
-        block.nVersion       = nVersion;
-        block.hashPrevBlock  = hashPrevBlock;
-        block.hashMerkleRoot = hashMerkleRoot;
-        block.nTime          = nTime;
-        block.nBits          = nBits;
-        block.nNonce         = nNonce;
-        return block;
+        // slicing copy on purpose, it carries the hash memo along
+        return *this;
     }
 
     std::string ToString() const;
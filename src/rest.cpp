@@ -3,6 +3,7 @@
 // Distributed under the MIT software license, see the accompanying
 // file COPYING or http://www.opensource.org/licenses/mit-license.php.
 
+#include "bdnsdb.h"
 #include "chain.h"
 #include "chainparams.h"
 #include "primitives/block.h"
@@ -64,6 +65,7 @@ extern UniValue mempoolInfoToJSON();
 extern UniValue mempoolToJSON(bool fVerbose = false);
 extern void ScriptPubKeyToJSON(const CScript& scriptPubKey, UniValue& out, bool fIncludeHex);
 extern UniValue blockheaderToJSON(const CBlockIndex* blockindex);
+extern UniValue listdomains(const JSONRPCRequest& request);
 
 static bool RESTERR(HTTPRequest* req, enum HTTPStatusCode status, std::string message)
 {
@@ -404,6 +406,62 @@ static bool rest_tx(HTTPRequest* req, const std::string& strURIPart)
     return true; // continue to process further HTTP reqs on this cxn
 }
 
+static bool rest_bdns_names(HTTPRequest* req, const std::string& strURIPart)
+{
+    if (!CheckWarmup(req))
+        return false;
+    std::string param;
+    const RetFormat rf = ParseDataFormat(param, strURIPart);
+    std::vector<std::string> path;
+    boost::split(path, param, boost::is_any_of("/"));
+
+    if (path.empty() || path.size() > 3)
+        return RESTERR(req, HTTP_BAD_REQUEST, "No count specified. Use /rest/bdns/names/<count>[/<hex prefix>[/<cursor>]].json.");
+
+    long count = strtol(path[0].c_str(), NULL, 10);
+    if (count < 1 || count > MAX_BDNS_LIST_COUNT)
+        return RESTERR(req, HTTP_BAD_REQUEST, "Name count out of range: " + path[0]);
+
+    // the prefix is hex encoded as names can contain any character
+    std::string prefix;
+    if (path.size() > 1) {
+        if (!IsHex(path[1]) && !path[1].empty())
+            return RESTERR(req, HTTP_BAD_REQUEST, "Invalid prefix: " + path[1]);
+        std::vector<unsigned char> vch = ParseHex(path[1]);
+        prefix.assign(vch.begin(), vch.end());
+    }
+
+    switch (rf) {
+    case RF_JSON: {
+        JSONRPCRequest jsonRequest;
+        jsonRequest.params = UniValue(UniValue::VARR);
+        jsonRequest.params.push_back(prefix);
+        jsonRequest.params.push_back((int)count);
+        if (path.size() > 2)
+            jsonRequest.params.push_back(path[2]);
+
+        UniValue domains;
+        try {
+            domains = listdomains(jsonRequest);
+        } catch (const UniValue& objError) {
+            bool fBadRequest = find_value(objError, "code").get_int() == RPC_INVALID_PARAMETER;
+            return RESTERR(req, fBadRequest ? HTTP_BAD_REQUEST : HTTP_SERVICE_UNAVAILABLE, find_value(objError, "message").get_str());
+        }
+
+        std::string strJSON = domains.write() + "\n";
+        req->WriteHeader("Content-Type", "application/json");
+        req->WriteReply(HTTP_OK, strJSON);
+        return true;
+    }
+    default: {
+        return RESTERR(req, HTTP_NOT_FOUND, "output format not found (available: json)");
+    }
+    }
+
+    // not reached
+    return true; // continue to process further HTTP reqs on this cxn
+}
+
 static bool rest_getutxos(HTTPRequest* req, const std::string& strURIPart)
 {
     if (!CheckWarmup(req))
@@ -603,6 +661,7 @@ static const struct {
       {"/rest/mempool/contents", rest_mempool_contents},
       {"/rest/headers/", rest_headers},
       {"/rest/getutxos", rest_getutxos},
+      {"/rest/bdns/names/", rest_bdns_names},
 };
 
 bool StartREST()
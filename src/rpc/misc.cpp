@@ -19,6 +19,8 @@
 #include "core_io.h"
 #include "bdnsdb.h"
 
+#include "evo/deterministicmns.h"
+
 #ifdef ENABLE_WALLET
 #include "wallet/rpcwallet.h"
 #include "wallet/wallet.h"
@@ -640,6 +642,8 @@ UniValue setmocktime(const JSONRPCRequest& request)
     return NullUniValue;
 }
 
+static const int MAX_ADDRESS_DELTAS_PAGE = 10000;
+
 bool getAddressFromIndex(const int &type, const uint160 &hash, std::string &address)
 {
     if (type == 2) {
@@ -851,6 +855,8 @@ UniValue getaddressdeltas(const JSONRPCRequest& request)
             "    ]\n"
             "  \"start\" (number) The start block height\n"
             "  \"end\" (number) The end block height\n"
+            "  \"count\" (number, optional) Return at most this many deltas (1-" + std::to_string(MAX_ADDRESS_DELTAS_PAGE) + ") and a cursor for the next page\n"
+            "  \"cursor\" (string, optional) The cursor returned with the previous page\n"
             "}\n"
             "\nResult:\n"
             "[\n"
@@ -863,8 +869,14 @@ UniValue getaddressdeltas(const JSONRPCRequest& request)
             "    \"address\"  (string) The base58check encoded address\n"
             "  }\n"
             "]\n"
+            "\nResult (when count is given):\n"
+            "{\n"
+            "  \"deltas\": [...]  (array) The deltas as above\n"
+            "  \"cursor\": \"xxxx\"  (string) Pass this to get the next page, only present if there are more deltas\n"
+            "}\n"
             "\nExamples:\n"
             + HelpExampleCli("getaddressdeltas", "'{\"addresses\": [\"XwnLY9Tf7Zsef8gMGL2fhWA9ZmMjt4KPwg\"]}'")
+            + HelpExampleCli("getaddressdeltas", "'{\"addresses\": [\"XwnLY9Tf7Zsef8gMGL2fhWA9ZmMjt4KPwg\"], \"count\": 100}'")
             + HelpExampleRpc("getaddressdeltas", "{\"addresses\": [\"XwnLY9Tf7Zsef8gMGL2fhWA9ZmMjt4KPwg\"]}")
         );
 
@@ -889,18 +901,73 @@ UniValue getaddressdeltas(const JSONRPCRequest& request)
         throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "Invalid address");
     }
 
+    size_t nCount = 0;
+    UniValue countValue = find_value(request.params[0].get_obj(), "count");
+    if (!countValue.isNull()) {
+        int64_t n = countValue.get_int64();
+        if (n < 1 || n > MAX_ADDRESS_DELTAS_PAGE) {
+            throw JSONRPCError(RPC_INVALID_PARAMETER, strprintf("count must be between 1 and %d", MAX_ADDRESS_DELTAS_PAGE));
+        }
+        nCount = (size_t)n;
+    }
+
+    // the cursor is the key of the last delta returned, the next page continues right after it
+    CAddressIndexKey cursorKey;
+    bool fCursor = false;
+    UniValue cursorValue = find_value(request.params[0].get_obj(), "cursor");
+    if (!cursorValue.isNull()) {
+        std::vector<unsigned char> cursorData = ParseHexV(cursorValue, "cursor");
+        try {
+            CDataStream ssCursor(cursorData, SER_DISK, CLIENT_VERSION);
+            ssCursor >> cursorKey;
+        } catch (const std::exception&) {
+            throw JSONRPCError(RPC_INVALID_PARAMETER, "Invalid cursor");
+        }
+        fCursor = true;
+    }
+
     std::vector<std::pair<CAddressIndexKey, CAmount> > addressIndex;
 
+    // one more than asked for tells whether there is another page
+    size_t nRemaining = nCount != 0 ? nCount + 1 : 0;
+    bool fStarted = !fCursor;
     for (std::vector<std::pair<uint160, int> >::iterator it = addresses.begin(); it != addresses.end(); it++) {
+        const CAddressIndexKey* pStartAfter = nullptr;
+        if (!fStarted) {
+            // skip the addresses already returned with previous pages
+            if (cursorKey.hashBytes != (*it).first || cursorKey.type != (unsigned int)(*it).second) {
+                continue;
+            }
+            pStartAfter = &cursorKey;
+            fStarted = true;
+        }
+
+        size_t nPrevSize = addressIndex.size();
         if (start > 0 && end > 0) {
-            if (!GetAddressIndex((*it).first, (*it).second, addressIndex, start, end)) {
+            if (!GetAddressIndex((*it).first, (*it).second, addressIndex, start, end, pStartAfter, nRemaining)) {
                 throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "No information available for address");
             }
         } else {
-            if (!GetAddressIndex((*it).first, (*it).second, addressIndex)) {
+            if (!GetAddressIndex((*it).first, (*it).second, addressIndex, 0, 0, pStartAfter, nRemaining)) {
                 throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "No information available for address");
             }
         }
+
+        if (nCount != 0) {
+            nRemaining -= addressIndex.size() - nPrevSize;
+            if (nRemaining == 0) {
+                break;
+            }
+        }
+    }
+
+    if (!fStarted) {
+        throw JSONRPCError(RPC_INVALID_PARAMETER, "Cursor does not belong to any of the addresses");
+    }
+
+    bool fMore = nCount != 0 && addressIndex.size() > nCount;
+    if (fMore) {
+        addressIndex.resize(nCount);
     }
 
     UniValue result(UniValue::VARR);
@@ -921,7 +988,18 @@ UniValue getaddressdeltas(const JSONRPCRequest& request)
         result.push_back(delta);
     }
 
-    return result;
+    if (nCount == 0) {
+        return result;
+    }
+
+    UniValue page(UniValue::VOBJ);
+    page.push_back(Pair("deltas", result));
+    if (fMore) {
+        CDataStream ssCursor(SER_DISK, CLIENT_VERSION);
+        ssCursor << addressIndex.back().first;
+        page.push_back(Pair("cursor", HexStr(ssCursor.begin(), ssCursor.end())));
+    }
+    return page;
 }
 
 UniValue getaddressbalance(const JSONRPCRequest& request)
@@ -942,6 +1020,7 @@ UniValue getaddressbalance(const JSONRPCRequest& request)
             "{\n"
             "  \"balance\"  (string) The current balance in dots\n"
             "  \"received\"  (string) The total number of dots received (including change)\n"
+            "  \"txcount\"  (numeric) The number of transactions involving the address, summed up per address\n"
             "}\n"
             "\nExamples:\n"
             + HelpExampleCli("getaddressbalance", "'{\"addresses\": [\"XwnLY9Tf7Zsef8gMGL2fhWA9ZmMjt4KPwg\"]}'")
@@ -954,27 +1033,24 @@ UniValue getaddressbalance(const JSONRPCRequest& request)
         throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "Invalid address");
     }
 
-    std::vector<std::pair<CAddressIndexKey, CAmount> > addressIndex;
-
-    for (std::vector<std::pair<uint160, int> >::iterator it = addresses.begin(); it != addresses.end(); it++) {
-        if (!GetAddressIndex((*it).first, (*it).second, addressIndex)) {
-            throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "No information available for address");
-        }
-    }
-
     CAmount balance = 0;
     CAmount received = 0;
+    int64_t txCount = 0;
 
-    for (std::vector<std::pair<CAddressIndexKey, CAmount> >::const_iterator it=addressIndex.begin(); it!=addressIndex.end(); it++) {
-        if (it->second > 0) {
-            received += it->second;
+    for (std::vector<std::pair<uint160, int> >::iterator it = addresses.begin(); it != addresses.end(); it++) {
+        CAddressBalanceValue value;
+        if (!GetAddressBalance((*it).first, (*it).second, value)) {
+            throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "No information available for address");
         }
-        balance += it->second;
+        balance += value.balance;
+        received += value.received;
+        txCount += value.txCount;
     }
 
     UniValue result(UniValue::VOBJ);
     result.push_back(Pair("balance", balance));
     result.push_back(Pair("received", received));
+    result.push_back(Pair("txcount", txCount));
 
     return result;
 
@@ -1123,6 +1199,17 @@ static UniValue RPCLockedMemoryInfo()
     return obj;
 }
 
+static UniValue RPCMNListsCacheInfo()
+{
+    size_t nEntries, nMemoryUsage, nMaxMemoryUsage;
+    deterministicMNManager->GetCacheStats(nEntries, nMemoryUsage, nMaxMemoryUsage);
+    UniValue obj(UniValue::VOBJ);
+    obj.push_back(Pair("entries", (uint64_t)nEntries));
+    obj.push_back(Pair("used", (uint64_t)nMemoryUsage));
+    obj.push_back(Pair("limit", (uint64_t)nMaxMemoryUsage));
+    return obj;
+}
+
 UniValue getmemoryinfo(const JSONRPCRequest& request)
 {
     /* Please, avoid using the word "pool" here in the RPC interface or help,
@@ -1141,6 +1228,11 @@ UniValue getmemoryinfo(const JSONRPCRequest& request)
             "    \"locked\": xxxxxx,       (numeric) Amount of bytes that succeeded locking. If this number is smaller than total, locking pages failed at some point and key data could be swapped to disk.\n"
             "    \"chunks_used\": xxxxx,   (numeric) Number allocated chunks\n"
             "    \"chunks_free\": xxxxx,   (numeric) Number unused chunks\n"
+            "  },\n"
+            "  \"mnlists\": {              (json object) Information about the cache of deterministic masternode lists\n"
+            "    \"entries\": xxxxx,       (numeric) Number of cached lists\n"
+            "    \"used\": xxxxx,          (numeric) Estimated number of bytes used\n"
+            "    \"limit\": xxxxx,         (numeric) Number of bytes the cache is bounded to\n"
             "  }\n"
             "}\n"
             "\nExamples:\n"
@@ -1149,6 +1241,7 @@ UniValue getmemoryinfo(const JSONRPCRequest& request)
         );
     UniValue obj(UniValue::VOBJ);
     obj.push_back(Pair("locked", RPCLockedMemoryInfo()));
+    obj.push_back(Pair("mnlists", RPCMNListsCacheInfo()));
     return obj;
 }
 
@@ -1451,6 +1544,83 @@ UniValue resolvedomain(const JSONRPCRequest& request) {
     return "Blockchain domain name not found!";
 }
 
+UniValue listdomains(const JSONRPCRequest& request) {
+    if (request.fHelp || request.params.size() > 3)
+        throw std::runtime_error(
+            "listdomains ( \"prefix\" count \"cursor\" )\n"
+            "\nLists registered BDNS names in database order, which is by length first and then byte by byte.\n"
+            "\nArguments:\n"
+            "1. \"prefix\" (string, optional, default=\"\") Only list names starting with this prefix.\n"
+            "2. count    (numeric, optional, default=100) The maximum number of names to return, at most " + std::to_string(MAX_BDNS_LIST_COUNT) + ".\n"
+            "3. \"cursor\" (string, optional) The cursor returned by a previous call with the same prefix, listing resumes where that call stopped.\n"
+            "\nResult:\n"
+            "{\n"
+            "  \"domains\": [\n"
+            "    {\n"
+            "      \"name\": \"xxxx\",           (string) The blockchain domain name\n"
+            "      \"content\": \"xxxx\",        (string) The content registered under the name\n"
+            "      \"regtxid\": \"hash\",        (string) The registration transaction\n"
+            "      \"lastupdatetxid\": \"hash\"  (string) The last update transaction, all zeros if never updated\n"
+            "    }, ...\n"
+            "  ],\n"
+            "  \"cursor\": \"hex\"              (string, optional) Pass this to the next call to continue the listing, missing if all names were listed\n"
+            "}\n"
+            "\nExamples:\n"
+            + HelpExampleCli("listdomains", "")
+            + HelpExampleCli("listdomains", "\"alter\" 500")
+            + HelpExampleRpc("listdomains", "\"alter\", 500")
+        );
+
+    if (pbdnsdb->AwaitsReindexing()) {
+        if (fReindexingBdns)
+            throw JSONRPCError(RPC_MISC_ERROR, "The wallet is reindexing the BlockchainDNS, you have to wait for it to finish.");
+        else
+            throw JSONRPCError(RPC_MISC_ERROR, "The wallet is awaiting a restart in order to begin reindexing the BlockchainDNS. Proceed with the restart and reindexing in order to use related functionalities.");
+    }
+
+    if (pbdnsdb->PossibleCorruption())
+        throw JSONRPCError(RPC_INTERNAL_ERROR, "The inventory of the BlockchainDNS might be corrupted, in order to correctly list Alterdot domains run a reindexing of the BDNS first by using the command \"bdns reindex\".");
+
+    std::string prefix, cursor;
+    int nCount = 100;
+
+    if (!request.params[0].isNull())
+        prefix = request.params[0].get_str();
+
+    if (!request.params[1].isNull()) {
+        nCount = request.params[1].get_int();
+        if (nCount < 1 || nCount > MAX_BDNS_LIST_COUNT)
+            throw JSONRPCError(RPC_INVALID_PARAMETER, "Invalid parameter, count must be between 1 and " + std::to_string(MAX_BDNS_LIST_COUNT) + ".");
+    }
+
+    if (!request.params[2].isNull()) {
+        if (!IsHex(request.params[2].get_str()))
+            throw JSONRPCError(RPC_INVALID_PARAMETER, "Invalid parameter, cursor must be a hex string.");
+        std::vector<unsigned char> vch = ParseHex(request.params[2].get_str());
+        cursor.assign(vch.begin(), vch.end());
+    }
+
+    std::vector<std::pair<std::string, BDNSRecord> > vRecords;
+    pbdnsdb->ListBDNSRecords(prefix, cursor, nCount, vRecords);
+
+    UniValue domains(UniValue::VARR);
+    for (const auto& p : vRecords) {
+        UniValue domain(UniValue::VOBJ);
+        domain.push_back(Pair("name", p.first));
+        domain.push_back(Pair("content", p.second.content));
+        domain.push_back(Pair("regtxid", p.second.regTxid.GetHex()));
+        domain.push_back(Pair("lastupdatetxid", p.second.lastUpdateTxid.GetHex()));
+        domains.push_back(domain);
+    }
+
+    UniValue result(UniValue::VOBJ);
+    result.push_back(Pair("domains", domains));
+    if (!cursor.empty())
+        result.push_back(Pair("cursor", HexStr(cursor)));
+
+    return result;
+}
+
 UniValue echo(const JSONRPCRequest& request)
 {
     if (request.fHelp)
@@ -1476,13 +1646,29 @@ UniValue bdns(const JSONRPCRequest& request)
             "1. \"action\" (string, required) This action can be either:\n"
             "\"reindex\" which triggers the reindexing of the BDNS starting with block 1,037,000 (the activation block height of the BDNS)\n"
             "\"check\" returns the state of the BlockchainDNS, it can be either \"awaits reindexing\", \"reindexing\", \"possible corruption\" or \"clean\"\n"
+            "\"status\" returns the state of the BlockchainDNS together with the progress of a running reindex and the statistics of the name lookup caches\n"
             "\nResult:\n"
             "\n (string) The state of the BlockchainDNS or related information.\n"
+            "\nResult (for \"status\"):\n"
+            "{\n"
+            "  \"state\": \"xxxx\",      (string) The state of the BlockchainDNS, same as returned by \"check\"\n"
+            "  \"height\": n,          (numeric, optional) The last block height processed by the running reindex\n"
+            "  \"targetheight\": n,    (numeric, optional) The block height the running reindex goes up to\n"
+            "  \"progress\": x.xxx,    (numeric, optional) The progress of the running reindex, between 0 and 1\n"
+            "  \"cache\": {            (json object) Statistics of the in-memory name lookup caches\n"
+            "    \"hits\": n,           (numeric) Lookups answered from memory, including names known to be missing\n"
+            "    \"misses\": n,         (numeric) Lookups that went to the database\n"
+            "    \"records\": n,        (numeric) Cached records\n"
+            "    \"missing\": n         (numeric) Cached names without a record\n"
+            "  }\n"
+            "}\n"
             "\nExamples:\n"
             + HelpExampleCli("bdns", "reindex")
             + HelpExampleCli("bdns", "check")
+            + HelpExampleCli("bdns", "status")
             + HelpExampleRpc("bdns", "reindex")
             + HelpExampleRpc("bdns", "check")
+            + HelpExampleRpc("bdns", "status")
         );
 
     if (request.params[0].isNull()) {
@@ -1510,8 +1696,40 @@ UniValue bdns(const JSONRPCRequest& request)
         }
         
         return pbdnsdb->PossibleCorruption() ? "possible corruption" : "clean";
+    } else if (request.params[0].get_str() == "status") {
+        UniValue result(UniValue::VOBJ);
+
+        if (pbdnsdb->AwaitsReindexing()) {
+            if (fReindexingBdns) {
+                int nHeight = nBdnsReindexHeight;
+                int nTargetHeight = nBdnsReindexTargetHeight;
+                int nStartHeight = Params().GetConsensus().nHardForkEight;
+
+                result.push_back(Pair("state", "reindexing"));
+                if (nTargetHeight != -1) {
+                    result.push_back(Pair("height", nHeight));
+                    result.push_back(Pair("targetheight", nTargetHeight));
+                    result.push_back(Pair("progress", nTargetHeight > nStartHeight ? std::max(0.0, std::min(1.0, (double)(nHeight - nStartHeight + 1) / (nTargetHeight - nStartHeight + 1))) : 0.0));
+                }
+            } else
+                result.push_back(Pair("state", "awaits reindexing"));
+        } else
+            result.push_back(Pair("state", pbdnsdb->PossibleCorruption() ? "possible corruption" : "clean"));
+
+        uint64_t nHits, nMisses;
+        size_t nRecords, nMissing;
+        pbdnsdb->GetCacheStats(nHits, nMisses, nRecords, nMissing);
+
+        UniValue cache(UniValue::VOBJ);
+        cache.push_back(Pair("hits", nHits));
+        cache.push_back(Pair("misses", nMisses));
+        cache.push_back(Pair("records", (uint64_t)nRecords));
+        cache.push_back(Pair("missing", (uint64_t)nMissing));
+        result.push_back(Pair("cache", cache));
+
+        return result;
     } else
-        throw JSONRPCError(RPC_INVALID_PARAMETER, "The first parameter must be either \"reindex\" or \"check\".");
+        throw JSONRPCError(RPC_INVALID_PARAMETER, "The first parameter must be either \"reindex\", \"check\" or \"status\".");
 }
 
 static const CRPCCommand commands[] =
@@ -1541,6 +1759,7 @@ static const CRPCCommand commands[] =
     { "alterdot",           "updatedomain",           &updatedomain,           true,  {"name","hash"} },
 #endif
     { "alterdot",           "resolvedomain",          &resolvedomain,          true,  {"name"} },
+    { "alterdot",           "listdomains",            &listdomains,            true,  {"prefix","count","cursor"} },
     { "alterdot",           "bdns",                   &bdns,                   true,  {"action"} },    
 
     /* Not shown in help */
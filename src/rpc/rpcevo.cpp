@@ -973,6 +973,8 @@ UniValue protx_list(const JSONRPCRequest& request)
         }
 
         CDeterministicMNList mnList = deterministicMNManager->GetListForBlock(chainActive[height]);
+        // explorers list historical heights one after another
+        deterministicMNManager->PrefetchListsAfter(chainActive[height]);
         mnList.ForEachMN(false, [&](const CDeterministicMNCPtr& dmn) {
             if (setOutpts.count(dmn->collateralOutpoint) ||
                 CheckWalletOwnsKey(pwallet, dmn->pdmnState->keyIDOwner) ||
@@ -998,6 +1000,8 @@ UniValue protx_list(const JSONRPCRequest& request)
         }
 
         CDeterministicMNList mnList = deterministicMNManager->GetListForBlock(chainActive[height]);
+        // explorers list historical heights one after another
+        deterministicMNManager->PrefetchListsAfter(chainActive[height]);
         bool onlyValid = type == "valid";
         mnList.ForEachMN(onlyValid, [&](const CDeterministicMNCPtr& dmn) {
             ret.push_back(BuildDMNListEntry(pwallet, dmn, detailed));
@@ -1076,9 +1080,13 @@ UniValue protx_diff(const JSONRPCRequest& request)
         protx_diff_help();
     }
 
-    LOCK(cs_main);
-    uint256 baseBlockHash = ParseBlock(request.params[1], "baseBlock");
-    uint256 blockHash = ParseBlock(request.params[2], "block");
+    uint256 baseBlockHash;
+    uint256 blockHash;
+    {
+        LOCK(cs_main);
+        baseBlockHash = ParseBlock(request.params[1], "baseBlock");
+        blockHash = ParseBlock(request.params[2], "block");
+    }
 
     CSimplifiedMNListDiff mnListDiff;
     std::string strError;
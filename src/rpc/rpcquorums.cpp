@@ -11,6 +11,7 @@
 #include "llmq/quorums_debug.h"
 #include "llmq/quorums_dkgsession.h"
 #include "llmq/quorums_signing.h"
+#include "llmq/quorums_signing_shares.h"
 
 void quorum_list_help()
 {
@@ -248,6 +249,18 @@ UniValue quorum_memberof(const JSONRPCRequest& request)
         throw JSONRPCError(RPC_INVALID_PARAMETER, "masternode not found");
     }
 
+    // the members of each scanned quorum are calculated from the list at its quorum block, load those meanwhile
+    std::vector<const CBlockIndex*> vQuorumIndexes;
+    for (const auto& p : Params().GetConsensus().llmqs) {
+        auto& params = p.second;
+        size_t count = scanQuorumsCount != -1 ? (size_t)scanQuorumsCount : params.signingActiveQuorumCount;
+        int nQuorumHeight = pindexTip->nHeight - (pindexTip->nHeight % params.dkgInterval);
+        for (size_t i = 0; i < count && nQuorumHeight >= 0; i++, nQuorumHeight -= params.dkgInterval) {
+            vQuorumIndexes.emplace_back(pindexTip->GetAncestor(nQuorumHeight));
+        }
+    }
+    deterministicMNManager->PrefetchLists(vQuorumIndexes);
+
     UniValue result(UniValue::VARR);
 
     for (const auto& p : Params().GetConsensus().llmqs) {
@@ -361,6 +374,38 @@ UniValue quorum_sigs_cmd(const JSONRPCRequest& request)
     }
 }
 
+void quorum_sigsharestats_help()
+{
+    throw std::runtime_error(
+            "quorum sigsharestats\n"
+            "Return statistics about the verification of incoming signature shares.\n"
+            "\nResult:\n"
+            "{\n"
+            "  \"rounds\" : n,                (numeric) Number of verification rounds\n"
+            "  \"batches\" : n,               (numeric) Number of verified batches, one per signing session and round\n"
+            "  \"sigShares\" : n,             (numeric) Number of verified signature shares\n"
+            "  \"lastBatchTime\" : n,         (numeric) Verification time of the last batch in microseconds\n"
+            "  \"maxBatchTime\" : n,          (numeric) Longest verification time of a batch in microseconds\n"
+            "  \"avgBatchTime\" : n,          (numeric) Average verification time of a batch in microseconds\n"
+            "  \"lastRoundTime\" : n,         (numeric) Time the last round took to verify all of its batches in microseconds\n"
+            "  \"pendingSigShares\" : n,      (numeric) Signature shares waiting for verification after the last round\n"
+            "  \"maxPendingSigShares\" : n    (numeric) Largest number of signature shares that were waiting for verification\n"
+            "}\n"
+            "\nExamples:\n"
+            + HelpExampleCli("quorum", "sigsharestats")
+            + HelpExampleRpc("quorum", "sigsharestats")
+    );
+}
+
+UniValue quorum_sigsharestats(const JSONRPCRequest& request)
+{
+    if (request.fHelp || (request.params.size() != 1)) {
+        quorum_sigsharestats_help();
+    }
+
+    return llmq::quorumSigSharesManager->GetVerifyStats().ToJson();
+}
+
 void quorum_dkgsimerror_help()
 {
     throw std::runtime_error(
@@ -411,6 +456,7 @@ UniValue quorum_dkgsimerror(const JSONRPCRequest& request)
             "  hasrecsig         - Test if a valid recovered signature is present\n"
             "  getrecsig         - Get a recovered signature\n"
             "  isconflicting     - Test if a conflict exists\n"
+            "  sigsharestats     - Return statistics about the verification of signature shares\n"
     );
 }
 
@@ -437,6 +483,8 @@ UniValue quorum(const JSONRPCRequest& request)
         return quorum_sigs_cmd(request);
     } else if (command == "dkgsimerror") {
         return quorum_dkgsimerror(request);
+    } else if (command == "sigsharestats") {
+        return quorum_sigsharestats(request);
     } else {
         quorum_help();
     }
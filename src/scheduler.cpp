@@ -8,6 +8,8 @@
 
 #include <assert.h>
 #include <boost/bind.hpp>
+#include <chrono>
+#include <functional>
 #include <utility>
 
 CScheduler::CScheduler() : nThreadsServicingQueue(0), stopRequested(false), stopWhenEmpty(false)
@@ -31,6 +33,7 @@ void CScheduler::serviceQueue()
 {
     boost::unique_lock<boost::mutex> lock(newTaskMutex);
     ++nThreadsServicingQueue;
+    setServiceThreads.insert(boost::this_thread::get_id());
 
     // newTaskMutex is locked throughout this loop EXCEPT
     // when the thread is waiting or when the user's function
@@ -76,13 +79,21 @@ void CScheduler::serviceQueue()
             }
         } catch (...) {
             --nThreadsServicingQueue;
+            setServiceThreads.erase(boost::this_thread::get_id());
             throw;
         }
     }
     --nThreadsServicingQueue;
+    setServiceThreads.erase(boost::this_thread::get_id());
     newTaskScheduled.notify_one();
 }
 
+bool CScheduler::IsServiceThread() const
+{
+    boost::unique_lock<boost::mutex> lock(newTaskMutex);
+    return setServiceThreads.count(boost::this_thread::get_id()) > 0;
+}
+
 void CScheduler::stop(bool drain)
 {
     {
@@ -131,3 +142,101 @@ size_t CScheduler::getQueueInfo(boost::chrono::system_clock::time_point &first,
     }
     return result;
 }
+
+void SingleThreadedSchedulerClient::MaybeScheduleProcessQueue()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutexCallbacks);
+        // Try to avoid scheduling too many copies here, but if we
+        // accidentally have two ProcessQueue's scheduled at once its
+        // not a big deal.
+        if (fCallbacksRunning || listCallbacksPending.empty())
+            return;
+    }
+    pscheduler->schedule(std::bind(&SingleThreadedSchedulerClient::ProcessQueue, this), boost::chrono::system_clock::now());
+}
+
+void SingleThreadedSchedulerClient::ProcessQueue()
+{
+    Function callback;
+    {
+        std::lock_guard<std::mutex> lock(mutexCallbacks);
+        if (fCallbacksRunning || listCallbacksPending.empty())
+            return;
+        fCallbacksRunning = true;
+        runningTag = listCallbacksPending.front().first;
+        runningThread = std::this_thread::get_id();
+        callback = std::move(listCallbacksPending.front().second);
+        listCallbacksPending.pop_front();
+    }
+
+    // RAII the resetting of fCallbacksRunning and calling MaybeScheduleProcessQueue
+    // to ensure both happen safely even if callback() throws.
+    struct RAIICallbacksRunning {
+        SingleThreadedSchedulerClient* instance;
+        explicit RAIICallbacksRunning(SingleThreadedSchedulerClient* _instance) : instance(_instance) {}
+        ~RAIICallbacksRunning()
+        {
+            {
+                std::lock_guard<std::mutex> lock(instance->mutexCallbacks);
+                instance->fCallbacksRunning = false;
+                instance->runningTag = nullptr;
+                instance->runningThread = std::thread::id();
+            }
+            instance->condCallbacks.notify_all();
+            instance->MaybeScheduleProcessQueue();
+        }
+    } raiiCallbacksRunning(this);
+
+    callback();
+}
+
+void SingleThreadedSchedulerClient::AddToProcessQueue(Function func, const void* tag)
+{
+    assert(pscheduler);
+
+    {
+        std::lock_guard<std::mutex> lock(mutexCallbacks);
+        listCallbacksPending.emplace_back(tag, std::move(func));
+    }
+    MaybeScheduleProcessQueue();
+}
+
+void SingleThreadedSchedulerClient::RemoveFromProcessQueue(const void* tag)
+{
+    std::unique_lock<std::mutex> lock(mutexCallbacks);
+    listCallbacksPending.remove_if([tag](const std::pair<const void*, Function>& entry) { return entry.first == tag; });
+    condCallbacks.notify_all();
+    condCallbacks.wait(lock, [this, tag] {
+        return !fCallbacksRunning || runningTag != tag || runningThread == std::this_thread::get_id();
+    });
+}
+
+void SingleThreadedSchedulerClient::EmptyQueue()
+{
+    bool fShouldContinue = true;
+    while (fShouldContinue) {
+        ProcessQueue();
+        std::lock_guard<std::mutex> lock(mutexCallbacks);
+        fShouldContinue = fCallbacksRunning || !listCallbacksPending.empty();
+    }
+}
+
+bool SingleThreadedSchedulerClient::WaitForPendingBelow(size_t nMaxPending, int64_t nTimeoutMillis)
+{
+    // The queue is drained by the scheduler threads, one of them waiting here could block it forever
+    if (pscheduler->IsServiceThread())
+        return true;
+
+    std::unique_lock<std::mutex> lock(mutexCallbacks);
+    if (fCallbacksRunning && runningThread == std::this_thread::get_id())
+        return true;
+    return condCallbacks.wait_for(lock, std::chrono::milliseconds(nTimeoutMillis),
+                                  [this, nMaxPending] { return listCallbacksPending.size() < nMaxPending; });
+}
+
+size_t SingleThreadedSchedulerClient::CallbacksPending()
+{
+    std::lock_guard<std::mutex> lock(mutexCallbacks);
+    return listCallbacksPending.size();
+}
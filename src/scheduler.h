@@ -12,7 +12,12 @@
 //
 #include <boost/chrono/chrono.hpp>
 #include <boost/thread.hpp>
+#include <condition_variable>
+#include <list>
 #include <map>
+#include <mutex>
+#include <set>
+#include <thread>
 
 //
 // Simple class for background tasks that should be run
@@ -69,14 +74,82 @@ public:
     size_t getQueueInfo(boost::chrono::system_clock::time_point &first,
                         boost::chrono::system_clock::time_point &last) const;
 
+    // Returns true if the calling thread is running serviceQueue, i.e. if
+    // it is executing one of our tasks
+    bool IsServiceThread() const;
+
 private:
     std::multimap<boost::chrono::system_clock::time_point, Function> taskQueue;
     boost::condition_variable newTaskScheduled;
     mutable boost::mutex newTaskMutex;
     int nThreadsServicingQueue;
+    std::set<boost::thread::id> setServiceThreads;
     bool stopRequested;
     bool stopWhenEmpty;
     bool shouldStop() { return stopRequested || (stopWhenEmpty && taskQueue.empty()); }
 };
 
+/**
+ * Class used by CScheduler clients which may schedule multiple jobs
+ * which are required to be run serially. Jobs may not be run on the
+ * same thread, but no two jobs will be executed
+ * at the same time and memory will be release-acquire consistent
+ * (the scheduler will internally do an acquire before invoking a callback
+ * as well as a release at the end). In practice this means that a callback
+ * B() will be able to observe all of the effects of callback A() which executed
+ * before it.
+ *
+ * Every job may carry a tag (usually the object it is delivered to), which allows
+ * dropping the jobs of a single consumer without touching the rest of the queue.
+ */
+class SingleThreadedSchedulerClient
+{
+public:
+    typedef std::function<void(void)> Function;
+
+    explicit SingleThreadedSchedulerClient(CScheduler* pschedulerIn) : pscheduler(pschedulerIn) {}
+
+    /**
+     * Add a callback to be executed. Callbacks are executed serially
+     * and memory is release-acquire consistent between callback executions.
+     * Practically, this means that callbacks can behave as if they are executed
+     * in order by a single thread.
+     */
+    void AddToProcessQueue(Function func, const void* tag = nullptr);
+
+    /**
+     * Drops all pending callbacks carrying the given tag and waits for a running
+     * one to finish, unless it is running on the calling thread.
+     */
+    void RemoveFromProcessQueue(const void* tag);
+
+    /**
+     * Processes all remaining queue members on the calling thread, blocking until queue is empty.
+     * Must be called after the CScheduler has no remaining processing threads!
+     */
+    void EmptyQueue();
+
+    /**
+     * Blocks until less than nMaxPending callbacks are waiting or the timeout expires. Returns
+     * immediately when called from a running callback or any other task of the scheduler, as
+     * the queue can't make progress while that thread waits. Returns false on timeout.
+     */
+    bool WaitForPendingBelow(size_t nMaxPending, int64_t nTimeoutMillis);
+
+    size_t CallbacksPending();
+
+private:
+    CScheduler* pscheduler;
+
+    std::mutex mutexCallbacks;
+    std::condition_variable condCallbacks;
+    std::list<std::pair<const void*, Function>> listCallbacksPending;
+    bool fCallbacksRunning{false};
+    const void* runningTag{nullptr};
+    std::thread::id runningThread;
+
+    void MaybeScheduleProcessQueue();
+    void ProcessQueue();
+};
+
 #endif
@@ -159,6 +159,7 @@ public:
 
     template <typename Stream, typename Operation>
     inline void SerializationOp(Stream& s, Operation ser_action) {
+        LOCK(cs);
         std::string strVersion;
         if(ser_action.ForRead()) {
             READWRITE(strVersion);
@@ -0,0 +1,160 @@
+// Copyright (c) 2021 Alterdot developers
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "random.h"
+#include "txdb.h"
+#include "test/test_alterdot.h"
+
+#include <boost/test/unit_test.hpp>
+
+BOOST_FIXTURE_TEST_SUITE(addressindex_tests, BasicTestingSetup)
+
+BOOST_AUTO_TEST_CASE(addressindex_balance)
+{
+    CBlockTreeDB db(1 << 20, true, true);
+    BOOST_CHECK(db.BuildAddressBalanceIndex());
+
+    const uint160 addr1 = uint160(std::vector<unsigned char>(20, 1));
+    const uint160 addr2 = uint160(std::vector<unsigned char>(20, 2));
+    const uint256 tx1 = GetRandHash();
+    const uint256 tx2 = GetRandHash();
+
+    // block 1: tx1 pays addr1 twice
+    std::vector<std::pair<CAddressIndexKey, CAmount> > block1;
+    block1.emplace_back(CAddressIndexKey(1, addr1, 1, 0, tx1, 0, false), 50);
+    block1.emplace_back(CAddressIndexKey(1, addr1, 1, 0, tx1, 1, false), 20);
+    BOOST_CHECK(db.WriteAddressIndex(block1));
+
+    // block 2: tx2 spends one output of addr1, pays addr2 and sends change back
+    std::vector<std::pair<CAddressIndexKey, CAmount> > block2;
+    block2.emplace_back(CAddressIndexKey(1, addr1, 2, 1, tx2, 0, true), -50);
+    block2.emplace_back(CAddressIndexKey(1, addr2, 2, 1, tx2, 0, false), 30);
+    block2.emplace_back(CAddressIndexKey(1, addr1, 2, 1, tx2, 1, false), 15);
+    BOOST_CHECK(db.WriteAddressIndex(block2));
+
+    CAddressBalanceValue value;
+    BOOST_CHECK(db.ReadAddressBalance(addr1, 1, value));
+    BOOST_CHECK_EQUAL(value.balance, 35);
+    BOOST_CHECK_EQUAL(value.received, 85);
+    BOOST_CHECK_EQUAL(value.txCount, 2);
+    BOOST_CHECK(db.ReadAddressBalance(addr2, 1, value));
+    BOOST_CHECK_EQUAL(value.balance, 30);
+    BOOST_CHECK_EQUAL(value.txCount, 1);
+    // same hash, other type
+    BOOST_CHECK(db.ReadAddressBalance(addr2, 2, value));
+    BOOST_CHECK(value.IsNull());
+
+    // building from the deltas gives the same result as the incremental updates
+    BOOST_CHECK(db.BuildAddressBalanceIndex());
+    BOOST_CHECK(db.ReadAddressBalance(addr1, 1, value));
+    BOOST_CHECK_EQUAL(value.balance, 35);
+    BOOST_CHECK_EQUAL(value.received, 85);
+    BOOST_CHECK_EQUAL(value.txCount, 2);
+
+    // disconnecting block 2
+    BOOST_CHECK(db.EraseAddressIndex(block2));
+    BOOST_CHECK(db.ReadAddressBalance(addr1, 1, value));
+    BOOST_CHECK_EQUAL(value.balance, 70);
+    BOOST_CHECK_EQUAL(value.received, 70);
+    BOOST_CHECK_EQUAL(value.txCount, 1);
+    BOOST_CHECK(db.ReadAddressBalance(addr2, 1, value));
+    BOOST_CHECK(value.IsNull());
+}
+
+// Blocks may get applied or undone more than once, e.g. when the block tree DB is ahead of the
+// chainstate after an unclean shutdown. The balances must only change when the entries do.
+BOOST_AUTO_TEST_CASE(addressindex_balance_reapply)
+{
+    CBlockTreeDB db(1 << 20, true, true);
+
+    const uint160 addr = uint160(std::vector<unsigned char>(20, 1));
+    const uint256 tx1 = GetRandHash();
+    const uint256 tx2 = GetRandHash();
+
+    std::vector<std::pair<CAddressIndexKey, CAmount> > block1;
+    block1.emplace_back(CAddressIndexKey(1, addr, 1, 0, tx1, 0, false), 50);
+    std::vector<std::pair<CAddressIndexKey, CAmount> > block2;
+    block2.emplace_back(CAddressIndexKey(1, addr, 2, 1, tx2, 0, true), -50);
+    block2.emplace_back(CAddressIndexKey(1, addr, 2, 1, tx2, 1, false), 40);
+    BOOST_CHECK(db.WriteAddressIndex(block1));
+    BOOST_CHECK(db.WriteAddressIndex(block2));
+
+    CAddressBalanceValue value;
+    BOOST_CHECK(db.ReadAddressBalance(addr, 1, value));
+    BOOST_CHECK_EQUAL(value.balance, 40);
+    BOOST_CHECK_EQUAL(value.received, 90);
+    BOOST_CHECK_EQUAL(value.txCount, 2);
+
+    // connecting block 2 again changes nothing
+    BOOST_CHECK(db.WriteAddressIndex(block2));
+    BOOST_CHECK(db.ReadAddressBalance(addr, 1, value));
+    BOOST_CHECK_EQUAL(value.balance, 40);
+    BOOST_CHECK_EQUAL(value.received, 90);
+    BOOST_CHECK_EQUAL(value.txCount, 2);
+
+    // neither does disconnecting it twice
+    BOOST_CHECK(db.EraseAddressIndex(block2));
+    BOOST_CHECK(db.EraseAddressIndex(block2));
+    BOOST_CHECK(db.ReadAddressBalance(addr, 1, value));
+    BOOST_CHECK_EQUAL(value.balance, 50);
+    BOOST_CHECK_EQUAL(value.received, 50);
+    BOOST_CHECK_EQUAL(value.txCount, 1);
+
+    // and reconnecting it restores the balance
+    BOOST_CHECK(db.WriteAddressIndex(block2));
+    BOOST_CHECK(db.ReadAddressBalance(addr, 1, value));
+    BOOST_CHECK_EQUAL(value.balance, 40);
+    BOOST_CHECK_EQUAL(value.received, 90);
+    BOOST_CHECK_EQUAL(value.txCount, 2);
+}
+
+BOOST_AUTO_TEST_CASE(addressindex_paging)
+{
+    CBlockTreeDB db(1 << 20, true, true);
+
+    const uint160 addr = uint160(std::vector<unsigned char>(20, 1));
+    const uint160 other = uint160(std::vector<unsigned char>(20, 2));
+    std::vector<std::pair<CAddressIndexKey, CAmount> > entries;
+    for (int h = 1; h <= 25; h++) {
+        entries.emplace_back(CAddressIndexKey(1, addr, h, 1, GetRandHash(), 0, false), h);
+        entries.emplace_back(CAddressIndexKey(1, other, h, 1, GetRandHash(), 0, false), h);
+    }
+    BOOST_CHECK(db.WriteAddressIndex(entries));
+
+    std::vector<std::pair<CAddressIndexKey, CAmount> > all;
+    BOOST_CHECK(db.ReadAddressIndex(addr, 1, all));
+    BOOST_CHECK_EQUAL(all.size(), 25U);
+
+    // pages of 10 continue after the last key of the previous page
+    std::vector<std::pair<CAddressIndexKey, CAmount> > paged;
+    const CAddressIndexKey* pStartAfter = nullptr;
+    CAddressIndexKey cursor;
+    while (true) {
+        size_t nPrevSize = paged.size();
+        BOOST_CHECK(db.ReadAddressIndex(addr, 1, paged, 0, 0, pStartAfter, 10));
+        BOOST_CHECK(paged.size() - nPrevSize <= 10);
+        if (paged.size() - nPrevSize < 10) {
+            break;
+        }
+        cursor = paged.back().first;
+        pStartAfter = &cursor;
+    }
+    BOOST_CHECK_EQUAL(paged.size(), all.size());
+    for (size_t i = 0; i < all.size() && i < paged.size(); i++) {
+        BOOST_CHECK(paged[i].first.txhash == all[i].first.txhash);
+        BOOST_CHECK_EQUAL(paged[i].second, all[i].second);
+    }
+
+    // the height range still applies when paging
+    std::vector<std::pair<CAddressIndexKey, CAmount> > range;
+    BOOST_CHECK(db.ReadAddressIndex(addr, 1, range, 5, 9, nullptr, 3));
+    BOOST_CHECK_EQUAL(range.size(), 3U);
+    cursor = range.back().first;
+    BOOST_CHECK(db.ReadAddressIndex(addr, 1, range, 5, 9, &cursor, 3));
+    BOOST_CHECK_EQUAL(range.size(), 5U);
+    BOOST_CHECK_EQUAL(range.front().first.blockHeight, 5);
+    BOOST_CHECK_EQUAL(range.back().first.blockHeight, 9);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
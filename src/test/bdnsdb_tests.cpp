@@ -0,0 +1,227 @@
+// Copyright (c) 2021 Alterdot developers
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "bdnsdb.h"
+#include "random.h"
+#include "test/test_alterdot.h"
+
+#include <boost/test/unit_test.hpp>
+
+BOOST_FIXTURE_TEST_SUITE(bdnsdb_tests, TestingSetup)
+
+BOOST_AUTO_TEST_CASE(bdnsdb_block_undo)
+{
+    CBDNSDB db(1 << 20, true, true);
+    BOOST_CHECK(db.CleanDatabase());
+
+    const uint256 regTxid = GetRandHash();
+    const uint256 updateTxid = GetRandHash();
+    BDNSRecord record;
+    std::string content;
+
+    // block 1 registers two names
+    db.BeginBlock(1);
+    BOOST_CHECK(db.WriteBDNSRecord("alpha", BDNSRecord{"content1", regTxid, uint256()}));
+    BOOST_CHECK(db.WriteBDNSRecord("beta", BDNSRecord{"content2", regTxid, uint256()}));
+    // changes are visible while the block is processed
+    BOOST_CHECK(db.HasBDNSRecord("alpha"));
+    BOOST_CHECK(db.CommitBlock());
+
+    // block 2 updates one, erases the other and registers a third one
+    db.BeginBlock(2);
+    BOOST_CHECK(db.UpdateBDNSRecord("alpha", "content3", updateTxid));
+    BOOST_CHECK(db.EraseBDNSRecord("beta"));
+    BOOST_CHECK(!db.HasBDNSRecord("beta"));
+    BOOST_CHECK(db.WriteBDNSRecord("gamma", BDNSRecord{"content4", updateTxid, uint256()}));
+    BOOST_CHECK(db.CommitBlock());
+
+    BOOST_CHECK(db.GetContentFromBDNSRecord("alpha", content) && content == "content3");
+    BOOST_CHECK(!db.HasBDNSRecord("beta"));
+    BOOST_CHECK(db.HasBDNSRecord("gamma"));
+
+    // disconnecting block 2 restores the records exactly as they were after block 1
+    BOOST_CHECK(db.UndoBlock(2));
+    BOOST_CHECK(db.ReadBDNSRecord("alpha", record));
+    BOOST_CHECK(record.content == "content1" && record.regTxid == regTxid && record.lastUpdateTxid.IsNull());
+    BOOST_CHECK(db.GetContentFromBDNSRecord("beta", content) && content == "content2");
+    BOOST_CHECK(!db.HasBDNSRecord("gamma"));
+    BOOST_CHECK(!db.PossibleCorruption());
+
+    // undo data is consumed by the disconnect
+    BOOST_CHECK(!db.UndoBlock(2));
+
+    // changes made in dry run mode never reach the database
+    {
+        CBDNSDryRunScope dryRun(db);
+        db.BeginBlock(2);
+        BOOST_CHECK(db.EraseBDNSRecord("alpha"));
+        BOOST_CHECK(db.CommitBlock());
+        BOOST_CHECK(db.UndoBlock(1));
+    }
+    BOOST_CHECK(db.HasBDNSRecord("alpha"));
+    BOOST_CHECK(db.HasBDNSRecord("beta"));
+}
+
+BOOST_AUTO_TEST_CASE(bdnsdb_block_batch)
+{
+    CBDNSDB db(1 << 20, true, true);
+    BOOST_CHECK(db.CleanDatabase());
+
+    db.BeginBlock(1);
+    BOOST_CHECK(db.WriteBDNSRecord("alpha", BDNSRecord{"content1", GetRandHash(), uint256()}));
+    BOOST_CHECK(db.CommitBlock());
+
+    // a block that is never committed leaves no trace, e.g. after a crash mid-block
+    db.BeginBlock(2);
+    BOOST_CHECK(db.EraseBDNSRecord("alpha"));
+    BOOST_CHECK(db.WriteBDNSRecord("beta", BDNSRecord{"content2", GetRandHash(), uint256()}));
+
+    // a corruption detected while processing is visible right away but only written with the block
+    BOOST_CHECK(db.WriteCorruptionState(true));
+    BOOST_CHECK(db.PossibleCorruption());
+
+    db.BeginBlock(2);
+    BOOST_CHECK(db.HasBDNSRecord("alpha"));
+    BOOST_CHECK(!db.HasBDNSRecord("beta"));
+    BOOST_CHECK(!db.PossibleCorruption());
+
+    BOOST_CHECK(db.WriteCorruptionState(true));
+    BOOST_CHECK(db.CommitBlock());
+    BOOST_CHECK(db.PossibleCorruption());
+
+    // skipping heights is flagged as well
+    BOOST_CHECK(db.CleanDatabase());
+    BOOST_CHECK(!db.PossibleCorruption());
+    db.BeginBlock(1);
+    BOOST_CHECK(db.CommitBlock());
+    db.BeginBlock(3);
+    BOOST_CHECK(db.CommitBlock());
+    BOOST_CHECK(db.PossibleCorruption());
+}
+
+BOOST_AUTO_TEST_CASE(bdnsdb_expiry)
+{
+    CBDNSDB db(1 << 20, true, true);
+    BOOST_CHECK(db.CleanDatabase());
+    std::vector<std::string> vExpiredNames;
+
+    db.BeginBlock(1);
+    BOOST_CHECK(db.WriteBDNSRecord("alpha", BDNSRecord{"content1", GetRandHash(), uint256()}));
+    BOOST_CHECK(db.WriteBDNSExpiry("alpha", 3));
+    BOOST_CHECK(db.WriteBDNSRecord("beta", BDNSRecord{"content2", GetRandHash(), uint256()}));
+    BOOST_CHECK(db.WriteBDNSExpiry("beta", 4));
+    BOOST_CHECK(db.ExpireBDNSRecords(vExpiredNames) && vExpiredNames.empty());
+    BOOST_CHECK(db.CommitBlock());
+
+    db.BeginBlock(2);
+    BOOST_CHECK(db.ExpireBDNSRecords(vExpiredNames) && vExpiredNames.empty());
+    BOOST_CHECK(db.CommitBlock());
+
+    // only the names scheduled for the height of the block expire
+    db.BeginBlock(3);
+    BOOST_CHECK(db.ExpireBDNSRecords(vExpiredNames));
+    BOOST_CHECK(vExpiredNames.size() == 1 && vExpiredNames[0] == "alpha");
+    BOOST_CHECK(db.CommitBlock());
+    BOOST_CHECK(!db.HasBDNSRecord("alpha"));
+    BOOST_CHECK(db.HasBDNSRecord("beta"));
+
+    // disconnecting the block brings back the record and its expiry entry
+    BOOST_CHECK(db.UndoBlock(3));
+    BOOST_CHECK(db.HasBDNSRecord("alpha"));
+
+    vExpiredNames.clear();
+    db.BeginBlock(3);
+    BOOST_CHECK(db.ExpireBDNSRecords(vExpiredNames));
+    BOOST_CHECK(vExpiredNames.size() == 1 && vExpiredNames[0] == "alpha");
+    BOOST_CHECK(db.CommitBlock());
+
+    // disconnecting the registering block drops the expiry entries it added
+    BOOST_CHECK(db.UndoBlock(3));
+    BOOST_CHECK(db.UndoBlock(2));
+    BOOST_CHECK(db.UndoBlock(1));
+    BOOST_CHECK(!db.PossibleCorruption());
+
+    for (int nHeight = 1; nHeight <= 4; nHeight++) {
+        vExpiredNames.clear();
+        db.BeginBlock(nHeight);
+        BOOST_CHECK(db.ExpireBDNSRecords(vExpiredNames) && vExpiredNames.empty());
+        BOOST_CHECK(db.CommitBlock());
+    }
+}
+
+BOOST_AUTO_TEST_CASE(bdnsdb_cache)
+{
+    CBDNSDB db(1 << 20, true, true);
+    BOOST_CHECK(db.CleanDatabase());
+    uint64_t nHits, nMisses;
+    size_t nRecords, nMissing;
+    std::string content;
+
+    // a lookup of a missing name is cached as well
+    BOOST_CHECK(!db.HasBDNSRecord("alpha"));
+    BOOST_CHECK(!db.HasBDNSRecord("alpha"));
+    db.GetCacheStats(nHits, nMisses, nRecords, nMissing);
+    BOOST_CHECK(nHits == 1 && nMisses == 1 && nRecords == 0 && nMissing == 1);
+
+    // connecting a block invalidates the names it changed
+    db.BeginBlock(1);
+    BOOST_CHECK(db.WriteBDNSRecord("alpha", BDNSRecord{"content1", GetRandHash(), uint256()}));
+    BOOST_CHECK(db.CommitBlock());
+    BOOST_CHECK(db.GetContentFromBDNSRecord("alpha", content) && content == "content1");
+    BOOST_CHECK(db.GetContentFromBDNSRecord("alpha", content) && content == "content1");
+    db.GetCacheStats(nHits, nMisses, nRecords, nMissing);
+    BOOST_CHECK(nHits == 2 && nMisses == 2 && nRecords == 1 && nMissing == 0);
+
+    db.BeginBlock(2);
+    BOOST_CHECK(db.UpdateBDNSRecord("alpha", "content2", GetRandHash()));
+    BOOST_CHECK(db.CommitBlock());
+    BOOST_CHECK(db.GetContentFromBDNSRecord("alpha", content) && content == "content2");
+
+    // and so does disconnecting it
+    BOOST_CHECK(db.UndoBlock(2));
+    BOOST_CHECK(db.GetContentFromBDNSRecord("alpha", content) && content == "content1");
+    BOOST_CHECK(db.UndoBlock(1));
+    BOOST_CHECK(!db.HasBDNSRecord("alpha"));
+
+    BOOST_CHECK(db.CleanDatabase());
+    db.GetCacheStats(nHits, nMisses, nRecords, nMissing);
+    BOOST_CHECK(nRecords == 0 && nMissing == 0);
+}
+
+BOOST_AUTO_TEST_CASE(bdnsdb_list)
+{
+    CBDNSDB db(1 << 20, true, true);
+    BOOST_CHECK(db.CleanDatabase());
+
+    const std::vector<std::string> vNames = {"a", "ab", "abc", "abd", "b", "ba", "bab", "abcdef", "xab"};
+
+    db.BeginBlock(1);
+    for (const auto& bdnsName : vNames)
+        BOOST_CHECK(db.WriteBDNSRecord(bdnsName, BDNSRecord{"content", GetRandHash(), uint256()}));
+    BOOST_CHECK(db.CommitBlock());
+
+    std::vector<std::pair<std::string, BDNSRecord> > vRecords;
+    std::string cursor;
+
+    db.ListBDNSRecords("", cursor, MAX_BDNS_LIST_COUNT, vRecords);
+    BOOST_CHECK(vRecords.size() == vNames.size() && cursor.empty());
+
+    // names sharing a prefix are found across all lengths, page by page
+    std::vector<std::string> vListed;
+    do {
+        vRecords.clear();
+        db.ListBDNSRecords("ab", cursor, 2, vRecords);
+        BOOST_CHECK(vRecords.size() <= 2);
+        for (const auto& p : vRecords)
+            vListed.push_back(p.first);
+    } while (!cursor.empty());
+
+    BOOST_CHECK(vListed == std::vector<std::string>({"ab", "abc", "abd", "abcdef"}));
+
+    vRecords.clear();
+    db.ListBDNSRecords("zz", cursor, 10, vRecords);
+    BOOST_CHECK(vRecords.empty() && cursor.empty());
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -4,6 +4,7 @@
 
 #include "bls/bls.h"
 #include "bls/bls_batchverifier.h"
+#include "bls/bls_worker.h"
 #include "test/test_alterdot.h"
 
 #include <boost/test/unit_test.hpp>
@@ -154,4 +155,43 @@ BOOST_AUTO_TEST_CASE(batch_verifier_tests)
     Verify(msgs);
 }
 
+BOOST_AUTO_TEST_CASE(worker_asyncrun_tests)
+{
+    // split per-session batches verified in parallel must give the same results as verifying them on one thread
+    std::vector<CBLSSecretKey> sks(8);
+    std::vector<uint256> msgHashes = {GetRandHash(), GetRandHash()};
+    for (auto& sk : sks) {
+        sk.MakeNewKey();
+    }
+
+    CBLSWorker worker;
+    for (int started = 0; started < 2; started++) {
+        if (started) {
+            worker.Start();
+        }
+
+        std::vector<std::unique_ptr<CBLSBatchVerifier<int, uint256>>> verifiers;
+        for (size_t i = 0; i < msgHashes.size(); i++) {
+            verifiers.emplace_back(std::make_unique<CBLSBatchVerifier<int, uint256>>(false, true));
+            for (size_t j = 0; j < sks.size(); j++) {
+                // source 3 signs the wrong message in the second session
+                auto sig = sks[j].Sign(i == 1 && j == 3 ? msgHashes[0] : msgHashes[i]);
+                verifiers[i]->PushMessage((int)j, GetRandHash(), msgHashes[i], sig, sks[j].GetPublicKey());
+            }
+        }
+
+        std::vector<std::future<void>> futures;
+        for (auto& v : verifiers) {
+            auto pv = v.get();
+            futures.emplace_back(worker.AsyncRun([pv]() { pv->Verify(); }));
+        }
+        for (auto& f : futures) {
+            f.get();
+        }
+
+        BOOST_CHECK(verifiers[0]->badSources.empty());
+        BOOST_CHECK(verifiers[1]->badSources == std::set<int>({3}));
+    }
+}
+
 BOOST_AUTO_TEST_SUITE_END()
@@ -213,6 +213,45 @@ static CDeterministicMNCPtr FindPayoutDmn(const CBlock& block)
 
 BOOST_AUTO_TEST_SUITE(evo_dip3_activation_tests)
 
+BOOST_FIXTURE_TEST_CASE(dip3_quorum_scores, BasicTestingSetup)
+{
+    // large enough to have the scores calculated in parallel
+    CDeterministicMNList mnList(uint256(), 0, 0);
+    for (size_t i = 0; i < 2000; i++) {
+        auto dmn = std::make_shared<CDeterministicMN>();
+        dmn->proTxHash = GetRandHash();
+        dmn->internalId = i;
+        dmn->collateralOutpoint = COutPoint(GetRandHash(), 0);
+        auto state = std::make_shared<CDeterministicMNState>();
+        uint256 ownerHash = GetRandHash();
+        state->keyIDOwner = CKeyID(uint160(std::vector<unsigned char>(ownerHash.begin(), ownerHash.begin() + 20)));
+        if (i % 10 != 0) {
+            state->UpdateConfirmedHash(dmn->proTxHash, GetRandHash());
+        }
+        dmn->pdmnState = state;
+        mnList.AddMN(dmn);
+    }
+
+    uint256 modifier = GetRandHash();
+    auto scores = mnList.CalculateScores(modifier);
+    BOOST_CHECK_EQUAL(scores.size(), 1800U);
+    for (const auto& p : scores) {
+        uint256 h;
+        CSHA256().Write(p.second->pdmnState->confirmedHashWithProRegTxHash.begin(), 32).Write(modifier.begin(), 32).Finalize(h.begin());
+        BOOST_CHECK(p.first == UintToArith256(h));
+    }
+
+    std::sort(scores.begin(), scores.end(), [](const std::pair<arith_uint256, CDeterministicMNCPtr>& a, const std::pair<arith_uint256, CDeterministicMNCPtr>& b) {
+        return b.first < a.first;
+    });
+    auto quorum = mnList.CalculateQuorum(50, modifier);
+    BOOST_CHECK_EQUAL(quorum.size(), 50U);
+    for (size_t i = 0; i < quorum.size(); i++) {
+        BOOST_CHECK(quorum[i] == scores[i].second);
+    }
+    BOOST_CHECK_EQUAL(mnList.CalculateQuorum(5000, modifier).size(), scores.size());
+}
+
 BOOST_FIXTURE_TEST_CASE(dip3_activation, TestChainDIP3BeforeActivationSetup)
 {
     auto utxos = BuildSimpleUtxoMap(coinbaseTxns);
@@ -399,6 +438,20 @@ BOOST_FIXTURE_TEST_CASE(dip3_protx, TestChainDIP3Setup)
     }
     BOOST_ASSERT(foundRevived);
 
+    // a cache too small for more than one list has to give the same lists
+    CDeterministicMNManager smallCacheManager(*evoDb, 1);
+    for (int h = Params().GetConsensus().DIP0003Height; h <= chainActive.Height(); h++) {
+        auto mnList = deterministicMNManager->GetListForBlock(chainActive[h]);
+        auto mnList2 = smallCacheManager.GetListForBlock(chainActive[h]);
+        BOOST_CHECK(mnList.GetBlockHash() == mnList2.GetBlockHash());
+        BOOST_CHECK_EQUAL(mnList.GetAllMNsCount(), mnList2.GetAllMNsCount());
+        BOOST_CHECK(!mnList.BuildDiff(mnList2).HasChanges());
+    }
+    size_t nEntries, nMemoryUsage, nMaxMemoryUsage;
+    smallCacheManager.GetCacheStats(nEntries, nMemoryUsage, nMaxMemoryUsage);
+    BOOST_CHECK_EQUAL(nEntries, 1U);
+    BOOST_CHECK_EQUAL(nMaxMemoryUsage, 1U);
+
     const_cast<Consensus::Params&>(Params().GetConsensus()).DIP0003EnforcementHeight = DIP0003EnforcementHeightBackup;
 }
 BOOST_AUTO_TEST_SUITE_END()
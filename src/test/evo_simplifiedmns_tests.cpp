@@ -5,8 +5,11 @@
 #include "test/test_alterdot.h"
 
 #include "bls/bls.h"
+#include "consensus/merkle.h"
+#include "evo/deterministicmns.h"
 #include "evo/simplifiedmns.h"
 #include "netbase.h"
+#include "primitives/block.h"
 
 #include <boost/test/unit_test.hpp>
 
@@ -70,4 +73,75 @@ BOOST_AUTO_TEST_CASE(simplifiedmns_merkleroots)
 
     BOOST_CHECK(expectedMerkleRoot == calculatedMerkleRoot);
 }
+
+BOOST_AUTO_TEST_CASE(simplifiedmns_cbtxproof)
+{
+    CBlock block;
+    for (size_t i = 0; i < 7; i++) {
+        CMutableTransaction tx;
+        tx.vin.resize(1);
+        tx.vin[0].prevout.n = i;
+        tx.vout.resize(1);
+        tx.vout[0].nValue = i;
+        block.vtx.push_back(MakeTransactionRef(tx));
+    }
+    block.hashMerkleRoot = BlockMerkleRoot(block);
+
+    CDataStream ss(SER_DISK, CLIENT_VERSION);
+    ss << CSimplifiedMNListCbTxProof(block);
+    CSimplifiedMNListCbTxProof proof;
+    ss >> proof;
+
+    // the stored proof must be the same one the diff used to build from the full block
+    std::vector<uint256> vMatch;
+    std::vector<unsigned int> vIndex;
+    BOOST_CHECK(proof.cbTx->GetHash() == block.vtx[0]->GetHash());
+    BOOST_CHECK(proof.cbTxMerkleTree.ExtractMatches(vMatch, vIndex) == block.hashMerkleRoot);
+    BOOST_CHECK(vMatch.size() == 1 && vMatch[0] == block.vtx[0]->GetHash() && vIndex[0] == 0);
+}
+BOOST_AUTO_TEST_CASE(simplifiedmns_merkletree)
+{
+    CSimplifiedMNListMerkleTree tree;
+    CDeterministicMNList mnList(uint256(), 0, 0);
+
+    BOOST_CHECK(tree.Update(mnList) == CSimplifiedMNList(mnList).CalcMerkleRoot());
+
+    for (size_t i = 0; i < 13; i++) {
+        auto dmn = std::make_shared<CDeterministicMN>();
+        dmn->proTxHash = GetRandHash();
+        dmn->internalId = i;
+        dmn->collateralOutpoint = COutPoint(GetRandHash(), 0);
+        auto state = std::make_shared<CDeterministicMNState>();
+        state->keyIDOwner = CKeyID(uint160(std::vector<unsigned char>(20, (unsigned char)i)));
+        state->confirmedHash = GetRandHash();
+        dmn->pdmnState = state;
+        mnList.AddMN(dmn);
+
+        // the tree follows every size of the list, including the odd ones
+        BOOST_CHECK(tree.Update(mnList) == CSimplifiedMNList(mnList).CalcMerkleRoot());
+    }
+
+    std::vector<uint256> vProTxHashes;
+    mnList.ForEachMN(false, [&](const CDeterministicMNCPtr& dmn) {
+        vProTxHashes.emplace_back(dmn->proTxHash);
+    });
+
+    for (size_t i = 0; i < vProTxHashes.size(); i += 3) {
+        auto state = std::make_shared<CDeterministicMNState>(*mnList.GetMN(vProTxHashes[i])->pdmnState);
+        state->nPoSeBanHeight = 1;
+        mnList.UpdateMN(vProTxHashes[i], state);
+        BOOST_CHECK(tree.Update(mnList) == CSimplifiedMNList(mnList).CalcMerkleRoot());
+    }
+
+    for (size_t i = 0; i < vProTxHashes.size(); i += 2) {
+        mnList.RemoveMN(vProTxHashes[i]);
+        BOOST_CHECK(tree.Update(mnList) == CSimplifiedMNList(mnList).CalcMerkleRoot());
+    }
+
+    // a different list is handled just as well, e.g. after switching to another chain
+    CDeterministicMNList emptyList(uint256(), 0, 0);
+    BOOST_CHECK(tree.Update(emptyList) == uint256());
+    BOOST_CHECK(tree.Update(mnList) == CSimplifiedMNList(mnList).CalcMerkleRoot());
+}
+
 BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,123 @@
+// Copyright (c) 2021 Alterdot developers
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "flat-database.h"
+
+#include "test/test_alterdot.h"
+
+#include <boost/test/unit_test.hpp>
+
+namespace {
+struct CTestCache {
+    std::vector<std::string> vecItems;
+
+    ADD_SERIALIZE_METHODS;
+
+    template <typename Stream, typename Operation>
+    inline void SerializationOp(Stream& s, Operation ser_action)
+    {
+        READWRITE(vecItems);
+    }
+
+    void Clear() { vecItems.clear(); }
+    void CheckAndRemove() {}
+    std::string ToString() const { return strprintf("Items: %d", vecItems.size()); }
+};
+
+// like the caches of the managers, data of another version is skipped without reading it
+struct CTestVersionedCache : public CTestCache {
+    static std::string strVersionCurrent;
+
+    ADD_SERIALIZE_METHODS;
+
+    template <typename Stream, typename Operation>
+    inline void SerializationOp(Stream& s, Operation ser_action)
+    {
+        std::string strVersion = strVersionCurrent;
+        READWRITE(strVersion);
+        if (strVersion != strVersionCurrent) {
+            Clear();
+            return;
+        }
+        READWRITE(vecItems);
+    }
+};
+
+std::string CTestVersionedCache::strVersionCurrent;
+} // namespace
+
+BOOST_FIXTURE_TEST_SUITE(flatdb_tests, TestingSetup)
+
+BOOST_AUTO_TEST_CASE(flatdb_roundtrip)
+{
+    // enough data to span several chunks
+    CTestCache cache;
+    for (int i = 0; i < 10000; i++) {
+        cache.vecItems.push_back(strprintf("item %d", i));
+    }
+
+    CFlatDB<CTestCache> flatdb("testcache.dat", "magicTestCache");
+    BOOST_CHECK(flatdb.Dump(cache));
+
+    CTestCache cacheLoaded;
+    BOOST_CHECK(flatdb.Load(cacheLoaded));
+    BOOST_CHECK(cacheLoaded.vecItems == cache.vecItems);
+
+    // snapshots produce the same file
+    cache.vecItems.push_back("snapshot");
+    BOOST_CHECK(flatdb.DumpSnapshot(cache));
+    BOOST_CHECK(flatdb.Load(cacheLoaded));
+    BOOST_CHECK(cacheLoaded.vecItems == cache.vecItems);
+
+    // a different magic message is refused
+    CFlatDB<CTestCache> flatdbOther("testcache.dat", "magicOtherCache");
+    BOOST_CHECK(!flatdbOther.Load(cacheLoaded));
+}
+
+BOOST_AUTO_TEST_CASE(flatdb_corruption)
+{
+    CTestCache cache;
+    cache.vecItems.assign(100, "item");
+
+    CFlatDB<CTestCache> flatdb("testcache.dat", "magicTestCache");
+    BOOST_CHECK(flatdb.Dump(cache));
+
+    // flip a byte inside the payload, the checksum has to catch it
+    boost::filesystem::path path = GetDataDir() / "testcache.dat";
+    FILE* file = fopen(path.string().c_str(), "r+b");
+    BOOST_REQUIRE(file != nullptr);
+    fseek(file, 102, SEEK_SET);
+    int ch = fgetc(file);
+    fseek(file, 102, SEEK_SET);
+    fputc(ch ^ 0xff, file);
+    fclose(file);
+
+    CTestCache cacheLoaded;
+    BOOST_CHECK(!flatdb.Load(cacheLoaded));
+    BOOST_CHECK(cacheLoaded.vecItems.empty());
+}
+
+BOOST_AUTO_TEST_CASE(flatdb_other_version)
+{
+    CTestVersionedCache cache;
+    cache.vecItems.assign(100, "item");
+
+    CFlatDB<CTestVersionedCache> flatdb("testcache.dat", "magicTestCache");
+    CTestVersionedCache::strVersionCurrent = "CTestVersionedCache-Version-1";
+    BOOST_CHECK(flatdb.Dump(cache));
+
+    // the file of the old version is accepted but yields an empty cache
+    CTestVersionedCache::strVersionCurrent = "CTestVersionedCache-Version-2";
+    CTestVersionedCache cacheLoaded;
+    cacheLoaded.vecItems.assign(1, "stale");
+    BOOST_CHECK(flatdb.Load(cacheLoaded));
+    BOOST_CHECK(cacheLoaded.vecItems.empty());
+
+    // and is overwritten with the new version
+    BOOST_CHECK(flatdb.Dump(cache));
+    BOOST_CHECK(flatdb.Load(cacheLoaded));
+    BOOST_CHECK(cacheLoaded.vecItems == cache.vecItems);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
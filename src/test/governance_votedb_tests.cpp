@@ -0,0 +1,123 @@
+// Copyright (c) 2021 Alterdot developers
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "base58.h"
+#include "governance.h"
+#include "governance-votedb.h"
+#include "random.h"
+
+#include "test/test_alterdot.h"
+
+#include <boost/test/unit_test.hpp>
+
+BOOST_FIXTURE_TEST_SUITE(governance_votedb_tests, TestingSetup)
+
+static CGovernanceVote MakeVote(const COutPoint& outpoint, const uint256& nParentHash, vote_signal_enum_t eSignal, vote_outcome_enum_t eOutcome, int64_t nTime)
+{
+    CGovernanceVote vote(outpoint, nParentHash, eSignal, eOutcome);
+    vote.SetTime(nTime);
+    return vote;
+}
+
+BOOST_AUTO_TEST_CASE(votefile_add_and_replace)
+{
+    uint256 nParentHash = GetRandHash();
+    COutPoint outpoint1(GetRandHash(), 0);
+    COutPoint outpoint2(GetRandHash(), 1);
+
+    CGovernanceObjectVoteFile fileVotes;
+    CGovernanceVote vote1 = MakeVote(outpoint1, nParentHash, VOTE_SIGNAL_FUNDING, VOTE_OUTCOME_YES, 1000);
+    CGovernanceVote vote2 = MakeVote(outpoint2, nParentHash, VOTE_SIGNAL_FUNDING, VOTE_OUTCOME_NO, 1000);
+    fileVotes.AddVote(vote1);
+    fileVotes.AddVote(vote2);
+    fileVotes.AddVote(vote1);
+    BOOST_CHECK_EQUAL(fileVotes.GetVoteCount(), 2);
+    BOOST_CHECK(fileVotes.HasVote(vote1.GetHash()));
+
+    // the vote body is served from the database
+    CDataStream ss(SER_NETWORK, PROTOCOL_VERSION);
+    BOOST_CHECK(fileVotes.SerializeVoteToStream(vote2.GetHash(), ss));
+    CGovernanceVote voteRead;
+    ss >> voteRead;
+    BOOST_CHECK(voteRead.GetHash() == vote2.GetHash());
+
+    // a newer vote on the same signal replaces the old one, in memory and on disk
+    CGovernanceVote vote3 = MakeVote(outpoint1, nParentHash, VOTE_SIGNAL_FUNDING, VOTE_OUTCOME_NO, 2000);
+    fileVotes.AddVote(vote3);
+    BOOST_CHECK_EQUAL(fileVotes.GetVoteCount(), 2);
+    BOOST_CHECK(!fileVotes.HasVote(vote1.GetHash()));
+    BOOST_CHECK(!pgovernancedb->ReadVote(nParentHash, vote1.GetHash()));
+    BOOST_CHECK(pgovernancedb->ReadVote(nParentHash, vote3.GetHash()));
+
+    // other signals are independent
+    CGovernanceVote vote4 = MakeVote(outpoint1, nParentHash, VOTE_SIGNAL_DELETE, VOTE_OUTCOME_YES, 3000);
+    fileVotes.AddVote(vote4);
+    BOOST_CHECK_EQUAL(fileVotes.GetVoteCount(), 3);
+    BOOST_CHECK_EQUAL(fileVotes.GetVotes().size(), 3U);
+
+    fileVotes.RemoveVotesFromMasternode(outpoint1);
+    BOOST_CHECK_EQUAL(fileVotes.GetVoteCount(), 1);
+    std::vector<CGovernanceVote> vecVotes = fileVotes.GetVotes();
+    BOOST_REQUIRE_EQUAL(vecVotes.size(), 1U);
+    BOOST_CHECK(vecVotes[0].GetHash() == vote2.GetHash());
+}
+
+BOOST_AUTO_TEST_CASE(votefile_reload)
+{
+    uint256 nParentHash = GetRandHash();
+    uint256 nOtherParentHash = GetRandHash();
+
+    CGovernanceObjectVoteFile fileVotes;
+    CGovernanceObjectVoteFile fileOtherVotes;
+    for (int i = 0; i < 10; i++) {
+        fileVotes.AddVote(MakeVote(COutPoint(GetRandHash(), i), nParentHash, VOTE_SIGNAL_FUNDING, VOTE_OUTCOME_YES, 1000 + i));
+    }
+    fileOtherVotes.AddVote(MakeVote(COutPoint(GetRandHash(), 0), nOtherParentHash, VOTE_SIGNAL_FUNDING, VOTE_OUTCOME_YES, 1000));
+
+    // rebuilding the index from the database yields the same votes
+    std::vector<CGovernanceVote> vecVotes;
+    pgovernancedb->ReadVotes(nParentHash, vecVotes);
+    BOOST_REQUIRE_EQUAL(vecVotes.size(), 10U);
+    CGovernanceObjectVoteFile fileLoaded;
+    for (const auto& vote : vecVotes) {
+        fileLoaded.LoadVote(vote);
+    }
+    BOOST_CHECK(fileLoaded.GetVoteHashes() == fileVotes.GetVoteHashes());
+
+    // erasing an object drops all of its votes but leaves other objects alone
+    BOOST_CHECK(pgovernancedb->EraseObject(nParentHash));
+    vecVotes.clear();
+    pgovernancedb->ReadVotes(nParentHash, vecVotes);
+    BOOST_CHECK(vecVotes.empty());
+    pgovernancedb->ReadVotes(nOtherParentHash, vecVotes);
+    BOOST_CHECK_EQUAL(vecVotes.size(), 1U);
+}
+
+BOOST_AUTO_TEST_CASE(trigger_expiry_written)
+{
+    CKey key;
+    key.MakeNewKey(true);
+
+    // the superblock lies far enough below the cached block height to expire on the next clean up
+    std::string strData = strprintf("{\"event_block_height\": %d, \"payment_addresses\": \"%s\", \"payment_amounts\": \"1\", \"type\": %d}",
+        -1000, CBitcoinAddress(key.GetPubKey().GetID()).ToString(), GOVERNANCE_OBJECT_TRIGGER);
+    CGovernanceObject govobj(uint256(), 1, GetAdjustedTime(), uint256(), HexStr(strData));
+    uint256 nHash = govobj.GetHash();
+    BOOST_REQUIRE(pgovernancedb->WriteObject(nHash, govobj));
+
+    governance.InitOnLoad();
+    BOOST_REQUIRE(governance.HaveObjectForHash(nHash));
+    governance.UpdateCachesAndClean();
+
+    // the expiry set by the trigger manager survives a reload
+    std::map<uint256, CGovernanceObject> mapObjects;
+    pgovernancedb->ReadObjects(mapObjects);
+    BOOST_REQUIRE(mapObjects.count(nHash));
+    BOOST_CHECK(mapObjects[nHash].IsSetExpired());
+    BOOST_CHECK(mapObjects[nHash].GetDeletionTime() != 0);
+
+    governance.Clear();
+}
+
+BOOST_AUTO_TEST_SUITE_END()
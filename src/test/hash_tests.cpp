@@ -149,4 +149,17 @@ BOOST_AUTO_TEST_CASE(siphash)
     BOOST_CHECK_EQUAL(SipHashUint256(1, 2, ss.GetHash()), 0x79751e980c2a0a35ULL);
 }
 
+BOOST_AUTO_TEST_CASE(argon2d)
+{
+    std::vector<unsigned char> in(80);
+    for (unsigned int i = 0; i < in.size(); i++)
+        in[i] = i;
+
+    // run every phase a few times, the memory arenas get reused without being wiped
+    for (int n = 0; n < 3; n++) {
+        BOOST_CHECK_EQUAL(hash_Argon2d(in.begin(), in.end(), 1).ToString(), "284a1e8bee066f37bc2a53deae0a0f30d2c6551154c72328237532955b1665ca");
+        BOOST_CHECK_EQUAL(hash_Argon2d(in.begin(), in.end(), 2).ToString(), "f41fa4e50f83a4b33607f9ba27565cdd48df5e71cf65ae736685ca4a4623a809");
+    }
+}
+
 BOOST_AUTO_TEST_SUITE_END()
@@ -580,4 +580,78 @@ BOOST_AUTO_TEST_CASE(MempoolSizeLimitTest)
     SetMockTime(0);
 }
 
+BOOST_AUTO_TEST_CASE(MempoolAddressIndexTest)
+{
+    CMempoolAddressIndex index;
+    const uint160 addr1 = uint160(std::vector<unsigned char>(20, 1));
+    const uint160 addr2 = uint160(std::vector<unsigned char>(20, 2));
+    const uint256 tx1 = GetRandHash();
+    const uint256 tx2 = GetRandHash();
+    const uint256 tx3 = GetRandHash();
+
+    std::vector<std::pair<CMempoolAddressDeltaKey, CMempoolAddressDelta> > deltas;
+    deltas.emplace_back(CMempoolAddressDeltaKey(1, addr1, tx1, 0, 0), CMempoolAddressDelta(1, 10));
+    deltas.emplace_back(CMempoolAddressDeltaKey(1, addr1, tx1, 1, 0), CMempoolAddressDelta(1, 20));
+    deltas.emplace_back(CMempoolAddressDeltaKey(1, addr2, tx1, 2, 0), CMempoolAddressDelta(1, 30));
+    index.Add(tx1, deltas);
+
+    deltas.clear();
+    deltas.emplace_back(CMempoolAddressDeltaKey(1, addr1, tx2, 0, 1), CMempoolAddressDelta(2, -10, tx1, 0));
+    index.Add(tx2, deltas);
+
+    deltas.clear();
+    deltas.emplace_back(CMempoolAddressDeltaKey(2, addr1, tx3, 0, 0), CMempoolAddressDelta(3, 5));
+    index.Add(tx3, deltas);
+
+    std::vector<std::pair<CMempoolAddressDeltaKey, CMempoolAddressDelta> > results;
+    index.Get(addr1, 1, results);
+    BOOST_CHECK_EQUAL(results.size(), 3U);
+    CAmount sum = 0;
+    for (const auto& p : results) {
+        BOOST_CHECK(p.first.addressBytes == addr1 && p.first.type == 1);
+        sum += p.second.amount;
+    }
+    BOOST_CHECK_EQUAL(sum, 20);
+
+    // the type is part of the address
+    results.clear();
+    index.Get(addr1, 2, results);
+    BOOST_CHECK_EQUAL(results.size(), 1U);
+
+    // removing a transaction unlinks its deltas from the middle of the lists
+    index.Remove(tx1);
+    results.clear();
+    index.Get(addr1, 1, results);
+    BOOST_CHECK_EQUAL(results.size(), 1U);
+    BOOST_CHECK(results[0].first.txhash == tx2);
+    results.clear();
+    index.Get(addr2, 1, results);
+    BOOST_CHECK(results.empty());
+
+    // freed nodes are reused
+    const uint256 tx4 = GetRandHash();
+    deltas.clear();
+    deltas.emplace_back(CMempoolAddressDeltaKey(1, addr2, tx4, 0, 0), CMempoolAddressDelta(4, 40));
+    deltas.emplace_back(CMempoolAddressDeltaKey(1, addr1, tx4, 1, 0), CMempoolAddressDelta(4, 50));
+    index.Add(tx4, deltas);
+    results.clear();
+    index.Get(addr1, 1, results);
+    BOOST_CHECK_EQUAL(results.size(), 2U);
+    results.clear();
+    index.Get(addr2, 1, results);
+    BOOST_CHECK_EQUAL(results.size(), 1U);
+    BOOST_CHECK_EQUAL(results[0].second.amount, 40);
+
+    index.Remove(tx2);
+    index.Remove(tx3);
+    index.Remove(tx4);
+    // unknown transactions are ignored
+    index.Remove(tx1);
+    results.clear();
+    index.Get(addr1, 1, results);
+    index.Get(addr1, 2, results);
+    index.Get(addr2, 1, results);
+    BOOST_CHECK(results.empty());
+}
+
 BOOST_AUTO_TEST_SUITE_END()
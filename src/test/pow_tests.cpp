@@ -5,6 +5,7 @@
 #include "chain.h"
 #include "chainparams.h"
 #include "pow.h"
+#include "primitives/block.h"
 #include "random.h"
 #include "util.h"
 #include "test/test_alterdot.h"
@@ -208,4 +209,35 @@ BOOST_AUTO_TEST_CASE(GetBlockProofEquivalentTime_test)
     }
 }
 
+BOOST_AUTO_TEST_CASE(blockheader_hash_memo)
+{
+    CBlockHeader header;
+    header.nVersion = 0x20000000;
+    header.hashPrevBlock = GetRandHash();
+    header.hashMerkleRoot = GetRandHash();
+    header.nTime = nTimeOfAlgorithmChange + 1;
+    header.nBits = 0x1e0ffff0;
+    header.nNonce = 42;
+
+    const uint256 hash = header.GetHash();
+    BOOST_CHECK(hash == header.ComputeHash());
+    BOOST_CHECK(hash == header.GetHash());
+
+    // copies carry the memo and still agree with a fresh computation
+    CBlock block(header);
+    BOOST_CHECK(block.GetHash() == hash);
+    BOOST_CHECK(block.GetBlockHeader().GetHash() == hash);
+
+    // mutating any header field must not return the stale hash
+    header.nNonce++;
+    BOOST_CHECK(header.GetHash() != hash);
+    BOOST_CHECK(header.GetHash() == header.ComputeHash());
+    block.hashMerkleRoot = GetRandHash();
+    BOOST_CHECK(block.GetHash() != hash);
+    BOOST_CHECK(block.GetHash() == block.ComputeHash());
+
+    header.nNonce--;
+    BOOST_CHECK(header.GetHash() == hash);
+}
+
 BOOST_AUTO_TEST_SUITE_END()
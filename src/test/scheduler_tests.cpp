@@ -2,8 +2,13 @@
 // Distributed under the MIT software license, see the accompanying
 // file COPYING or http://www.opensource.org/licenses/mit-license.php.
 
+#include "chainparams.h"
+#include "consensus/validation.h"
+#include "init.h"
 #include "random.h"
 #include "scheduler.h"
+#include "validation.h"
+#include "validationinterface.h"
 
 #include "test/test_alterdot.h"
 
@@ -13,6 +18,10 @@
 #include <boost/thread.hpp>
 #include <boost/test/unit_test.hpp>
 
+#include <atomic>
+#include <future>
+#include <vector>
+
 BOOST_AUTO_TEST_SUITE(scheduler_tests)
 
 static void microTask(CScheduler& s, boost::mutex& mutex, int& counter, int delta, boost::chrono::system_clock::time_point rescheduleTime)
@@ -114,4 +123,82 @@ BOOST_AUTO_TEST_CASE(manythreads)
     BOOST_CHECK_EQUAL(counterSum, 200);
 }
 
+BOOST_AUTO_TEST_CASE(singlethreadedschedulerclient_ordered)
+{
+    CScheduler scheduler;
+    SingleThreadedSchedulerClient queue(&scheduler);
+
+    // callbacks of two producers must run one at a time and in the order they were added
+    int tagA = 0, tagB = 0;
+    std::vector<int> vecOrder;
+    std::atomic<int> nRunning(0);
+    bool fOverlap = false;
+    for (int i = 0; i < 100; i++) {
+        queue.AddToProcessQueue([&, i] {
+            if (++nRunning != 1)
+                fOverlap = true;
+            vecOrder.push_back(i);
+            --nRunning;
+        }, i % 2 ? &tagA : &tagB);
+    }
+    BOOST_CHECK_EQUAL(queue.CallbacksPending(), 100);
+
+    // drop everything queued for one of them
+    queue.RemoveFromProcessQueue(&tagA);
+    BOOST_CHECK_EQUAL(queue.CallbacksPending(), 50);
+    BOOST_CHECK(!queue.WaitForPendingBelow(50, 1));
+
+    boost::thread_group threads;
+    for (int i = 0; i < 3; i++)
+        threads.create_thread(boost::bind(&CScheduler::serviceQueue, &scheduler));
+    BOOST_CHECK(queue.WaitForPendingBelow(1, 10000));
+    scheduler.stop(true);
+    threads.join_all();
+    queue.EmptyQueue();
+
+    BOOST_CHECK(!fOverlap);
+    BOOST_CHECK_EQUAL(vecOrder.size(), 50);
+    for (size_t i = 0; i < vecOrder.size(); i++) {
+        BOOST_CHECK_EQUAL(vecOrder[i], (int)i * 2);
+    }
+}
+
+// ActivateBestChain called from a scheduler task, like ChainLocks enforcement does, must not wait for
+// the asynchronous listeners as their queue is drained by the very same thread.
+BOOST_FIXTURE_TEST_CASE(activatebestchain_from_scheduler_with_full_queue, TestingSetup)
+{
+    CScheduler scheduler;
+    GetMainSignals().RegisterBackgroundSignalScheduler(scheduler);
+    CValidationInterface listener;
+    RegisterValidationInterface(&listener, true);
+
+    for (size_t i = 0; i <= MAX_PENDING_VALIDATION_CALLBACKS; i++) {
+        GetMainSignals().NotifyHeaderTip(chainActive.Tip(), false);
+    }
+    BOOST_CHECK(GetMainSignals().CallbacksPending() > MAX_PENDING_VALIDATION_CALLBACKS);
+
+    std::promise<bool> promise;
+    std::future<bool> future = promise.get_future();
+    scheduler.schedule([&promise] {
+        CValidationState state;
+        promise.set_value(ActivateBestChain(state, Params()));
+    }, boost::chrono::system_clock::now());
+
+    boost::thread thread(boost::bind(&CScheduler::serviceQueue, &scheduler));
+    bool fReturned = future.wait_for(std::chrono::seconds(30)) == std::future_status::ready;
+    BOOST_CHECK(fReturned);
+    if (fReturned) {
+        BOOST_CHECK(future.get());
+    } else {
+        // unblock the scheduler thread so that the test can finish
+        StartShutdown();
+    }
+
+    scheduler.stop(true);
+    thread.join();
+    UnregisterValidationInterface(&listener);
+    GetMainSignals().UnregisterBackgroundSignalScheduler();
+    BOOST_CHECK_EQUAL(GetMainSignals().CallbacksPending(), 0);
+}
+
 BOOST_AUTO_TEST_SUITE_END()
@@ -25,6 +25,8 @@
 
 #include "test/testutil.h"
 
+#include "governance-votedb.h"
+
 #include "evo/specialtx.h"
 #include "evo/deterministicmns.h"
 #include "evo/cbtx.h"
@@ -81,6 +83,8 @@ TestingSetup::TestingSetup(const std::string& chainName) : BasicTestingSetup(cha
         g_connman = std::unique_ptr<CConnman>(new CConnman(0x1337, 0x1337)); // Deterministic randomness for tests.
         connman = g_connman.get();
         pblocktree = new CBlockTreeDB(1 << 20, true);
+        pbdnsdb = new CBDNSDB(1 << 20, true, true);
+        pgovernancedb = new CGovernanceDB(1 << 20, true, true);
         pcoinsdbview = new CCoinsViewDB(1 << 23, true);
         llmq::InitLLMQSystem(*evoDb, nullptr, true);
         pcoinsTip = new CCoinsViewCache(pcoinsdbview);
@@ -93,6 +97,8 @@ TestingSetup::TestingSetup(const std::string& chainName) : BasicTestingSetup(cha
         nScriptCheckThreads = 3;
         for (int i=0; i < nScriptCheckThreads-1; i++)
             threadGroup.create_thread(&ThreadScriptCheck);
+        for (int i=0; i < nScriptCheckThreads-1; i++)
+            threadGroup.create_thread(&ThreadHeaderCheck);
         RegisterNodeSignals(GetNodeSignals());
 }
 
@@ -107,6 +113,9 @@ TestingSetup::~TestingSetup()
         llmq::DestroyLLMQSystem();
         delete pcoinsdbview;
         delete pblocktree;
+        delete pbdnsdb;
+        delete pgovernancedb;
+        pgovernancedb = nullptr;
         boost::filesystem::remove_all(pathTemp);
 }
 
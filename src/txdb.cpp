@@ -22,6 +22,7 @@ static const char DB_BLOCK_FILES = 'f';
 static const char DB_TXINDEX = 't';
 static const char DB_ADDRESSINDEX = 'a';
 static const char DB_ADDRESSUNSPENTINDEX = 'u';
+static const char DB_ADDRESSBALANCEINDEX = 'A';
 static const char DB_TIMESTAMPINDEX = 's';
 static const char DB_SPENTINDEX = 'p';
 static const char DB_BLOCK_INDEX = 'b';
@@ -266,6 +267,7 @@ bool CBlockTreeDB::WriteAddressIndex(const std::vector<std::pair<CAddressIndexKe
     CDBBatch batch(*this);
     for (std::vector<std::pair<CAddressIndexKey, CAmount> >::const_iterator it=vect.begin(); it!=vect.end(); it++)
         batch.Write(std::make_pair(DB_ADDRESSINDEX, it->first), it->second);
+    UpdateAddressBalances(batch, vect, false);
     return WriteBatch(batch);
 }
 
@@ -273,31 +275,82 @@ bool CBlockTreeDB::EraseAddressIndex(const std::vector<std::pair<CAddressIndexKe
     CDBBatch batch(*this);
     for (std::vector<std::pair<CAddressIndexKey, CAmount> >::const_iterator it=vect.begin(); it!=vect.end(); it++)
         batch.Erase(std::make_pair(DB_ADDRESSINDEX, it->first));
+    UpdateAddressBalances(batch, vect, true);
     return WriteBatch(batch);
 }
 
+void CBlockTreeDB::UpdateAddressBalances(CDBBatch& batch, const std::vector<std::pair<CAddressIndexKey, CAmount> > &vect, bool fUndo) {
+    // vect holds all entries of a block and a transaction never spans blocks, so counting distinct txids is exact
+    typedef std::pair<unsigned int, uint160> AddressKey;
+    std::map<AddressKey, CAddressBalanceValue> deltas;
+    std::set<std::pair<AddressKey, uint256> > txs;
+
+    for (const auto& p : vect) {
+        // Only count entries which actually get added or removed. Blocks can be applied again, e.g. when
+        // the block tree DB is ahead of the chainstate after an unclean shutdown, which must not count twice.
+        if (Exists(std::make_pair(DB_ADDRESSINDEX, p.first)) != fUndo) {
+            continue;
+        }
+        AddressKey addressKey(p.first.type, p.first.hashBytes);
+        CAddressBalanceValue& delta = deltas[addressKey];
+        delta.balance += p.second;
+        if (p.second > 0) {
+            delta.received += p.second;
+        }
+        if (txs.emplace(addressKey, p.first.txhash).second) {
+            delta.txCount++;
+        }
+    }
+
+    for (const auto& p : deltas) {
+        auto key = std::make_pair(DB_ADDRESSBALANCEINDEX, CAddressIndexIteratorKey(p.first.first, p.first.second));
+        CAddressBalanceValue value;
+        Read(key, value);
+        int sign = fUndo ? -1 : 1;
+        value.balance += sign * p.second.balance;
+        value.received += sign * p.second.received;
+        value.txCount += sign * p.second.txCount;
+        if (value.IsNull()) {
+            batch.Erase(key);
+        } else {
+            batch.Write(key, value);
+        }
+    }
+}
+
 bool CBlockTreeDB::ReadAddressIndex(uint160 addressHash, int type,
                                     std::vector<std::pair<CAddressIndexKey, CAmount> > &addressIndex,
-                                    int start, int end) {
+                                    int start, int end,
+                                    const CAddressIndexKey* pStartAfter, size_t nMaxCount) {
 
     std::unique_ptr<CDBIterator> pcursor(NewIterator());
 
-    if (start > 0 && end > 0) {
+    if (pStartAfter) {
+        pcursor->Seek(std::make_pair(DB_ADDRESSINDEX, *pStartAfter));
+    } else if (start > 0 && end > 0) {
         pcursor->Seek(std::make_pair(DB_ADDRESSINDEX, CAddressIndexIteratorHeightKey(type, addressHash, start)));
     } else {
         pcursor->Seek(std::make_pair(DB_ADDRESSINDEX, CAddressIndexIteratorKey(type, addressHash)));
     }
 
-    while (pcursor->Valid()) {
+    size_t nCount = 0;
+    while (pcursor->Valid() && (nMaxCount == 0 || nCount < nMaxCount)) {
         boost::this_thread::interruption_point();
         std::pair<char,CAddressIndexKey> key;
         if (pcursor->GetKey(key) && key.first == DB_ADDRESSINDEX && key.second.hashBytes == addressHash) {
             if (end > 0 && key.second.blockHeight > end) {
                 break;
             }
+            // the cursor itself was returned with the previous page
+            if (pStartAfter && key.second.blockHeight == pStartAfter->blockHeight && key.second.txindex == pStartAfter->txindex &&
+                key.second.txhash == pStartAfter->txhash && key.second.index == pStartAfter->index && key.second.spending == pStartAfter->spending) {
+                pcursor->Next();
+                continue;
+            }
             CAmount nValue;
             if (pcursor->GetValue(nValue)) {
                 addressIndex.push_back(std::make_pair(key.second, nValue));
+                nCount++;
                 pcursor->Next();
             } else {
                 return error("failed to get address index value");
@@ -310,6 +363,67 @@ bool CBlockTreeDB::ReadAddressIndex(uint160 addressHash, int type,
     return true;
 }
 
+bool CBlockTreeDB::ReadAddressBalance(uint160 addressHash, int type, CAddressBalanceValue &value) {
+    // no record means no activity
+    if (!Read(std::make_pair(DB_ADDRESSBALANCEINDEX, CAddressIndexIteratorKey(type, addressHash)), value))
+        value.SetNull();
+    return true;
+}
+
+bool CBlockTreeDB::BuildAddressBalanceIndex() {
+    std::unique_ptr<CDBIterator> pcursor(NewIterator());
+    pcursor->Seek(std::make_pair(DB_ADDRESSINDEX, CAddressIndexIteratorKey()));
+
+    CDBBatch batch(*this);
+    CAddressIndexKey lastKey;
+    CAddressBalanceValue value;
+    size_t nAddresses = 0;
+
+    // entries are sorted by address and then by transaction, so each address is summed up in one go
+    while (pcursor->Valid()) {
+        boost::this_thread::interruption_point();
+        std::pair<char,CAddressIndexKey> key;
+        if (!pcursor->GetKey(key) || key.first != DB_ADDRESSINDEX) {
+            break;
+        }
+        CAmount nValue;
+        if (!pcursor->GetValue(nValue)) {
+            return error("failed to get address index value");
+        }
+
+        bool fNewAddress = key.second.type != lastKey.type || key.second.hashBytes != lastKey.hashBytes;
+        if (fNewAddress && !value.IsNull()) {
+            batch.Write(std::make_pair(DB_ADDRESSBALANCEINDEX, CAddressIndexIteratorKey(lastKey.type, lastKey.hashBytes)), value);
+            value.SetNull();
+            if (++nAddresses % 100000 == 0) {
+                LogPrintf("%s: %d addresses done\n", __func__, nAddresses);
+            }
+            if (batch.SizeEstimate() > 16 * 1024 * 1024) {
+                if (!WriteBatch(batch))
+                    return false;
+                batch.Clear();
+            }
+        }
+
+        value.balance += nValue;
+        if (nValue > 0) {
+            value.received += nValue;
+        }
+        if (fNewAddress || key.second.txhash != lastKey.txhash) {
+            value.txCount++;
+        }
+        lastKey = key.second;
+        pcursor->Next();
+    }
+
+    if (!value.IsNull()) {
+        batch.Write(std::make_pair(DB_ADDRESSBALANCEINDEX, CAddressIndexIteratorKey(lastKey.type, lastKey.hashBytes)), value);
+        nAddresses++;
+    }
+    LogPrintf("%s: done, %d addresses\n", __func__, nAddresses);
+    return WriteBatch(batch);
+}
+
 bool CBlockTreeDB::WriteTimestampIndex(const CTimestampIndexKey &timestampIndex) {
     CDBBatch batch(*this);
     batch.Write(std::make_pair(DB_TIMESTAMPINDEX, timestampIndex), 0);
@@ -478,11 +478,97 @@ bool CTxMemPool::addUnchecked(const uint256& hash, const CTxMemPoolEntry &entry,
     return true;
 }
 
+void CMempoolAddressIndex::Add(const uint256& txhash, const std::vector<std::pair<CMempoolAddressDeltaKey, CMempoolAddressDelta> >& deltas)
+{
+    auto txIt = mapTxNodes.emplace(txhash, std::vector<uint32_t>());
+    if (!txIt.second) {
+        return;
+    }
+    std::vector<uint32_t>& txNodes = txIt.first->second;
+    txNodes.reserve(deltas.size());
+
+    for (const auto& p : deltas) {
+        auto headIt = mapAddressHeads.emplace(std::make_pair(p.first.type, p.first.addressBytes), NO_NODE).first;
+        Node node{p.first, p.second, NO_NODE, headIt->second};
+
+        uint32_t nodeIdx;
+        if (!freeNodes.empty()) {
+            nodeIdx = freeNodes.back();
+            freeNodes.pop_back();
+            nodes[nodeIdx] = node;
+        } else {
+            nodeIdx = (uint32_t)nodes.size();
+            nodes.push_back(node);
+        }
+
+        if (headIt->second != NO_NODE) {
+            nodes[headIt->second].prev = nodeIdx;
+        }
+        headIt->second = nodeIdx;
+        txNodes.push_back(nodeIdx);
+    }
+}
+
+void CMempoolAddressIndex::Remove(const uint256& txhash)
+{
+    auto txIt = mapTxNodes.find(txhash);
+    if (txIt == mapTxNodes.end()) {
+        return;
+    }
+
+    for (uint32_t nodeIdx : txIt->second) {
+        const Node& node = nodes[nodeIdx];
+        if (node.prev != NO_NODE) {
+            nodes[node.prev].next = node.next;
+        } else {
+            // first node of the address
+            auto headIt = mapAddressHeads.find(std::make_pair(node.key.type, node.key.addressBytes));
+            assert(headIt != mapAddressHeads.end());
+            if (node.next != NO_NODE) {
+                headIt->second = node.next;
+            } else {
+                mapAddressHeads.erase(headIt);
+            }
+        }
+        if (node.next != NO_NODE) {
+            nodes[node.next].prev = node.prev;
+        }
+        freeNodes.push_back(nodeIdx);
+    }
+    mapTxNodes.erase(txIt);
+
+    if (mapTxNodes.empty()) {
+        // release the pool once the mempool is drained, e.g. after a large block
+        Clear();
+    }
+}
+
+void CMempoolAddressIndex::Get(const uint160& addressHash, int type, std::vector<std::pair<CMempoolAddressDeltaKey, CMempoolAddressDelta> >& results) const
+{
+    auto headIt = mapAddressHeads.find(std::make_pair(type, addressHash));
+    if (headIt == mapAddressHeads.end()) {
+        return;
+    }
+    for (uint32_t nodeIdx = headIt->second; nodeIdx != NO_NODE; nodeIdx = nodes[nodeIdx].next) {
+        results.emplace_back(nodes[nodeIdx].key, nodes[nodeIdx].delta);
+    }
+}
+
+void CMempoolAddressIndex::Clear()
+{
+    nodes.clear();
+    nodes.shrink_to_fit();
+    freeNodes.clear();
+    freeNodes.shrink_to_fit();
+    mapAddressHeads.clear();
+    mapTxNodes.clear();
+}
+
 void CTxMemPool::addAddressIndex(const CTxMemPoolEntry &entry, const CCoinsViewCache &view)
 {
     LOCK(cs);
     const CTransaction& tx = entry.GetTx();
-    std::vector<CMempoolAddressDeltaKey> inserted;
+    std::vector<std::pair<CMempoolAddressDeltaKey, CMempoolAddressDelta> > deltas;
 
     uint256 txhash = tx.GetHash();
     for (unsigned int j = 0; j < tx.vin.size(); j++) {
@@ -493,20 +579,17 @@ void CTxMemPool::addAddressIndex(const CTxMemPoolEntry &entry, const CCoinsViewC
             std::vector<unsigned char> hashBytes(prevout.scriptPubKey.begin()+2, prevout.scriptPubKey.begin()+22);
             CMempoolAddressDeltaKey key(2, uint160(hashBytes), txhash, j, 1);
             CMempoolAddressDelta delta(entry.GetTime(), prevout.nValue * -1, input.prevout.hash, input.prevout.n);
-            mapAddress.insert(std::make_pair(key, delta));
-            inserted.push_back(key);
+            deltas.push_back(std::make_pair(key, delta));
         } else if (prevout.scriptPubKey.IsPayToPublicKeyHash()) {
             std::vector<unsigned char> hashBytes(prevout.scriptPubKey.begin()+3, prevout.scriptPubKey.begin()+23);
             CMempoolAddressDeltaKey key(1, uint160(hashBytes), txhash, j, 1);
             CMempoolAddressDelta delta(entry.GetTime(), prevout.nValue * -1, input.prevout.hash, input.prevout.n);
-            mapAddress.insert(std::make_pair(key, delta));
-            inserted.push_back(key);
+            deltas.push_back(std::make_pair(key, delta));
         } else if (prevout.scriptPubKey.IsPayToPublicKey()) {
             uint160 hashBytes(Hash160(prevout.scriptPubKey.begin()+1, prevout.scriptPubKey.end()-1));
             CMempoolAddressDeltaKey key(1, hashBytes, txhash, j, 1);
             CMempoolAddressDelta delta(entry.GetTime(), prevout.nValue * -1, input.prevout.hash, input.prevout.n);
-            mapAddress.insert(std::make_pair(key, delta));
-            inserted.push_back(key);
+            deltas.push_back(std::make_pair(key, delta));
         }
     }
 
@@ -515,24 +598,19 @@ void CTxMemPool::addAddressIndex(const CTxMemPoolEntry &entry, const CCoinsViewC
         if (out.scriptPubKey.IsPayToScriptHash()) {
             std::vector<unsigned char> hashBytes(out.scriptPubKey.begin()+2, out.scriptPubKey.begin()+22);
             CMempoolAddressDeltaKey key(2, uint160(hashBytes), txhash, k, 0);
-            mapAddress.insert(std::make_pair(key, CMempoolAddressDelta(entry.GetTime(), out.nValue)));
-            inserted.push_back(key);
+            deltas.push_back(std::make_pair(key, CMempoolAddressDelta(entry.GetTime(), out.nValue)));
         } else if (out.scriptPubKey.IsPayToPublicKeyHash()) {
             std::vector<unsigned char> hashBytes(out.scriptPubKey.begin()+3, out.scriptPubKey.begin()+23);
-            std::pair<addressDeltaMap::iterator,bool> ret;
             CMempoolAddressDeltaKey key(1, uint160(hashBytes), txhash, k, 0);
-            mapAddress.insert(std::make_pair(key, CMempoolAddressDelta(entry.GetTime(), out.nValue)));
-            inserted.push_back(key);
+            deltas.push_back(std::make_pair(key, CMempoolAddressDelta(entry.GetTime(), out.nValue)));
         } else if (out.scriptPubKey.IsPayToPublicKey()) {
             uint160 hashBytes(Hash160(out.scriptPubKey.begin()+1, out.scriptPubKey.end()-1));
-            std::pair<addressDeltaMap::iterator,bool> ret;
             CMempoolAddressDeltaKey key(1, hashBytes, txhash, k, 0);
-            mapAddress.insert(std::make_pair(key, CMempoolAddressDelta(entry.GetTime(), out.nValue)));
-            inserted.push_back(key);
+            deltas.push_back(std::make_pair(key, CMempoolAddressDelta(entry.GetTime(), out.nValue)));
         }
     }
 
-    mapAddressInserted.insert(std::make_pair(txhash, inserted));
+    addressIndex.Add(txhash, deltas);
 }
 
 bool CTxMemPool::getAddressIndex(std::vector<std::pair<uint160, int> > &addresses,
@@ -540,11 +618,7 @@ bool CTxMemPool::getAddressIndex(std::vector<std::pair<uint160, int> > &addresse
 {
     LOCK(cs);
     for (std::vector<std::pair<uint160, int> >::iterator it = addresses.begin(); it != addresses.end(); it++) {
-        addressDeltaMap::iterator ait = mapAddress.lower_bound(CMempoolAddressDeltaKey((*it).second, (*it).first));
-        while (ait != mapAddress.end() && (*ait).first.addressBytes == (*it).first && (*ait).first.type == (*it).second) {
-            results.push_back(*ait);
-            ait++;
-        }
+        addressIndex.Get((*it).first, (*it).second, results);
     }
     return true;
 }
@@ -552,16 +626,7 @@ bool CTxMemPool::getAddressIndex(std::vector<std::pair<uint160, int> > &addresse
 bool CTxMemPool::removeAddressIndex(const uint256 txhash)
 {
     LOCK(cs);
-    addressDeltaMapInserted::iterator it = mapAddressInserted.find(txhash);
-
-    if (it != mapAddressInserted.end()) {
-        std::vector<CMempoolAddressDeltaKey> keys = (*it).second;
-        for (std::vector<CMempoolAddressDeltaKey>::iterator mit = keys.begin(); mit != keys.end(); mit++) {
-            mapAddress.erase(*mit);
-        }
-        mapAddressInserted.erase(it);
-    }
-
+    addressIndex.Remove(txhash);
     return true;
 }
 
@@ -1000,6 +1065,9 @@ void CTxMemPool::_clear()
     mapNextTx.clear();
     mapProTxAddresses.clear();
     mapProTxPubKeyIDs.clear();
+    addressIndex.Clear();
+    mapSpent.clear();
+    mapSpentInserted.clear();
     totalTxSize = 0;
     cachedInnerUsage = 0;
     lastRollingFeeUpdate = GetTime();
@@ -1615,3 +1683,7 @@ bool CTxMemPool::TransactionWithinChainLimit(const uint256& txid, size_t chainLi
 }
 
 SaltedTxidHasher::SaltedTxidHasher() : k0(GetRand(std::numeric_limits<uint64_t>::max())), k1(GetRand(std::numeric_limits<uint64_t>::max())) {}
+
+SaltedAddressKeyHasher::SaltedAddressKeyHasher() : k0(GetRand(std::numeric_limits<uint64_t>::max())), k1(GetRand(std::numeric_limits<uint64_t>::max())) {}
+
+SaltedSpentIndexKeyHasher::SaltedSpentIndexKeyHasher() : k0(GetRand(std::numeric_limits<uint64_t>::max())), k1(GetRand(std::numeric_limits<uint64_t>::max())) {}
@@ -6,9 +6,11 @@
 #ifndef BITCOIN_TXMEMPOOL_H
 #define BITCOIN_TXMEMPOOL_H
 
+#include <limits>
 #include <memory>
 #include <set>
 #include <map>
+#include <unordered_map>
 #include <vector>
 #include <utility>
 #include <string>
@@ -347,6 +349,66 @@ public:
     }
 };
 
+class SaltedAddressKeyHasher
+{
+private:
+    /** Salt */
+    const uint64_t k0, k1;
+
+public:
+    SaltedAddressKeyHasher();
+
+    size_t operator()(const std::pair<int, uint160>& address) const {
+        return CSipHasher(k0, k1).Write(address.second.begin(), address.second.size()).Write((uint64_t)address.first).Finalize();
+    }
+};
+
+class SaltedSpentIndexKeyHasher
+{
+private:
+    /** Salt */
+    const uint64_t k0, k1;
+
+public:
+    SaltedSpentIndexKeyHasher();
+
+    size_t operator()(const CSpentIndexKey& key) const {
+        return SipHashUint256Extra(k0, k1, key.txid, key.outputIndex);
+    }
+};
+
+/**
+ * Address deltas of the mempool, bucketed by address.
+ *
+ * Each address links its deltas into a list, so a lookup only touches the deltas of that address and adding or
+ * removing a transaction doesn't rebalance a tree per input and output. The list nodes are allocated from a pool
+ * and reused once their transaction leaves the mempool.
+ */
+class CMempoolAddressIndex
+{
+private:
+    static const uint32_t NO_NODE = std::numeric_limits<uint32_t>::max();
+
+    struct Node {
+        CMempoolAddressDeltaKey key;
+        CMempoolAddressDelta delta;
+        uint32_t prev;
+        uint32_t next;
+    };
+
+    std::vector<Node> nodes;
+    std::vector<uint32_t> freeNodes;
+    // (type, address hash) -> first node of the address
+    std::unordered_map<std::pair<int, uint160>, uint32_t, SaltedAddressKeyHasher> mapAddressHeads;
+    std::unordered_map<uint256, std::vector<uint32_t>, SaltedTxidHasher> mapTxNodes;
+
+public:
+    void Add(const uint256& txhash, const std::vector<std::pair<CMempoolAddressDeltaKey, CMempoolAddressDelta> >& deltas);
+    void Remove(const uint256& txhash);
+    void Get(const uint160& addressHash, int type, std::vector<std::pair<CMempoolAddressDeltaKey, CMempoolAddressDelta> >& results) const;
+    void Clear();
+};
+
 /**
  * CTxMemPool stores valid-according-to-the-current-best-chain transactions
  * that may be included in the next block.
@@ -504,16 +566,12 @@ private:
     typedef std::map<txiter, TxLinks, CompareIteratorByHash> txlinksMap;
     txlinksMap mapLinks;
 
-    typedef std::map<CMempoolAddressDeltaKey, CMempoolAddressDelta, CMempoolAddressDeltaKeyCompare> addressDeltaMap;
-    addressDeltaMap mapAddress;
-
-    typedef std::map<uint256, std::vector<CMempoolAddressDeltaKey> > addressDeltaMapInserted;
-    addressDeltaMapInserted mapAddressInserted;
+    CMempoolAddressIndex addressIndex;
 
-    typedef std::map<CSpentIndexKey, CSpentIndexValue, CSpentIndexKeyCompare> mapSpentIndex;
+    typedef std::unordered_map<CSpentIndexKey, CSpentIndexValue, SaltedSpentIndexKeyHasher> mapSpentIndex;
     mapSpentIndex mapSpent;
 
-    typedef std::map<uint256, std::vector<CSpentIndexKey> > mapSpentIndexInserted;
+    typedef std::unordered_map<uint256, std::vector<CSpentIndexKey>, SaltedTxidHasher> mapSpentIndexInserted;
     mapSpentIndexInserted mapSpentInserted;
 
     std::multimap<uint256, uint256> mapProTxRefs; // proTxHash -> transaction (all TXs that refer to an existing proTx)
@@ -51,7 +51,10 @@
 #include "llmq/quorums_instantsend.h"
 #include "llmq/quorums_chainlocks.h"
 
+#include "ctpl.h"
+
 #include <atomic>
+#include <deque>
 #include <sstream>
 #include <chrono>
 
@@ -81,6 +84,8 @@ CConditionVariable cvBlockChange;
 int nScriptCheckThreads = 0;
 std::atomic_bool fImporting(false);
 bool fReindexingBdns = false;
+std::atomic<int> nBdnsReindexHeight(-1);
+std::atomic<int> nBdnsReindexTargetHeight(-1);
 bool fReindex = false;
 bool fTxIndex = true;
 bool fAddressIndex = false;
@@ -966,17 +971,29 @@ bool GetSpentIndex(CSpentIndexKey &key, CSpentIndexValue &value)
 }
 
 bool GetAddressIndex(uint160 addressHash, int type,
-                     std::vector<std::pair<CAddressIndexKey, CAmount> > &addressIndex, int start, int end)
+                     std::vector<std::pair<CAddressIndexKey, CAmount> > &addressIndex, int start, int end,
+                     const CAddressIndexKey* pStartAfter, size_t nMaxCount)
 {
     if (!fAddressIndex)
         return error("address index not enabled");
 
-    if (!pblocktree->ReadAddressIndex(addressHash, type, addressIndex, start, end))
+    if (!pblocktree->ReadAddressIndex(addressHash, type, addressIndex, start, end, pStartAfter, nMaxCount))
         return error("unable to get txids for address");
 
     return true;
 }
 
+bool GetAddressBalance(uint160 addressHash, int type, CAddressBalanceValue &value)
+{
+    if (!fAddressIndex)
+        return error("address index not enabled");
+
+    if (!pblocktree->ReadAddressBalance(addressHash, type, value))
+        return error("unable to get balance for address");
+
+    return true;
+}
+
 bool GetAddressUnspent(uint160 addressHash, int type,
                        std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue> > &unspentOutputs)
 {
@@ -1069,9 +1086,7 @@ bool GetTransaction(const uint256 &hash, CTransactionRef &txOut, const Consensus
 {
     CBlockIndex *pindexSlow = NULL;
 
-    LOCK(cs_main);
-    
-    // look it up using the TxIndex
+    // look it up using the TxIndex, reading it and the block files doesn't require cs_main which lets the BDNS reindex resolve inputs in parallel
     if (fTxIndex) {
         CDiskTxPos postx;
         if (pblocktree->ReadTxIndex(hash, postx)) {
@@ -1099,6 +1114,7 @@ bool GetTransaction(const uint256 &hash, CTransactionRef &txOut, const Consensus
     // TODO_ADOT_FUTURE might remove the no TxIndex option due to being too expensive, no TxIndex, no BlockchainDNS
     // no TxIndex so we must locate the transaction with a slower process
     // use coin database to locate block that contains transaction, and scan it
+    LOCK(cs_main);
     const Coin& coin = AccessByTxid(*pcoinsTip, hash);
     if (!coin.IsSpent()) pindexSlow = chainActive[coin.nHeight];
 
@@ -1173,11 +1189,24 @@ bool ReadBlockFromDisk(CBlock& block, const CDiskBlockPos& pos, const Consensus:
 
 bool ReadBlockFromDisk(CBlock& block, const CBlockIndex* pindex, const Consensus::Params& consensusParams)
 {
-    if (!ReadBlockFromDisk(block, pindex->GetBlockPos(), consensusParams))
+    // The proof of work of indexed blocks was verified when they were accepted, so instead of
+    // running Argon2d twice per read, check that the stored header is the one the index describes
+    // and that the transactions still hash to its merkle root. Such a header hashes to the index
+    // hash, which is then memoized in the block for later GetHash() calls.
+    if (!ReadBlockFromDisk(block, pindex->GetBlockPos(), consensusParams, false))
         return false;
-    if (block.GetHash() != pindex->GetBlockHash())
-        return error("ReadBlockFromDisk(CBlock&, CBlockIndex*): GetHash() doesn't match index for %s at %s",
+
+    const CBlockHeader header = pindex->GetBlockHeader();
+    if (block.nVersion != header.nVersion || block.hashPrevBlock != header.hashPrevBlock ||
+            block.hashMerkleRoot != header.hashMerkleRoot || block.nTime != header.nTime ||
+            block.nBits != header.nBits || block.nNonce != header.nNonce)
+        return error("ReadBlockFromDisk(CBlock&, CBlockIndex*): header doesn't match index for %s at %s",
+                pindex->ToString(), pindex->GetBlockPos().ToString());
+    if (BlockMerkleRoot(block) != block.hashMerkleRoot)
+        return error("ReadBlockFromDisk(CBlock&, CBlockIndex*): merkle root mismatch for %s at %s",
                 pindex->ToString(), pindex->GetBlockPos().ToString());
+
+    block.MemoizeHash(pindex->GetBlockHash());
     return true;
 }
 
@@ -1700,8 +1729,9 @@ int ApplyTxInUndo(Coin&& undo, CCoinsViewCache& view, const COutPoint& out)
 }
 
 /** Undo the effects of this block (with given index) on the UTXO set represented by coins.
- *  When UNCLEAN or FAILED is returned, view is left in an indeterminate state. */
-static DisconnectResult DisconnectBlock(const CBlock& block, CValidationState& state, const CBlockIndex* pindex, CCoinsViewCache& view)
+ *  When UNCLEAN or FAILED is returned, view is left in an indeterminate state.
+ *  With fJustCheck, the block tree indexes (address and spent index) are left untouched. */
+static DisconnectResult DisconnectBlock(const CBlock& block, CValidationState& state, const CBlockIndex* pindex, CCoinsViewCache& view, bool fJustCheck = false)
 {
     assert(pindex->GetBlockHash() == view.GetBestBlock());
 
@@ -1839,8 +1869,12 @@ static DisconnectResult DisconnectBlock(const CBlock& block, CValidationState& s
 
                     } else if (prevout.scriptPubKey.IsPayToPublicKey()) {
                         uint160 hashBytes(Hash160(prevout.scriptPubKey.begin()+1, prevout.scriptPubKey.end()-1));
-                        addressIndex.push_back(std::make_pair(CAddressIndexKey(1, hashBytes, pindex->nHeight, i, hash, j, false), prevout.nValue));
-                        addressUnspentIndex.push_back(std::make_pair(CAddressUnspentKey(1, hashBytes, hash, j), CAddressUnspentValue()));
+
+                        // undo spending activity
+                        addressIndex.push_back(std::make_pair(CAddressIndexKey(1, hashBytes, pindex->nHeight, i, hash, j, true), prevout.nValue * -1));
+
+                        // restore unspent index
+                        addressUnspentIndex.push_back(std::make_pair(CAddressUnspentKey(1, hashBytes, input.prevout.hash, input.prevout.n), CAddressUnspentValue(prevout.nValue, prevout.scriptPubKey, undoHeight)));
                     } else {
                         continue;
                     }
@@ -1854,14 +1888,14 @@ static DisconnectResult DisconnectBlock(const CBlock& block, CValidationState& s
     // move best block pointer to prevout block
     view.SetBestBlock(pindex->pprev->GetBlockHash());
 
-    if (fSpentIndex) {
+    if (fSpentIndex && !fJustCheck) {
         if (!pblocktree->UpdateSpentIndex(spentIndex)) {
             AbortNode("Failed to delete spent index");
             return DISCONNECT_FAILED;
         }
     }
 
-    if (fAddressIndex) {
+    if (fAddressIndex && !fJustCheck) {
         if (!pblocktree->EraseAddressIndex(addressIndex)) {
             AbortNode(state, "Failed to delete address index");
             return DISCONNECT_FAILED;
@@ -1914,6 +1948,17 @@ void ThreadScriptCheck() {
     scriptcheckqueue.Thread();
 }
 
+static CCheckQueue<CHeaderPoWCheck> headercheckqueue(16);
+
+void ThreadHeaderCheck() {
+    RenameThread("alterdot-headerch");
+    headercheckqueue.Thread();
+}
+
+bool CHeaderPoWCheck::operator()() {
+    return CheckProofOfWork(pheader->GetHash(), pheader->nBits, *pconsensusParams);
+}
+
 // Protected by cs_main
 VersionBitsCache versionbitscache;
 
@@ -2811,25 +2856,27 @@ bool DisconnectBlocks(int blocks)
 
 void ReprocessBlocks(int nBlocks)
 {
-    LOCK(cs_main);
+    {
+        LOCK(cs_main);
 
-    std::map<uint256, int64_t>::iterator it = mapRejectedBlocks.begin();
-    while(it != mapRejectedBlocks.end()){
-        //use a window twice as large as is usual for the nBlocks we want to reset
-        if((*it).second  > GetTime() - (nBlocks*60*5)) {
-            BlockMap::iterator mi = mapBlockIndex.find((*it).first);
-            if (mi != mapBlockIndex.end() && (*mi).second) {
+        std::map<uint256, int64_t>::iterator it = mapRejectedBlocks.begin();
+        while(it != mapRejectedBlocks.end()){
+            //use a window twice as large as is usual for the nBlocks we want to reset
+            if((*it).second  > GetTime() - (nBlocks*60*5)) {
+                BlockMap::iterator mi = mapBlockIndex.find((*it).first);
+                if (mi != mapBlockIndex.end() && (*mi).second) {
 
-                CBlockIndex* pindex = (*mi).second;
-                LogPrintf("ReprocessBlocks -- %s\n", (*it).first.ToString());
+                    CBlockIndex* pindex = (*mi).second;
+                    LogPrintf("ReprocessBlocks -- %s\n", (*it).first.ToString());
 
-                ResetBlockFailureFlags(pindex);
+                    ResetBlockFailureFlags(pindex);
+                }
             }
+            ++it;
         }
-        ++it;
-    }
 
-    DisconnectBlocks(nBlocks);
+        DisconnectBlocks(nBlocks);
+    } // release cs_main before calling ActivateBestChain
 
     CValidationState state;
     ActivateBestChain(state, Params());
@@ -3029,6 +3076,13 @@ bool ActivateBestChain(CValidationState &state, const CChainParams& chainparams,
         if (ShutdownRequested())
             break;
 
+        // Let asynchronous listeners catch up before connecting more blocks so that their queue stays
+        // bounded. This must happen without holding cs_main as their callbacks may need it. Callers on
+        // the scheduler thread (e.g. ChainLocks enforcement) don't wait as that thread drains the queue.
+        while (!GetMainSignals().WaitForBackgroundCallbacksBelow(MAX_PENDING_VALIDATION_CALLBACKS, 100) && !ShutdownRequested()) {
+            boost::this_thread::interruption_point();
+        }
+
         const CBlockIndex *pindexFork;
         ConnectTrace connectTrace;
         bool fInitialDownload;
@@ -3643,12 +3697,19 @@ bool ExtractBdnsBanFromScript(const CScript& scriptPubKey, std::string& bdnsName
     return true;
 }
 
-void ProcessPossibleBdnsIpfsRegistration(const CScript& scriptPubKey, const uint256& regTxid) {
+void ProcessPossibleBdnsIpfsRegistration(const CScript& scriptPubKey, const uint256& regTxid, const int& nExpiryHeight) {
     std::string bdnsName, content;
 
     if (!ExtractBdnsIpfsFromScript(scriptPubKey, bdnsName, content))
         return;
 
+    // every paid registration schedules the name to expire, even one rejected as a duplicate, so the records match
+    // the ones of nodes that still find expiring names by scanning the block from a year earlier
+    if (!pbdnsdb->WriteBDNSExpiry(bdnsName, nExpiryHeight)) {
+        pbdnsdb->WriteCorruptionState(true);
+        LogPrint("bdns", "BlockchainDNS -- %s: failed to schedule the expiry of domain %s\n", __func__, bdnsName);
+    }
+
     if (pbdnsdb->HasBDNSRecord(bdnsName)) {
         LogPrint("bdns", "BlockchainDNS -- %s: domain %s already exists\n", __func__, bdnsName);
         return;
@@ -3710,18 +3771,33 @@ void ProcessPossibleBdnsIpfsBan(const CScript& scriptPubKey) {
     if (!ExtractBdnsBanFromScript(scriptPubKey, bdnsName))
         return;
 
-    pbdnsdb->EraseBDNSRecord(bdnsName);
-
-    if (pbdnsdb->HasBDNSRecord(bdnsName)) {
+    if (!pbdnsdb->EraseBDNSRecord(bdnsName)) {
         pbdnsdb->WriteCorruptionState(true);
-        LogPrint("bdns", "BlockchainDNS -- %s: banned registration under domain name %s still exists\n", __func__, bdnsName);
+        LogPrint("bdns", "BlockchainDNS -- %s: failed to delete banned registration under domain name %s\n", __func__, bdnsName);
+    }
+}
+
+static bool IsPossibleBdnsTransaction(const CTransaction& tx)
+{
+    return tx.nType == TRANSACTION_NORMAL && tx.vin.size() == 1 && tx.vout.size() == 2 && tx.vout[0].scriptPubKey.Find(OP_RETURN);
+}
+
+static bool GetBdnsInputTransaction(const uint256& hash, CTransactionRef& txOut, const Consensus::Params& consensusParams, const CBlock& block, const BdnsInputMap* pmapInputs)
+{
+    if (pmapInputs) {
+        auto it = pmapInputs->find(hash);
+        if (it != pmapInputs->end()) {
+            txOut = it->second;
+            return true;
+        }
     }
+
+    return GetTransaction(hash, txOut, consensusParams, block);
 }
 
-void ProcessBdnsTransactions(const CBlock& block, const CBlockIndex& pindex, const Consensus::Params& consensusParams)
+void ProcessBdnsTransactions(const CBlock& block, const CBlockIndex& pindex, const Consensus::Params& consensusParams, const BdnsInputMap* pmapInputs)
 {
-    if (!pbdnsdb->SetHeight(pindex.nHeight))
-        LogPrintf("BlockchainDNS -- %s: failed to set the BDNS height\n", __func__);
+    pbdnsdb->BeginBlock(pindex.nHeight);
 
     CTransactionRef inputTx;
     uint256 txHash;
@@ -3729,21 +3805,21 @@ void ProcessBdnsTransactions(const CBlock& block, const CBlockIndex& pindex, con
     for (unsigned int i = 1; i < block.vtx.size(); i++) {
         const CTransaction& tx = *block.vtx[i];
 
-        if (tx.nType == TRANSACTION_NORMAL && tx.vin.size() == 1 && tx.vout.size() == 2 && tx.vout[0].scriptPubKey.Find(OP_RETURN)) {
+        if (IsPossibleBdnsTransaction(tx)) {
             if (tx.vout[0].nValue == 10 * CENT) {
                 txHash = tx.vin[0].prevout.hash;
 
-                if (!GetTransaction(txHash, inputTx, consensusParams, block)) { // used to check that miners are paid enough
+                if (!GetBdnsInputTransaction(txHash, inputTx, consensusParams, block, pmapInputs)) { // used to check that miners are paid enough
                     pbdnsdb->WriteCorruptionState(true);
                     LogPrint("bdns", "BlockchainDNS -- %s: Register -- No information available about transaction %s\n", __func__, txHash.ToString());
                 } else if ((*inputTx).vout[tx.vin[0].prevout.n].nValue >= tx.vout[1].nValue + 20 * CENT)
-                    ProcessPossibleBdnsIpfsRegistration(tx.vout[0].scriptPubKey, tx.GetHash());
+                    ProcessPossibleBdnsIpfsRegistration(tx.vout[0].scriptPubKey, tx.GetHash(), pindex.nHeight + consensusParams.nBlocksPerYear);
                 else
                     LogPrint("bdns", "BlockchainDNS -- %s: Register -- Miners were not paid enough for the BDNS-IPFS registration in transaction %s\n", __func__, tx.GetHash().ToString());
             } else if (tx.vout[0].nValue == 0.5 * CENT) {
                 txHash = tx.vin[0].prevout.hash;
 
-                if (!GetTransaction(txHash, inputTx, consensusParams, block)) {
+                if (!GetBdnsInputTransaction(txHash, inputTx, consensusParams, block, pmapInputs)) {
                     pbdnsdb->WriteCorruptionState(true);
                     LogPrint("bdns", "BlockchainDNS -- %s: Update -- No information available about transaction %s\n", __func__, txHash.ToString());
                 } else if ((*inputTx).vout[tx.vin[0].prevout.n].nValue >= tx.vout[1].nValue + 1 * CENT) {
@@ -3753,7 +3829,7 @@ void ProcessBdnsTransactions(const CBlock& block, const CBlockIndex& pindex, con
             } else if (tx.vout[0].nValue == 0.25 * CENT) {
                 txHash = tx.vin[0].prevout.hash;
 
-                if (!GetTransaction(txHash, inputTx, consensusParams, block)) {
+                if (!GetBdnsInputTransaction(txHash, inputTx, consensusParams, block, pmapInputs)) {
                     pbdnsdb->WriteCorruptionState(true);
                     LogPrint("bdns", "BlockchainDNS -- %s: Ban -- No information available about transaction %s\n", __func__, txHash.ToString());
                 } else if ((*inputTx).vout[tx.vin[0].prevout.n].nValue >= tx.vout[1].nValue + 0.5 * CENT) {
@@ -3768,55 +3844,31 @@ void ProcessBdnsTransactions(const CBlock& block, const CBlockIndex& pindex, con
         }
     }
 
-    ProcessExpiredBdnsRecords(pindex.GetAncestor(pindex.nHeight - consensusParams.nBlocksPerYear), consensusParams);
+    ProcessExpiredBdnsRecords();
+
+    // all record changes of the block and their undo data get written at once
+    if (!pbdnsdb->CommitBlock())
+        LogPrintf("BlockchainDNS -- %s: failed to commit the BDNS changes of block %s\n", __func__, pindex.GetBlockHash().ToString());
 }
 
-void ProcessExpiredBdnsRecords(const CBlockIndex* pblockindex, const Consensus::Params& consensusParams) {
-    CBlock block;
+void ProcessExpiredBdnsRecords() {
+    std::vector<std::string> vExpiredNames;
 
-    if (!ReadBlockFromDisk(block, pblockindex->GetBlockPos(), consensusParams)) {
+    if (!pbdnsdb->ExpireBDNSRecords(vExpiredNames)) {
         pbdnsdb->WriteCorruptionState(true);
-        LogPrint("bdns", "BlockchainDNS -- %s: failed to read block from disk\n", __func__);
+        LogPrint("bdns", "BlockchainDNS -- %s: failed to delete expired registrations\n", __func__);
         return;
     }
 
-    CTransactionRef inputTx;
-    uint256 txHash;
-    std::string bdnsName, content;
-
-    for (unsigned int i = 1; i < block.vtx.size(); i++) {
-        const CTransaction& tx = *block.vtx[i];
-
-        if (tx.nType == TRANSACTION_NORMAL && tx.vin.size() == 1 && tx.vout.size() == 2 && tx.vout[0].scriptPubKey.Find(OP_RETURN) && tx.vout[0].nValue == 10 * CENT) {
-            txHash = tx.vin[0].prevout.hash;
-
-            if (!GetTransaction(txHash, inputTx, consensusParams, block)) { // used to check that miners are paid enough
-                pbdnsdb->WriteCorruptionState(true);
-                LogPrint("bdns", "BlockchainDNS -- %s: No information available about transaction %s\n",  __func__, txHash.ToString());
-            } else if ((*inputTx).vout[tx.vin[0].prevout.n].nValue >= tx.vout[1].nValue + 20 * CENT) {
-                if (!ExtractBdnsIpfsFromScript(tx.vout[0].scriptPubKey, bdnsName, content))
-                    continue;
-
-                if (pbdnsdb->EraseBDNSRecord(bdnsName))
-                    LogPrint("bdns", "BlockchainDNS -- %s: successfully deleted expired registration under domain name %s\n", __func__, bdnsName);
-                else
-                    LogPrint("bdns", "BlockchainDNS -- %s: failed to delete expired registration under domain name %s\n", __func__, bdnsName);
-
-                if (pbdnsdb->HasBDNSRecord(bdnsName)) {
-                    pbdnsdb->WriteCorruptionState(true);
-                    LogPrint("bdns", "BlockchainDNS -- %s: expired registration under domain name %s still exists\n", __func__, bdnsName);
-                }
-            }
-        }
-    }
+    for (const auto& bdnsName : vExpiredNames)
+        LogPrint("bdns", "BlockchainDNS -- %s: successfully deleted expired registration under domain name %s\n", __func__, bdnsName);
 }
 
 bool ProcessBdnsActiveHeight(const int& nHeight, const Consensus::Params& consensusParams) {
     CBlockIndex* pindex = chainActive[nHeight];
     CBlock block;
 
-    // TODO_ADOT_FUTURE checking the header is a very expensive operation in ReadBlockFromDisk due to Argon2d16k
-    if (!ReadBlockFromDisk(block, pindex->GetBlockPos(), consensusParams)) {
+    if (!ReadBlockFromDisk(block, pindex, consensusParams)) {
         pbdnsdb->WriteCorruptionState(true);
         LogPrint("bdns", "BlockchainDNS -- %s: failed to read block from disk\n", __func__);
         return false;
@@ -3827,6 +3879,46 @@ bool ProcessBdnsActiveHeight(const int& nHeight, const Consensus::Params& consen
     return !pbdnsdb->PossibleCorruption();
 }
 
+/** A block of the BDNS reindex together with the inputs of its possible BDNS transactions */
+struct CBdnsReindexBlock
+{
+    CBlock block;
+    BdnsInputMap mapInputs;
+    bool fRead = false;
+};
+
+static std::shared_ptr<CBdnsReindexBlock> PrepareBdnsReindexBlock(const CBlockIndex* pindex, const Consensus::Params& consensusParams)
+{
+    auto prepared = std::make_shared<CBdnsReindexBlock>();
+
+    if (!ReadBlockFromDisk(prepared->block, pindex, consensusParams))
+        return prepared;
+
+    prepared->fRead = true;
+
+    CTransactionRef inputTx;
+
+    for (unsigned int i = 1; i < prepared->block.vtx.size(); i++) {
+        const CTransaction& tx = *prepared->block.vtx[i];
+
+        if (!IsPossibleBdnsTransaction(tx) || prepared->mapInputs.count(tx.vin[0].prevout.hash))
+            continue;
+
+        // failed lookups are repeated by the writer which flags the corruption
+        if (GetTransaction(tx.vin[0].prevout.hash, inputTx, consensusParams, prepared->block))
+            prepared->mapInputs.emplace(tx.vin[0].prevout.hash, inputTx);
+    }
+
+    return prepared;
+}
+
+static void StopReindexingBdns() {
+    fReindexingBdns = false;
+    nBdnsReindexHeight = -1;
+    nBdnsReindexTargetHeight = -1;
+    pbdnsdb->WriteReindexing(false);
+}
+
 void ReindexBdnsRecords() {
     if (!pbdnsdb->AwaitsReindexing())
         return;
@@ -3837,8 +3929,7 @@ void ReindexBdnsRecords() {
         LOCK(cs_main);
         // if the initial database cleanup fails then we stop reindexing and the corruption flag gets set to true
         if (!pbdnsdb->CleanDatabase()) {
-            fReindexingBdns = false;
-            pbdnsdb->WriteReindexing(false);
+            StopReindexingBdns();
             pbdnsdb->WriteCorruptionState(true);
             return;
         } else
@@ -3848,28 +3939,75 @@ void ReindexBdnsRecords() {
     const Consensus::Params& consensusParams = Params().GetConsensus();
     CBlockIndex* lastProcessedIndex;
     int lastProcessedHeight;
+    std::vector<const CBlockIndex*> vIndexes;
 
     {
         LOCK(cs_main);
         if (chainActive.Height() < consensusParams.nHardForkEight) {
-            fReindexingBdns = false;
-            pbdnsdb->WriteReindexing(false);
+            StopReindexingBdns();
             return;
         } else {
             lastProcessedIndex = chainActive.Tip()->pprev->pprev;
             lastProcessedHeight = std::max(consensusParams.nHardForkEight, lastProcessedIndex->nHeight);
+            nBdnsReindexTargetHeight = chainActive.Height();
         }
+
+        // the blocks up to the last processed one are taken from its ancestors so they stay consistent even if the tip changes
+        for (const CBlockIndex* pindex = lastProcessedIndex->pprev; pindex && pindex->nHeight >= consensusParams.nHardForkEight; pindex = pindex->pprev)
+            vIndexes.push_back(pindex);
+        std::reverse(vIndexes.begin(), vIndexes.end());
     }
 
     // blocks are getting indexed without a lock until getting very close to the tip, if any corruption is detected the indexing stops
-    for (int i = consensusParams.nHardForkEight; i < lastProcessedHeight; i++) {
-        boost::this_thread::interruption_point();
+    // a pool of workers reads the blocks and resolves the inputs of their BDNS transactions ahead of this thread which applies them in height order
+    {
+        int nWorkers = std::max(1, std::min(GetNumCores() - 1, MAX_BDNS_REINDEX_THREADS));
+        ctpl::thread_pool prefetchPool(nWorkers);
+        RenameThreadPool(prefetchPool, "alterdot-bdns-prefetch");
+
+        std::deque<std::future<std::shared_ptr<CBdnsReindexBlock> > > futures;
+        size_t nNextPrefetch = 0;
+        bool fSuccess = true;
+
+        for (size_t i = 0; i < vIndexes.size(); i++) {
+            while (nNextPrefetch < vIndexes.size() && futures.size() < BDNS_REINDEX_PREFETCH_BLOCKS) {
+                const CBlockIndex* pindex = vIndexes[nNextPrefetch++];
+                futures.emplace_back(prefetchPool.push([pindex, &consensusParams](int threadId) {
+                    return PrepareBdnsReindexBlock(pindex, consensusParams);
+                }));
+            }
+
+            std::shared_ptr<CBdnsReindexBlock> prepared = futures.front().get();
+            futures.pop_front();
+
+            if (!prepared->fRead) {
+                pbdnsdb->WriteCorruptionState(true);
+                LogPrint("bdns", "BlockchainDNS -- %s: failed to read block from disk\n", __func__);
+                fSuccess = false;
+            } else {
+                ProcessBdnsTransactions(prepared->block, *vIndexes[i], consensusParams, &prepared->mapInputs);
+                fSuccess = !pbdnsdb->PossibleCorruption();
+            }
+
+            if (!fSuccess || ShutdownRequested())
+                break;
 
-        if (!ProcessBdnsActiveHeight(i, consensusParams)) {
-            fReindexingBdns = false;
-            pbdnsdb->WriteReindexing(false);
+            nBdnsReindexHeight = vIndexes[i]->nHeight;
+        }
+
+        // the remaining prefetches are dropped, the pool only waits for the ones already running
+        prefetchPool.clear_queue();
+        prefetchPool.stop(true);
+
+        if (!fSuccess) {
+            StopReindexingBdns();
             return;
         }
+
+        // the reindexing flag is kept so the reindex continues with the next startup
+        boost::this_thread::interruption_point();
+        if (ShutdownRequested())
+            return;
     }
 
     {
@@ -3877,17 +4015,20 @@ void ReindexBdnsRecords() {
         LOCK(cs_main);
         // if the last processed block is no longer present in the chain then corruption is still possible   
         if (chainActive.Contains(lastProcessedIndex)) {
-            for (int i = lastProcessedHeight; i <= chainActive.Height(); i++)
+            nBdnsReindexTargetHeight = chainActive.Height();
+
+            for (int i = lastProcessedHeight; i <= chainActive.Height(); i++) {
                 if (!ProcessBdnsActiveHeight(i, consensusParams)) {
-                    fReindexingBdns = false;
-                    pbdnsdb->WriteReindexing(false);
+                    StopReindexingBdns();
                     return;
                 }
+
+                nBdnsReindexHeight = i;
+            }
         } else
             pbdnsdb->WriteCorruptionState(true);
 
-        fReindexingBdns = false;
-        pbdnsdb->WriteReindexing(false);
+        StopReindexingBdns();
     }
 }
 
@@ -3957,6 +4098,25 @@ static bool AcceptBlockHeader(const CBlockHeader& block, CValidationState& state
     return true;
 }
 
+// Compute and cache the hashes of a batch of headers on the header check threads
+void PreHashBlockHeaders(const std::vector<CBlockHeader>& headers, const Consensus::Params& consensusParams)
+{
+    AssertLockNotHeld(cs_main);
+
+    // The result is deliberately ignored, a bad header is rejected with the proper
+    // DoS score by CheckBlockHeader later on.
+    if (nScriptCheckThreads && headers.size() > 1) {
+        CCheckQueueControl<CHeaderPoWCheck> control(&headercheckqueue);
+        std::vector<CHeaderPoWCheck> vChecks;
+        vChecks.reserve(headers.size());
+        for (const CBlockHeader& header : headers) {
+            vChecks.emplace_back(header, consensusParams);
+        }
+        control.Add(vChecks);
+        control.Wait();
+    }
+}
+
 // Exposed wrapper for AcceptBlockHeader
 bool ProcessNewBlockHeaders(const std::vector<CBlockHeader>& headers, CValidationState& state, const CChainParams& chainparams, const CBlockIndex** ppindex)
 {
@@ -4111,6 +4271,8 @@ bool TestBlockValidity(CValidationState& state, const CChainParams& chainparams,
 
     // begin tx and let it rollback
     auto dbTx = evoDb->BeginTransaction();
+    // same for the BDNS, block changes and undos are discarded
+    CBDNSDryRunScope bdnsDryRun(*pbdnsdb);
 
     // NOTE: CheckBlockHeader is called by CheckBlock
     if (!ContextualCheckBlockHeader(block, state, chainparams.GetConsensus(), pindexPrev, GetAdjustedTime()))
@@ -4430,6 +4592,18 @@ bool static LoadBlockIndexDB(const CChainParams& chainparams)
     pblocktree->ReadFlag("addressindex", fAddressIndex);
     LogPrintf("%s: address index %s\n", __func__, fAddressIndex ? "enabled" : "disabled");
 
+    // Address balances were added to the address index later, sum them up once from the existing entries
+    if (fAddressIndex) {
+        bool fAddressBalanceIndex = false;
+        pblocktree->ReadFlag("addressbalanceindex", fAddressBalanceIndex);
+        if (!fAddressBalanceIndex) {
+            LogPrintf("%s: building address balance index...\n", __func__);
+            if (!pblocktree->BuildAddressBalanceIndex())
+                return error("%s: failed to build address balance index", __func__);
+            pblocktree->WriteFlag("addressbalanceindex", true);
+        }
+    }
+
     // Check whether we have a timestamp index
     pblocktree->ReadFlag("timestampindex", fTimestampIndex);
     LogPrintf("%s: timestamp index %s\n", __func__, fTimestampIndex ? "enabled" : "disabled");
@@ -4472,6 +4646,8 @@ bool CVerifyDB::VerifyDB(const CChainParams& chainparams, CCoinsView *coinsview,
 
     // begin tx and let it rollback
     auto dbTx = evoDb->BeginTransaction();
+    // same for the BDNS, block changes and undos are discarded
+    CBDNSDryRunScope bdnsDryRun(*pbdnsdb);
 
     // Verify blocks in the best chain
     if (nCheckDepth <= 0)
@@ -4524,7 +4700,8 @@ bool CVerifyDB::VerifyDB(const CChainParams& chainparams, CCoinsView *coinsview,
         }
         // check level 3: check for inconsistencies during memory-only disconnect of tip blocks
         if (nCheckLevel >= 3 && pindex == pindexState && (coins.DynamicMemoryUsage() + pcoinsTip->DynamicMemoryUsage()) <= nCoinCacheUsage) {
-            DisconnectResult res = DisconnectBlock(block, state, pindex, coins);
+            // the disconnect only happens in memory, the block tree DB must not be touched
+            DisconnectResult res = DisconnectBlock(block, state, pindex, coins, true);
             if (res == DISCONNECT_FAILED) {
                 return error("VerifyDB(): *** irrecoverable inconsistency in block data at %d, hash=%s", pindex->nHeight, pindex->GetBlockHash().ToString());
             }
@@ -4558,7 +4735,6 @@ bool CVerifyDB::VerifyDB(const CChainParams& chainparams, CCoinsView *coinsview,
     }
 
     // if all checks went well then the BDNS should have the same state as before the checks
-    pbdnsdb->SetHeight(chainActive.Height());
     pbdnsdb->WriteCorruptionState(fPossibleCorruption);
     LogPrintf("[DONE].\n");
     LogPrintf("No coin database inconsistencies in last %i blocks (%i transactions)\n", chainActive.Height() - pindexState->nHeight, nGoodTransactions);
@@ -4633,6 +4809,7 @@ bool InitBlockIndex(const CChainParams& chainparams)
     // Use the provided setting for -addressindex in the new database
     fAddressIndex = GetBoolArg("-addressindex", DEFAULT_ADDRESSINDEX);
     pblocktree->WriteFlag("addressindex", fAddressIndex);
+    pblocktree->WriteFlag("addressbalanceindex", fAddressIndex);
 
     // Use the provided setting for -timestampindex in the new database
     fTimestampIndex = GetBoolArg("-timestampindex", DEFAULT_TIMESTAMPINDEX);
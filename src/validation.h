@@ -86,6 +86,10 @@ static const unsigned int UNDOFILE_CHUNK_SIZE = 0x400000; // 4 MiB
 static const int MAX_SCRIPTCHECK_THREADS = 16;
 /** -par default (number of script-checking threads, 0 = auto) */
 static const int DEFAULT_SCRIPTCHECK_THREADS = 0;
+/** Maximum number of threads reading blocks ahead of the BDNS reindex */
+static const int MAX_BDNS_REINDEX_THREADS = 8;
+/** Number of blocks the BDNS reindex reads ahead of the one being applied */
+static const size_t BDNS_REINDEX_PREFETCH_BLOCKS = 64;
 /** Number of blocks that can be requested at any given time from a single peer. */
 static const int MAX_BLOCKS_IN_TRANSIT_PER_PEER = 128;
 /** Timeout in seconds during which a peer must stall block download progress before being disconnected. */
@@ -167,6 +171,9 @@ extern CWaitableCriticalSection csBestBlock;
 extern CConditionVariable cvBlockChange;
 extern std::atomic_bool fImporting;
 extern bool fReindexingBdns;
+/** Height the BDNS reindex has reached and the height it runs up to, -1 while not reindexing */
+extern std::atomic<int> nBdnsReindexHeight;
+extern std::atomic<int> nBdnsReindexTargetHeight;
 extern bool fReindex;
 extern int nScriptCheckThreads;
 extern bool fTxIndex;
@@ -244,6 +251,13 @@ static const uint64_t MIN_DISK_SPACE_FOR_BLOCK_FILES = 945 * 1024 * 1024;
  */
 bool ProcessNewBlock(const CChainParams& chainparams, const std::shared_ptr<const CBlock> pblock, bool fForceProcessing, bool* fNewBlock);
 
+/**
+ * Compute the (memoized) hashes of a batch of headers on the header check threads.
+ *
+ * Call without cs_main held, before anything looks at the hashes.
+ */
+void PreHashBlockHeaders(const std::vector<CBlockHeader>& headers, const Consensus::Params& consensusParams);
+
 /**
  * Process incoming block headers.
  *
@@ -274,6 +288,8 @@ bool LoadBlockIndex(const CChainParams& chainparams);
 void UnloadBlockIndex();
 /** Run an instance of the script checking thread */
 void ThreadScriptCheck();
+/** Run an instance of the header proof-of-work checking thread */
+void ThreadHeaderCheck();
 /** Check whether we are doing an initial block download (synchronizing from disk or network) */
 bool IsInitialBlockDownload();
 /** Format a string that describes several potential problems detected by the core.
@@ -479,11 +495,37 @@ public:
     ScriptError GetScriptError() const { return error; }
 };
 
+/**
+ * Closure representing the proof-of-work check of one header, run ahead of the
+ * sequential header checks. The resulting hash is memoized in the header itself,
+ * so it must outlive the check.
+ */
+class CHeaderPoWCheck
+{
+private:
+    const CBlockHeader *pheader;
+    const Consensus::Params *pconsensusParams;
+
+public:
+    CHeaderPoWCheck(): pheader(NULL), pconsensusParams(NULL) {}
+    CHeaderPoWCheck(const CBlockHeader& headerIn, const Consensus::Params& consensusParamsIn) :
+        pheader(&headerIn), pconsensusParams(&consensusParamsIn) { }
+
+    bool operator()();
+
+    void swap(CHeaderPoWCheck &check) {
+        std::swap(pheader, check.pheader);
+        std::swap(pconsensusParams, check.pconsensusParams);
+    }
+};
+
 bool GetTimestampIndex(const unsigned int &high, const unsigned int &low, std::vector<uint256> &hashes);
 bool GetSpentIndex(CSpentIndexKey &key, CSpentIndexValue &value);
 bool GetAddressIndex(uint160 addressHash, int type,
                      std::vector<std::pair<CAddressIndexKey, CAmount> > &addressIndex,
-                     int start = 0, int end = 0);
+                     int start = 0, int end = 0,
+                     const CAddressIndexKey* pStartAfter = nullptr, size_t nMaxCount = 0);
+bool GetAddressBalance(uint160 addressHash, int type, CAddressBalanceValue &value);
 bool GetAddressUnspent(uint160 addressHash, int type,
                        std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue> > &unspentOutputs);
 
@@ -505,12 +547,14 @@ bool CheckBlock(const CBlock& block, CValidationState& state, const Consensus::P
 /** Processing of BDNS-IPFS transactions*/
 bool ExtractBdnsIpfsFromScript(const CScript& scriptPubKey, std::string& dtpAddress, std::string& content);
 bool ExtractBdnsBanFromScript(const CScript& scriptPubKey, std::string& bdnsName);
+/** Inputs of the possible BDNS transactions of a block, resolved ahead of processing it */
+typedef std::map<uint256, CTransactionRef> BdnsInputMap;
 // processes BDNS records from the given block ranging from registrations and updates to bans and expirations
-void ProcessBdnsTransactions(const CBlock& block, const CBlockIndex& pindex, const Consensus::Params& consensusParams);
-void ProcessPossibleBdnsIpfsRegistration(const CScript& scriptPubKey, const uint256& regTxid);
+void ProcessBdnsTransactions(const CBlock& block, const CBlockIndex& pindex, const Consensus::Params& consensusParams, const BdnsInputMap* pmapInputs = nullptr);
+void ProcessPossibleBdnsIpfsRegistration(const CScript& scriptPubKey, const uint256& regTxid, const int& nExpiryHeight);
 void ProcessPossibleBdnsIpfsUpdate(const CTransaction& updateTx, const CTransaction& inputTx);
 void ProcessPossibleBdnsIpfsBan(const CScript& scriptPubKey);
-void ProcessExpiredBdnsRecords(const CBlockIndex* pblockindex, const Consensus::Params& consensusParams);
+void ProcessExpiredBdnsRecords();
 bool ProcessBdnsActiveHeight(const int& nHeight, const Consensus::Params& consensusParams);
 void ReindexBdnsRecords();
 
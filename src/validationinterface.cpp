@@ -5,20 +5,162 @@
 
 #include "validationinterface.h"
 
+#include "governance-object.h"
+#include "governance-vote.h"
+#include "primitives/transaction.h"
+#include "scheduler.h"
+
+#include "evo/deterministicmns.h"
+
+#include <functional>
+#include <map>
+#include <mutex>
+#include <vector>
+
 static CMainSignals g_signals;
 
+/** Delivers the notifications of asynchronous listeners in order on the scheduler thread */
+static std::unique_ptr<SingleThreadedSchedulerClient> g_background_callbacks;
+
+static std::mutex g_async_mutex;
+static std::map<CValidationInterface*, std::vector<boost::signals2::connection> > g_async_connections;
+
 CMainSignals& GetMainSignals()
 {
     return g_signals;
 }
 
-void RegisterValidationInterface(CValidationInterface* pwalletIn) {
-    g_signals.AcceptedBlockHeader.connect(boost::bind(&CValidationInterface::AcceptedBlockHeader, pwalletIn, _1));
-    g_signals.NotifyHeaderTip.connect(boost::bind(&CValidationInterface::NotifyHeaderTip, pwalletIn, _1, _2));
-    g_signals.UpdatedBlockTip.connect(boost::bind(&CValidationInterface::UpdatedBlockTip, pwalletIn, _1, _2, _3));
-    g_signals.SyncTransaction.connect(boost::bind(&CValidationInterface::SyncTransaction, pwalletIn, _1, _2, _3));
-    g_signals.NotifyTransactionLock.connect(boost::bind(&CValidationInterface::NotifyTransactionLock, pwalletIn, _1));
-    g_signals.NotifyChainLock.connect(boost::bind(&CValidationInterface::NotifyChainLock, pwalletIn, _1));
+void CMainSignals::RegisterBackgroundSignalScheduler(CScheduler& scheduler)
+{
+    assert(!g_background_callbacks);
+    g_background_callbacks.reset(new SingleThreadedSchedulerClient(&scheduler));
+}
+
+void CMainSignals::UnregisterBackgroundSignalScheduler()
+{
+    if (!g_background_callbacks)
+        return;
+    g_background_callbacks->EmptyQueue();
+    g_background_callbacks.reset();
+}
+
+void CMainSignals::FlushBackgroundCallbacks()
+{
+    if (g_background_callbacks)
+        g_background_callbacks->EmptyQueue();
+}
+
+bool CMainSignals::WaitForBackgroundCallbacksBelow(size_t nMaxPending, int64_t nTimeoutMillis)
+{
+    if (!g_background_callbacks)
+        return true;
+    return g_background_callbacks->WaitForPendingBelow(nMaxPending, nTimeoutMillis);
+}
+
+size_t CMainSignals::CallbacksPending()
+{
+    if (!g_background_callbacks)
+        return 0;
+    return g_background_callbacks->CallbacksPending();
+}
+
+/** Queue func behind the pending notifications, or run it right away when there is no background scheduler */
+static void QueueOrRun(CValidationInterface* pwalletIn, std::function<void()> func)
+{
+    if (g_background_callbacks) {
+        g_background_callbacks->AddToProcessQueue(std::move(func), pwalletIn);
+    } else {
+        func();
+    }
+}
+
+/**
+ * Connect the notifications which return nothing to the caller through the background queue. The
+ * arguments are copied as the caller's references don't outlive the signal, block index entries
+ * are never deleted so pointers to them are passed as they are.
+ */
+static void RegisterAsyncValidationInterface(CValidationInterface* pwalletIn,
+    std::function<void (const CBlockIndex*)> acceptedBlockHeader,
+    std::function<void (const CBlockIndex*, bool)> notifyHeaderTip,
+    std::function<void (const CBlockIndex*, const CBlockIndex*, bool)> updatedBlockTip,
+    std::function<void (const CTransaction&, const CBlockIndex*, int)> syncTransaction,
+    std::function<void (const CTransaction&)> notifyTransactionLock,
+    std::function<void (const CBlockIndex*)> notifyChainLock,
+    std::function<void (const CGovernanceVote&)> notifyGovernanceVote,
+    std::function<void (const CGovernanceObject&)> notifyGovernanceObject,
+    std::function<void (const CTransaction&, const CTransaction&)> notifyInstantSendDoubleSpendAttempt,
+    std::function<void (bool, const CDeterministicMNList&, const CDeterministicMNListDiff&)> notifyMasternodeListChanged)
+{
+    std::vector<boost::signals2::connection> connections;
+    connections.emplace_back(g_signals.AcceptedBlockHeader.connect([pwalletIn, acceptedBlockHeader](const CBlockIndex* pindexNew) {
+        QueueOrRun(pwalletIn, [acceptedBlockHeader, pindexNew] { acceptedBlockHeader(pindexNew); });
+    }));
+    connections.emplace_back(g_signals.NotifyHeaderTip.connect([pwalletIn, notifyHeaderTip](const CBlockIndex* pindexNew, bool fInitialDownload) {
+        QueueOrRun(pwalletIn, [notifyHeaderTip, pindexNew, fInitialDownload] { notifyHeaderTip(pindexNew, fInitialDownload); });
+    }));
+    connections.emplace_back(g_signals.UpdatedBlockTip.connect([pwalletIn, updatedBlockTip](const CBlockIndex* pindexNew, const CBlockIndex* pindexFork, bool fInitialDownload) {
+        QueueOrRun(pwalletIn, [updatedBlockTip, pindexNew, pindexFork, fInitialDownload] { updatedBlockTip(pindexNew, pindexFork, fInitialDownload); });
+    }));
+    connections.emplace_back(g_signals.SyncTransaction.connect([pwalletIn, syncTransaction](const CTransaction& tx, const CBlockIndex* pindex, int posInBlock) {
+        CTransactionRef ptx = MakeTransactionRef(tx);
+        QueueOrRun(pwalletIn, [syncTransaction, ptx, pindex, posInBlock] { syncTransaction(*ptx, pindex, posInBlock); });
+    }));
+    connections.emplace_back(g_signals.NotifyTransactionLock.connect([pwalletIn, notifyTransactionLock](const CTransaction& tx) {
+        CTransactionRef ptx = MakeTransactionRef(tx);
+        QueueOrRun(pwalletIn, [notifyTransactionLock, ptx] { notifyTransactionLock(*ptx); });
+    }));
+    connections.emplace_back(g_signals.NotifyChainLock.connect([pwalletIn, notifyChainLock](const CBlockIndex* pindex) {
+        QueueOrRun(pwalletIn, [notifyChainLock, pindex] { notifyChainLock(pindex); });
+    }));
+    connections.emplace_back(g_signals.NotifyGovernanceVote.connect([pwalletIn, notifyGovernanceVote](const CGovernanceVote& vote) {
+        auto pvote = std::make_shared<const CGovernanceVote>(vote);
+        QueueOrRun(pwalletIn, [notifyGovernanceVote, pvote] { notifyGovernanceVote(*pvote); });
+    }));
+    connections.emplace_back(g_signals.NotifyGovernanceObject.connect([pwalletIn, notifyGovernanceObject](const CGovernanceObject& object) {
+        auto pobject = std::make_shared<const CGovernanceObject>(object);
+        QueueOrRun(pwalletIn, [notifyGovernanceObject, pobject] { notifyGovernanceObject(*pobject); });
+    }));
+    connections.emplace_back(g_signals.NotifyInstantSendDoubleSpendAttempt.connect([pwalletIn, notifyInstantSendDoubleSpendAttempt](const CTransaction& currentTx, const CTransaction& previousTx) {
+        CTransactionRef pcurrentTx = MakeTransactionRef(currentTx);
+        CTransactionRef ppreviousTx = MakeTransactionRef(previousTx);
+        QueueOrRun(pwalletIn, [notifyInstantSendDoubleSpendAttempt, pcurrentTx, ppreviousTx] { notifyInstantSendDoubleSpendAttempt(*pcurrentTx, *ppreviousTx); });
+    }));
+    connections.emplace_back(g_signals.NotifyMasternodeListChanged.connect([pwalletIn, notifyMasternodeListChanged](bool undo, const CDeterministicMNList& oldMNList, const CDeterministicMNListDiff& diff) {
+        auto poldMNList = std::make_shared<const CDeterministicMNList>(oldMNList);
+        auto pdiff = std::make_shared<const CDeterministicMNListDiff>(diff);
+        QueueOrRun(pwalletIn, [notifyMasternodeListChanged, undo, poldMNList, pdiff] { notifyMasternodeListChanged(undo, *poldMNList, *pdiff); });
+    }));
+
+    std::lock_guard<std::mutex> lock(g_async_mutex);
+    auto& vec = g_async_connections[pwalletIn];
+    vec.insert(vec.end(), connections.begin(), connections.end());
+}
+
+void RegisterValidationInterface(CValidationInterface* pwalletIn, bool fAsync) {
+    if (fAsync) {
+        RegisterAsyncValidationInterface(pwalletIn,
+            boost::bind(&CValidationInterface::AcceptedBlockHeader, pwalletIn, _1),
+            boost::bind(&CValidationInterface::NotifyHeaderTip, pwalletIn, _1, _2),
+            boost::bind(&CValidationInterface::UpdatedBlockTip, pwalletIn, _1, _2, _3),
+            boost::bind(&CValidationInterface::SyncTransaction, pwalletIn, _1, _2, _3),
+            boost::bind(&CValidationInterface::NotifyTransactionLock, pwalletIn, _1),
+            boost::bind(&CValidationInterface::NotifyChainLock, pwalletIn, _1),
+            boost::bind(&CValidationInterface::NotifyGovernanceVote, pwalletIn, _1),
+            boost::bind(&CValidationInterface::NotifyGovernanceObject, pwalletIn, _1),
+            boost::bind(&CValidationInterface::NotifyInstantSendDoubleSpendAttempt, pwalletIn, _1, _2),
+            boost::bind(&CValidationInterface::NotifyMasternodeListChanged, pwalletIn, _1, _2, _3));
+    } else {
+        g_signals.AcceptedBlockHeader.connect(boost::bind(&CValidationInterface::AcceptedBlockHeader, pwalletIn, _1));
+        g_signals.NotifyHeaderTip.connect(boost::bind(&CValidationInterface::NotifyHeaderTip, pwalletIn, _1, _2));
+        g_signals.UpdatedBlockTip.connect(boost::bind(&CValidationInterface::UpdatedBlockTip, pwalletIn, _1, _2, _3));
+        g_signals.SyncTransaction.connect(boost::bind(&CValidationInterface::SyncTransaction, pwalletIn, _1, _2, _3));
+        g_signals.NotifyTransactionLock.connect(boost::bind(&CValidationInterface::NotifyTransactionLock, pwalletIn, _1));
+        g_signals.NotifyChainLock.connect(boost::bind(&CValidationInterface::NotifyChainLock, pwalletIn, _1));
+        g_signals.NotifyGovernanceObject.connect(boost::bind(&CValidationInterface::NotifyGovernanceObject, pwalletIn, _1));
+        g_signals.NotifyGovernanceVote.connect(boost::bind(&CValidationInterface::NotifyGovernanceVote, pwalletIn, _1));
+        g_signals.NotifyInstantSendDoubleSpendAttempt.connect(boost::bind(&CValidationInterface::NotifyInstantSendDoubleSpendAttempt, pwalletIn, _1, _2));
+        g_signals.NotifyMasternodeListChanged.connect(boost::bind(&CValidationInterface::NotifyMasternodeListChanged, pwalletIn, _1, _2, _3));
+    }
     g_signals.UpdatedTransaction.connect(boost::bind(&CValidationInterface::UpdatedTransaction, pwalletIn, _1));
     g_signals.SetBestChain.connect(boost::bind(&CValidationInterface::SetBestChain, pwalletIn, _1));
     g_signals.Inventory.connect(boost::bind(&CValidationInterface::Inventory, pwalletIn, _1));
@@ -27,10 +169,6 @@ void RegisterValidationInterface(CValidationInterface* pwalletIn) {
     g_signals.ScriptForMining.connect(boost::bind(&CValidationInterface::GetScriptForMining, pwalletIn, _1));
     g_signals.BlockFound.connect(boost::bind(&CValidationInterface::ResetRequestCount, pwalletIn, _1));
     g_signals.NewPoWValidBlock.connect(boost::bind(&CValidationInterface::NewPoWValidBlock, pwalletIn, _1, _2));
-    g_signals.NotifyGovernanceObject.connect(boost::bind(&CValidationInterface::NotifyGovernanceObject, pwalletIn, _1));
-    g_signals.NotifyGovernanceVote.connect(boost::bind(&CValidationInterface::NotifyGovernanceVote, pwalletIn, _1));
-    g_signals.NotifyInstantSendDoubleSpendAttempt.connect(boost::bind(&CValidationInterface::NotifyInstantSendDoubleSpendAttempt, pwalletIn, _1, _2));
-    g_signals.NotifyMasternodeListChanged.connect(boost::bind(&CValidationInterface::NotifyMasternodeListChanged, pwalletIn, _1, _2, _3));
 }
 
 void UnregisterValidationInterface(CValidationInterface* pwalletIn) {
@@ -52,6 +190,23 @@ void UnregisterValidationInterface(CValidationInterface* pwalletIn) {
     g_signals.NotifyGovernanceVote.disconnect(boost::bind(&CValidationInterface::NotifyGovernanceVote, pwalletIn, _1));
     g_signals.NotifyInstantSendDoubleSpendAttempt.disconnect(boost::bind(&CValidationInterface::NotifyInstantSendDoubleSpendAttempt, pwalletIn, _1, _2));
     g_signals.NotifyMasternodeListChanged.disconnect(boost::bind(&CValidationInterface::NotifyMasternodeListChanged, pwalletIn, _1, _2, _3));
+
+    std::vector<boost::signals2::connection> connections;
+    {
+        std::lock_guard<std::mutex> lock(g_async_mutex);
+        auto it = g_async_connections.find(pwalletIn);
+        if (it != g_async_connections.end()) {
+            connections = std::move(it->second);
+            g_async_connections.erase(it);
+        }
+    }
+    for (auto& connection : connections) {
+        connection.disconnect();
+    }
+    // Whatever is still queued for this listener must not run once the caller destroyed it
+    if (!connections.empty() && g_background_callbacks) {
+        g_background_callbacks->RemoveFromProcessQueue(pwalletIn);
+    }
 }
 
 void UnregisterAllValidationInterfaces() {
@@ -73,4 +228,15 @@ void UnregisterAllValidationInterfaces() {
     g_signals.NotifyGovernanceVote.disconnect_all_slots();
     g_signals.NotifyInstantSendDoubleSpendAttempt.disconnect_all_slots();
     g_signals.NotifyMasternodeListChanged.disconnect_all_slots();
+
+    std::map<CValidationInterface*, std::vector<boost::signals2::connection> > mapConnections;
+    {
+        std::lock_guard<std::mutex> lock(g_async_mutex);
+        mapConnections.swap(g_async_connections);
+    }
+    if (g_background_callbacks) {
+        for (const auto& pair : mapConnections) {
+            g_background_callbacks->RemoveFromProcessQueue(pair.first);
+        }
+    }
 }
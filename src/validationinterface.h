@@ -15,6 +15,7 @@ class CBlockIndex;
 struct CBlockLocator;
 class CConnman;
 class CReserveScript;
+class CScheduler;
 class CTransaction;
 class CValidationInterface;
 class CValidationState;
@@ -24,10 +25,16 @@ class CDeterministicMNList;
 class CDeterministicMNListDiff;
 class uint256;
 
+/** Number of queued asynchronous notifications above which block connection waits for the listeners */
+static const size_t MAX_PENDING_VALIDATION_CALLBACKS = 5000;
+
 // These functions dispatch to one or all registered wallets
 
-/** Register a wallet to receive updates from core */
-void RegisterValidationInterface(CValidationInterface* pwalletIn);
+/**
+ * Register a wallet to receive updates from core. With fAsync, the notifications which don't return
+ * anything to the caller are queued and delivered in order on the background scheduler thread.
+ */
+void RegisterValidationInterface(CValidationInterface* pwalletIn, bool fAsync = false);
 /** Unregister a wallet from core */
 void UnregisterValidationInterface(CValidationInterface* pwalletIn);
 /** Unregister all wallets from core */
@@ -53,7 +60,7 @@ protected:
     virtual void GetScriptForMining(boost::shared_ptr<CReserveScript>&) {}
     virtual void ResetRequestCount(const uint256 &hash) {}
     virtual void NewPoWValidBlock(const CBlockIndex *pindex, const std::shared_ptr<const CBlock>& block) {}
-    friend void ::RegisterValidationInterface(CValidationInterface*);
+    friend void ::RegisterValidationInterface(CValidationInterface*, bool);
     friend void ::UnregisterValidationInterface(CValidationInterface*);
     friend void ::UnregisterAllValidationInterfaces();
 };
@@ -106,6 +113,20 @@ struct CMainSignals {
      * Notifies listeners that a block which builds directly on our current tip
      * has been received and connected to the headers tree, though not validated yet */
     boost::signals2::signal<void (const CBlockIndex *, const std::shared_ptr<const CBlock>&)> NewPoWValidBlock;
+
+    /** Register a CScheduler to deliver the notifications of asynchronous listeners */
+    void RegisterBackgroundSignalScheduler(CScheduler& scheduler);
+    /** Unregister the CScheduler, delivering whatever is still queued on the calling thread */
+    void UnregisterBackgroundSignalScheduler();
+    /** Deliver all queued notifications on the calling thread. The scheduler must not be serviced anymore. */
+    void FlushBackgroundCallbacks();
+    /**
+     * Wait until less than nMaxPending notifications are queued. Returns false on timeout. Doesn't wait
+     * on the scheduler thread. Must not be called while holding locks the listeners may take (cs_main).
+     */
+    bool WaitForBackgroundCallbacksBelow(size_t nMaxPending, int64_t nTimeoutMillis);
+    /** Number of queued asynchronous notifications */
+    size_t CallbacksPending();
 };
 
 CMainSignals& GetMainSignals();
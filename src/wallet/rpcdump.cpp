@@ -73,6 +73,13 @@ std::string DecodeDumpString(const std::string &str) {
     return ret.str();
 }
 
+/** The imported keys and scripts are kept, but report that the rescan for them didn't complete */
+static void EnsureRescanCompleted(const CBlockIndex* pindexInterrupted)
+{
+    if (pindexInterrupted)
+        throw JSONRPCError(RPC_MISC_ERROR, strprintf("Rescan was interrupted at block %d, transactions may be missing.", pindexInterrupted->nHeight));
+}
+
 UniValue importprivkey(const JSONRPCRequest& request)
 {
     CWallet * const pwallet = GetWalletForJSONRPCRequest(request);
@@ -150,7 +157,9 @@ UniValue importprivkey(const JSONRPCRequest& request)
         pwallet->UpdateTimeFirstKey(1);
 
         if (fRescan) {
-            pwallet->ScanForWalletTransactions(chainActive.Genesis(), true);
+            CBlockIndex* pindexInterrupted = nullptr;
+            pwallet->ScanForWalletTransactions(chainActive.Genesis(), true, &pindexInterrupted);
+            EnsureRescanCompleted(pindexInterrupted);
         }
     }
 
@@ -192,6 +201,34 @@ void ImportAddress(CWallet * const pwallet, const CBitcoinAddress& address, cons
         pwallet->SetAddressBook(address.Get(), strLabel, "receive");
 }
 
+UniValue abortrescan(const JSONRPCRequest& request)
+{
+    CWallet * const pwallet = GetWalletForJSONRPCRequest(request);
+    if (!EnsureWalletIsAvailable(pwallet, request.fHelp)) {
+        return NullUniValue;
+    }
+
+    if (request.fHelp || request.params.size() > 0)
+        throw std::runtime_error(
+            "abortrescan\n"
+            "\nStops current wallet rescan triggered e.g. by an importprivkey call.\n"
+            "\nResult:\n"
+            "true|false    (boolean) Whether a running rescan was asked to stop\n"
+            "\nExamples:\n"
+            "\nImport a private key\n"
+            + HelpExampleCli("importprivkey", "\"mykey\"") +
+            "\nAbort the running wallet rescan\n"
+            + HelpExampleCli("abortrescan", "") +
+            "\nAs a JSON-RPC call\n"
+            + HelpExampleRpc("abortrescan", "")
+        );
+
+    // Deliberately takes no locks, the rescan holds cs_main and cs_wallet until it is done
+    if (!pwallet->IsScanning() || pwallet->IsAbortingRescan()) return false;
+    pwallet->AbortRescan();
+    return true;
+}
+
 UniValue importaddress(const JSONRPCRequest& request)
 {
     CWallet * const pwallet = GetWalletForJSONRPCRequest(request);
@@ -255,8 +292,10 @@ UniValue importaddress(const JSONRPCRequest& request)
 
     if (fRescan)
     {
-        pwallet->ScanForWalletTransactions(chainActive.Genesis(), true);
+        CBlockIndex* pindexInterrupted = nullptr;
+        pwallet->ScanForWalletTransactions(chainActive.Genesis(), true, &pindexInterrupted);
         pwallet->ReacceptWalletTransactions();
+        EnsureRescanCompleted(pindexInterrupted);
     }
 
     return NullUniValue;
@@ -413,8 +452,10 @@ UniValue importpubkey(const JSONRPCRequest& request)
 
     if (fRescan)
     {
-        pwallet->ScanForWalletTransactions(chainActive.Genesis(), true);
+        CBlockIndex* pindexInterrupted = nullptr;
+        pwallet->ScanForWalletTransactions(chainActive.Genesis(), true, &pindexInterrupted);
         pwallet->ReacceptWalletTransactions();
+        EnsureRescanCompleted(pindexInterrupted);
     }
 
     return NullUniValue;
@@ -517,11 +558,13 @@ UniValue importwallet(const JSONRPCRequest& request)
     CBlockIndex* pindex = chainActive.FindEarliestAtLeast(nTimeBegin - TIMESTAMP_WINDOW);
 
     LogPrintf("Rescanning last %i blocks\n", pindex ? chainActive.Height() - pindex->nHeight + 1 : 0);
-    pwallet->ScanForWalletTransactions(pindex);
+    CBlockIndex* pindexInterrupted = nullptr;
+    pwallet->ScanForWalletTransactions(pindex, false, &pindexInterrupted);
     pwallet->MarkDirty();
 
     if (!fGood)
         throw JSONRPCError(RPC_WALLET_ERROR, "Error adding some keys to wallet");
+    EnsureRescanCompleted(pindexInterrupted);
 
     return NullUniValue;
 }
@@ -652,10 +695,12 @@ UniValue importelectrumwallet(const JSONRPCRequest& request)
     pwallet->UpdateTimeFirstKey(nTimeBegin);
 
     LogPrintf("Rescanning %i blocks\n", chainActive.Height() - nStartHeight + 1);
-    pwallet->ScanForWalletTransactions(chainActive[nStartHeight], true);
+    CBlockIndex* pindexInterrupted = nullptr;
+    pwallet->ScanForWalletTransactions(chainActive[nStartHeight], true, &pindexInterrupted);
 
     if (!fGood)
         throw JSONRPCError(RPC_WALLET_ERROR, "Error adding some keys to wallet");
+    EnsureRescanCompleted(pindexInterrupted);
 
     return NullUniValue;
 }
@@ -1310,12 +1355,28 @@ UniValue importmulti(const JSONRPCRequest& mainRequest)
     if (fRescan && fRunScan && requests.size()) {
         CBlockIndex* pindex = nLowestTimestamp > minimumTimestamp ? chainActive.FindEarliestAtLeast(std::max<int64_t>(nLowestTimestamp - TIMESTAMP_WINDOW, 0)) : chainActive.Genesis();
         CBlockIndex* scannedRange = nullptr;
+        CBlockIndex* pindexInterrupted = nullptr;
         if (pindex) {
-            scannedRange = pwallet->ScanForWalletTransactions(pindex, true);
+            scannedRange = pwallet->ScanForWalletTransactions(pindex, true, &pindexInterrupted);
             pwallet->ReacceptWalletTransactions();
         }
 
-        if (!scannedRange || scannedRange->nHeight > pindex->nHeight) {
+        if (pindexInterrupted) {
+            // the blocks from the interruption on are missing for every imported key
+            std::vector<UniValue> results = response.getValues();
+            response.clear();
+            response.setArray();
+            for (const UniValue& result : results) {
+                if (result.exists("error")) {
+                    response.push_back(result);
+                } else {
+                    UniValue errorResult = UniValue(UniValue::VOBJ);
+                    errorResult.pushKV("success", UniValue(false));
+                    errorResult.pushKV("error", JSONRPCError(RPC_MISC_ERROR, strprintf("Rescan was interrupted at block %d, transactions may be missing.", pindexInterrupted->nHeight)));
+                    response.push_back(std::move(errorResult));
+                }
+            }
+        } else if (!scannedRange || scannedRange->nHeight > pindex->nHeight) {
             std::vector<UniValue> results = response.getValues();
             response.clear();
             response.setArray();
@@ -9,7 +9,9 @@
 #include <utility>
 #include <vector>
 
+#include "privatesend-client.h"
 #include "rpc/server.h"
+#include "script/interpreter.h"
 #include "test/test_alterdot.h"
 #include "validation.h"
 #include "wallet/test/wallet_test_fixture.h"
@@ -428,6 +430,78 @@ BOOST_FIXTURE_TEST_CASE(rescan, TestChain100Setup)
     }
 }
 
+// Verify the rescan finds the same transactions no matter how many threads
+// read and match blocks, including a spend that pays none of our keys.
+BOOST_FIXTURE_TEST_CASE(rescan_threads, TestChain100Setup)
+{
+    CKey otherKey;
+    otherKey.MakeNewKey(true);
+    CScript scriptPubKey = CScript() << ToByteVector(coinbaseKey.GetPubKey()) << OP_CHECKSIG;
+
+    CMutableTransaction spend;
+    spend.nVersion = 1;
+    spend.vin.resize(1);
+    spend.vin[0].prevout = COutPoint(coinbaseTxns[0].GetHash(), 0);
+    spend.vout.resize(1);
+    spend.vout[0].nValue = 11 * CENT;
+    spend.vout[0].scriptPubKey = GetScriptForRawPubKey(otherKey.GetPubKey());
+
+    std::vector<unsigned char> vchSig;
+    uint256 hash = SignatureHash(scriptPubKey, spend, 0, SIGHASH_ALL);
+    BOOST_CHECK(coinbaseKey.Sign(hash, vchSig));
+    vchSig.push_back((unsigned char)SIGHASH_ALL);
+    spend.vin[0].scriptSig << vchSig;
+
+    CBlock block = CreateAndProcessBlock({spend}, scriptPubKey);
+    BOOST_CHECK(chainActive.Tip()->GetBlockHash() == block.GetHash());
+
+    LOCK(cs_main);
+    int nRescanThreadsOld = nRescanThreads;
+    size_t nWalletSize = 0;
+    CAmount nBalance = 0;
+    for (int nThreads : {1, 3, MAX_RESCAN_THREADS}) {
+        nRescanThreads = nThreads;
+        CWallet wallet;
+        LOCK(wallet.cs_wallet);
+        wallet.AddKeyPubKey(coinbaseKey, coinbaseKey.GetPubKey());
+        BOOST_CHECK_EQUAL(chainActive.Genesis(), wallet.ScanForWalletTransactions(chainActive.Genesis()));
+        BOOST_CHECK(wallet.mapWallet.count(spend.GetHash()));
+        if (nThreads == 1) {
+            nWalletSize = wallet.mapWallet.size();
+            nBalance = wallet.GetBalance();
+        }
+        BOOST_CHECK_EQUAL(wallet.mapWallet.size(), nWalletSize);
+        BOOST_CHECK_EQUAL(wallet.GetBalance(), nBalance);
+        BOOST_CHECK(!wallet.IsScanning());
+    }
+    nRescanThreads = nRescanThreadsOld;
+}
+
+// Verify an aborted rescan reports where it stopped instead of looking complete.
+BOOST_FIXTURE_TEST_CASE(rescan_abort, TestChain100Setup)
+{
+    LOCK(cs_main);
+    CWallet wallet;
+    LOCK(wallet.cs_wallet);
+    wallet.AddKeyPubKey(coinbaseKey, coinbaseKey.GetPubKey());
+
+    // abort as soon as the scan reports that it started
+    wallet.ShowProgress.connect([&wallet](const std::string& title, int nProgress) {
+        if (nProgress == 0)
+            wallet.AbortRescan();
+    });
+    CBlockIndex* pindexInterrupted = nullptr;
+    wallet.ScanForWalletTransactions(chainActive.Genesis(), false, &pindexInterrupted);
+    BOOST_CHECK(pindexInterrupted == chainActive.Genesis());
+    BOOST_CHECK(wallet.mapWallet.empty());
+    BOOST_CHECK(!wallet.IsScanning());
+
+    wallet.ShowProgress.disconnect_all_slots();
+    wallet.ScanForWalletTransactions(chainActive.Genesis(), false, &pindexInterrupted);
+    BOOST_CHECK(pindexInterrupted == nullptr);
+    BOOST_CHECK(!wallet.mapWallet.empty());
+}
+
 // Verify importwallet RPC starts rescan at earliest block with timestamp
 // greater or equal than key birthday. Previously there was a bug where
 // importwallet RPC would start the scan at the latest block with timestamp less
@@ -513,6 +587,225 @@ BOOST_FIXTURE_TEST_CASE(coin_mark_dirty_immature_credit, TestChain100Setup)
     BOOST_CHECK_EQUAL(wtx.GetImmatureCredit(), 500*COIN);
 }
 
+// Check that the cached balance tally is refreshed when a block is connected
+// and that it matches a full rescan of the wallet.
+BOOST_FIXTURE_TEST_CASE(balance_tally_block_connected, TestChain100Setup)
+{
+    CWallet wallet;
+    CAmount nBalance, nImmature;
+    {
+        LOCK2(cs_main, wallet.cs_wallet);
+        wallet.AddKeyPubKey(coinbaseKey, coinbaseKey.GetPubKey());
+        wallet.ScanForWalletTransactions(chainActive.Genesis());
+        nBalance = wallet.GetBalance();
+        nImmature = wallet.GetImmatureBalance();
+        BOOST_CHECK(nBalance > 0);
+        BOOST_CHECK(nImmature > 0);
+    }
+
+    RegisterValidationInterface(&wallet);
+    CBlock block = CreateAndProcessBlock({}, GetScriptForRawPubKey(coinbaseKey.GetPubKey()));
+    UnregisterValidationInterface(&wallet);
+
+    LOCK2(cs_main, wallet.cs_wallet);
+    CAmount nCoinbaseCredit = 0;
+    for (const auto& txout : block.vtx[0]->vout) {
+        if (wallet.IsMine(txout))
+            nCoinbaseCredit += txout.nValue;
+    }
+    CAmount nNewBalance = wallet.GetBalance();
+    CAmount nNewImmature = wallet.GetImmatureBalance();
+    // one more coinbase matured and a new immature one was added
+    BOOST_CHECK(nNewBalance > nBalance);
+    BOOST_CHECK_EQUAL(nNewBalance + nNewImmature, nBalance + nImmature + nCoinbaseCredit);
+
+    // a full scan yields the same
+    wallet.MarkDirty();
+    BOOST_CHECK_EQUAL(wallet.GetBalance(), nNewBalance);
+    BOOST_CHECK_EQUAL(wallet.GetImmatureBalance(), nNewImmature);
+}
+
+// Check that AvailableCoins, which only visits the indexed unspent outputs,
+// finds the same coins as a walk over all wallet transactions.
+BOOST_FIXTURE_TEST_CASE(available_coins_utxo_index, TestChain100Setup)
+{
+    CWallet wallet;
+    LOCK2(cs_main, wallet.cs_wallet);
+    wallet.AddKeyPubKey(coinbaseKey, coinbaseKey.GetPubKey());
+    wallet.ScanForWalletTransactions(chainActive.Genesis());
+
+    std::set<COutPoint> setExpected;
+    for (const auto& pair : wallet.mapWallet) {
+        const CWalletTx& wtx = pair.second;
+        if (wtx.GetBlocksToMaturity() > 0)
+            continue;
+        for (unsigned int i = 0; i < wtx.tx->vout.size(); i++) {
+            if (wallet.IsMine(wtx.tx->vout[i]) && !wallet.IsSpent(pair.first, i) && wtx.tx->vout[i].nValue > 0)
+                setExpected.emplace(pair.first, i);
+        }
+    }
+    BOOST_CHECK(!setExpected.empty());
+
+    std::vector<COutput> vCoins;
+    wallet.AvailableCoins(vCoins);
+    std::set<COutPoint> setFound;
+    for (const auto& output : vCoins)
+        setFound.emplace(output.tx->GetHash(), output.i);
+    BOOST_CHECK(setFound == setExpected);
+
+    // none of the coinbase outputs is a denomination, they all show up as non-denominated
+    wallet.AvailableCoins(vCoins, true, NULL, false, ONLY_DENOMINATED);
+    BOOST_CHECK(vCoins.empty());
+    wallet.AvailableCoins(vCoins, true, NULL, false, ONLY_NONDENOMINATED);
+    BOOST_CHECK_EQUAL(vCoins.size(), setExpected.size());
+
+    // the index is rebuilt from scratch after MarkDirty
+    wallet.MarkDirty();
+    wallet.AvailableCoins(vCoins);
+    BOOST_CHECK_EQUAL(vCoins.size(), setExpected.size());
+}
+
+static uint256 AddPrivateSendTx(CWallet& wallet, const std::vector<COutPoint>& vInputs, const std::vector<CAmount>& vAmounts, const CScript& scriptPubKey)
+{
+    CMutableTransaction tx;
+    for (const auto& outpoint : vInputs) {
+        tx.vin.emplace_back(outpoint);
+    }
+    for (CAmount nAmount : vAmounts) {
+        tx.vout.emplace_back(nAmount, scriptPubKey);
+    }
+    CWalletTx wtx(&wallet, MakeTransactionRef(tx));
+    wallet.AddToWallet(wtx);
+    return wtx.GetHash();
+}
+
+BOOST_AUTO_TEST_CASE(privatesend_rounds)
+{
+    CPrivateSend::InitStandardDenominations();
+    const CAmount nDenom = COIN + 1000;
+
+    CWallet wallet;
+    LOCK2(cs_main, wallet.cs_wallet);
+    CKey key;
+    key.MakeNewKey(true);
+    wallet.AddKeyPubKey(key, key.GetPubKey());
+    CScript scriptPubKey = GetScriptForDestination(key.GetPubKey().GetID());
+
+    // tx0 isn't a mixing transaction, tx1 is the first round
+    uint256 tx0 = AddPrivateSendTx(wallet, {COutPoint(GetRandHash(), 0)}, {100 * COIN, nDenom, nDenom}, scriptPubKey);
+    uint256 tx1 = AddPrivateSendTx(wallet, {COutPoint(tx0, 1)}, {nDenom, nDenom}, scriptPubKey);
+    // tx2 and tx3 spend one output of tx1 each and tx4 joins them again
+    uint256 tx2 = AddPrivateSendTx(wallet, {COutPoint(tx1, 0)}, {nDenom}, scriptPubKey);
+    uint256 tx3 = AddPrivateSendTx(wallet, {COutPoint(tx1, 1)}, {nDenom}, scriptPubKey);
+    uint256 tx4 = AddPrivateSendTx(wallet, {COutPoint(tx2, 0), COutPoint(tx3, 0)}, {nDenom}, scriptPubKey);
+    // the shortest chain counts
+    uint256 tx5 = AddPrivateSendTx(wallet, {COutPoint(tx4, 0), COutPoint(tx0, 2)}, {nDenom}, scriptPubKey);
+    // all inputs foreign
+    uint256 tx6 = AddPrivateSendTx(wallet, {COutPoint(GetRandHash(), 0)}, {nDenom, CPrivateSend::GetCollateralAmount()}, scriptPubKey);
+
+    // a chain longer than the maximum, queried from its end first
+    std::vector<uint256> vChain;
+    COutPoint prevout(tx5, 0);
+    for (int i = 0; i < MAX_PRIVATESEND_ROUNDS + 4; i++) {
+        vChain.push_back(AddPrivateSendTx(wallet, {prevout}, {nDenom}, scriptPubKey));
+        prevout = COutPoint(vChain.back(), 0);
+    }
+    BOOST_CHECK_EQUAL(wallet.GetRealOutpointPrivateSendRounds(COutPoint(vChain.back(), 0)), MAX_PRIVATESEND_ROUNDS);
+    for (size_t i = 0; i < vChain.size(); i++) {
+        BOOST_CHECK_EQUAL(wallet.GetRealOutpointPrivateSendRounds(COutPoint(vChain[i], 0)), std::min((int)i + 2, MAX_PRIVATESEND_ROUNDS));
+    }
+
+    BOOST_CHECK_EQUAL(wallet.GetRealOutpointPrivateSendRounds(COutPoint(tx5, 0)), 1);
+    BOOST_CHECK_EQUAL(wallet.GetRealOutpointPrivateSendRounds(COutPoint(tx4, 0)), 3);
+    BOOST_CHECK_EQUAL(wallet.GetRealOutpointPrivateSendRounds(COutPoint(tx3, 0)), 2);
+    BOOST_CHECK_EQUAL(wallet.GetRealOutpointPrivateSendRounds(COutPoint(tx2, 0)), 2);
+    BOOST_CHECK_EQUAL(wallet.GetRealOutpointPrivateSendRounds(COutPoint(tx1, 1)), 1);
+    BOOST_CHECK_EQUAL(wallet.GetRealOutpointPrivateSendRounds(COutPoint(tx0, 0)), -2);
+    BOOST_CHECK_EQUAL(wallet.GetRealOutpointPrivateSendRounds(COutPoint(tx0, 1)), 0);
+    BOOST_CHECK_EQUAL(wallet.GetRealOutpointPrivateSendRounds(COutPoint(tx6, 0)), 0);
+    BOOST_CHECK_EQUAL(wallet.GetRealOutpointPrivateSendRounds(COutPoint(tx6, 1)), -3);
+    BOOST_CHECK_EQUAL(wallet.GetRealOutpointPrivateSendRounds(COutPoint(GetRandHash(), 0)), -1);
+    BOOST_CHECK_EQUAL(wallet.GetRealOutpointPrivateSendRounds(COutPoint(tx1, 2)), -4);
+}
+
+BOOST_AUTO_TEST_CASE(privatesend_rounds_invalidation)
+{
+    CPrivateSend::InitStandardDenominations();
+    const CAmount nDenom = COIN + 1000;
+
+    CWallet wallet;
+    LOCK2(cs_main, wallet.cs_wallet);
+    CKey key;
+    key.MakeNewKey(true);
+    wallet.AddKeyPubKey(key, key.GetPubKey());
+    CScript scriptPubKey = GetScriptForDestination(key.GetPubKey().GetID());
+
+    // the parent of tx0 arrives after its descendants
+    CMutableTransaction txParent;
+    txParent.vin.emplace_back(COutPoint(GetRandHash(), 0));
+    txParent.vout.emplace_back(nDenom, scriptPubKey);
+    txParent.vout.emplace_back(nDenom, scriptPubKey);
+    uint256 tx0 = AddPrivateSendTx(wallet, {COutPoint(txParent.GetHash(), 0)}, {nDenom}, scriptPubKey);
+    uint256 tx2 = AddPrivateSendTx(wallet, {COutPoint(tx0, 0)}, {nDenom}, scriptPubKey);
+    BOOST_CHECK_EQUAL(wallet.GetRealOutpointPrivateSendRounds(COutPoint(tx2, 0)), 1);
+    wallet.AddToWallet(CWalletTx(&wallet, MakeTransactionRef(txParent)));
+    BOOST_CHECK_EQUAL(wallet.GetRealOutpointPrivateSendRounds(COutPoint(tx2, 0)), 2);
+
+    // disconnecting a block drops the cache
+    wallet.LoadPrivateSendRounds(COutPoint(tx2, 0), 7);
+    BOOST_CHECK_EQUAL(wallet.GetRealOutpointPrivateSendRounds(COutPoint(tx2, 0)), 7);
+    wallet.SyncTransaction(CTransaction(), chainActive.Tip(), CMainSignals::SYNC_TRANSACTION_NOT_IN_BLOCK);
+    BOOST_CHECK_EQUAL(wallet.GetRealOutpointPrivateSendRounds(COutPoint(tx2, 0)), 2);
+}
+
+BOOST_AUTO_TEST_CASE(privatesend_rounds_reload)
+{
+    CPrivateSend::InitStandardDenominations();
+    const CAmount nDenom = COIN + 1000;
+    const std::string strWalletFile = "wallet_psrounds_test.dat";
+    bool fFirstRun;
+
+    uint256 tx0, tx1;
+    COutPoint outpointUnknown(GetRandHash(), 0), outpointStale(GetRandHash(), 0);
+    {
+        CWallet wallet(strWalletFile);
+        BOOST_CHECK_EQUAL(wallet.LoadWallet(fFirstRun), DB_LOAD_OK);
+        LOCK2(cs_main, wallet.cs_wallet);
+        CKey key;
+        key.MakeNewKey(true);
+        wallet.AddKeyPubKey(key, key.GetPubKey());
+        CScript scriptPubKey = GetScriptForDestination(key.GetPubKey().GetID());
+
+        tx0 = AddPrivateSendTx(wallet, {COutPoint(GetRandHash(), 0)}, {nDenom, 10 * COIN}, scriptPubKey);
+        tx1 = AddPrivateSendTx(wallet, {COutPoint(tx0, 0)}, {nDenom}, scriptPubKey);
+        BOOST_CHECK_EQUAL(wallet.GetRealOutpointPrivateSendRounds(COutPoint(tx1, 0)), 1);
+
+        // the next load can only know these from the records
+        CWalletDB walletdb(strWalletFile);
+        BOOST_CHECK(walletdb.WritePrivateSendRounds(outpointUnknown, 0, 5));
+        BOOST_CHECK(walletdb.WritePrivateSendRounds(outpointStale, -1, 5));
+    }
+    {
+        CWallet wallet(strWalletFile);
+        BOOST_CHECK_EQUAL(wallet.LoadWallet(fFirstRun), DB_LOAD_OK);
+        LOCK2(cs_main, wallet.cs_wallet);
+        BOOST_CHECK_EQUAL(wallet.GetRealOutpointPrivateSendRounds(COutPoint(tx1, 0)), 1);
+        BOOST_CHECK_EQUAL(wallet.GetRealOutpointPrivateSendRounds(outpointUnknown), 5);
+        BOOST_CHECK_EQUAL(wallet.GetRealOutpointPrivateSendRounds(outpointStale), -1);
+
+        // invalidating only bumps the generation, the records are dropped by the next load
+        wallet.ClearPrivateSendRoundsCache();
+        BOOST_CHECK_EQUAL(wallet.GetRealOutpointPrivateSendRounds(outpointUnknown), -1);
+    }
+    {
+        CWallet wallet(strWalletFile);
+        BOOST_CHECK_EQUAL(wallet.LoadWallet(fFirstRun), DB_LOAD_OK);
+        LOCK2(cs_main, wallet.cs_wallet);
+        BOOST_CHECK_EQUAL(wallet.GetRealOutpointPrivateSendRounds(outpointUnknown), -1);
+        BOOST_CHECK_EQUAL(wallet.GetRealOutpointPrivateSendRounds(COutPoint(tx1, 0)), 1);
+    }
+}
+
 static int64_t AddTx(CWallet& wallet, uint32_t lockTime, int64_t mockTime, int64_t blockTime)
 {
     CMutableTransaction tx;
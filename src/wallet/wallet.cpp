@@ -12,6 +12,7 @@
 #include "wallet/coincontrol.h"
 #include "consensus/consensus.h"
 #include "consensus/validation.h"
+#include "init.h"
 #include "key.h"
 #include "keystore.h"
 #include "validation.h"
@@ -39,6 +40,9 @@
 #include "llmq/quorums_chainlocks.h"
 
 #include <assert.h>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
 
 #include <boost/algorithm/string/replace.hpp>
 #include <boost/filesystem.hpp>
@@ -49,6 +53,8 @@ CWallet* pwalletMain = NULL;
 CFeeRate payTxFee(DEFAULT_TRANSACTION_FEE);
 unsigned int nTxConfirmTarget = DEFAULT_TX_CONFIRM_TARGET;
 bool bSpendZeroConfChange = DEFAULT_SPEND_ZEROCONF_CHANGE;
+bool fWalletBalanceCheck = DEFAULT_WALLET_BALANCE_CHECK;
+int nRescanThreads = DEFAULT_RESCAN_THREADS;
 
 const char * DEFAULT_WALLET_DAT = "wallet.dat";
 
@@ -541,6 +547,10 @@ bool CWallet::ChangeWalletPassphrase(const SecureString& strOldWalletPassphrase,
 
 void CWallet::SetBestChain(const CBlockLocator& loc)
 {
+    // keep the point where the interrupted rescan stopped, so that the next start resumes from there
+    if (fRescanIncomplete)
+        return;
+
     CWalletDB walletdb(strWalletFile);
     walletdb.WriteBestBlock(loc);
 }
@@ -707,7 +717,7 @@ bool CWallet::IsSpent(const uint256& hash, unsigned int n) const
 void CWallet::AddToSpends(const COutPoint& outpoint, const uint256& wtxid)
 {
     mapTxSpends.insert(std::make_pair(outpoint, wtxid));
-    setWalletUTXO.erase(outpoint);
+    EraseWalletUTXO(outpoint);
 
     std::pair<TxSpends::iterator, TxSpends::iterator> range;
     range = mapTxSpends.equal_range(outpoint);
@@ -726,6 +736,108 @@ void CWallet::AddToSpends(const uint256& wtxid)
         AddToSpends(txin.prevout, wtxid);
 }
 
+CWallet::WalletUTXOType CWallet::GetWalletUTXOType(const CAmount& nValue)
+{
+    if (CPrivateSend::IsDenominatedAmount(nValue))
+        return WALLET_UTXO_DENOMINATED;
+    if (CPrivateSend::IsCollateralAmount(nValue))
+        return WALLET_UTXO_COLLATERAL;
+    if (nValue == 10000*COIN)
+        return WALLET_UTXO_MASTERNODE;
+    return WALLET_UTXO_OTHER;
+}
+
+void CWallet::AddWalletUTXO(const COutPoint& outpoint, const CAmount& nValue) const
+{
+    AssertLockHeld(cs_wallet);
+    setWalletUTXO.insert(outpoint);
+    setWalletUTXOByType[GetWalletUTXOType(nValue)].insert(outpoint);
+}
+
+void CWallet::EraseWalletUTXO(const COutPoint& outpoint) const
+{
+    AssertLockHeld(cs_wallet);
+    if (setWalletUTXO.erase(outpoint) == 0)
+        return;
+    for (auto& setByType : setWalletUTXOByType) {
+        if (setByType.erase(outpoint))
+            break;
+    }
+}
+
+void CWallet::ReaddWalletUTXOSpentBy(const CWalletTx& wtx)
+{
+    AssertLockHeld(cs_main);
+    AssertLockHeld(cs_wallet);
+
+    if (wtx.IsCoinBase())
+        return;
+
+    for (const auto& txin : wtx.tx->vin) {
+        auto it = mapWallet.find(txin.prevout.hash);
+        if (it == mapWallet.end() || txin.prevout.n >= it->second.tx->vout.size())
+            continue;
+        const CTxOut& txout = it->second.tx->vout[txin.prevout.n];
+        if (IsMine(txout) && !IsSpent(txin.prevout.hash, txin.prevout.n)) {
+            AddWalletUTXO(txin.prevout, txout.nValue);
+        }
+    }
+}
+
+void CWallet::RebuildWalletUTXO() const
+{
+    AssertLockHeld(cs_main);
+    AssertLockHeld(cs_wallet);
+
+    setWalletUTXO.clear();
+    for (auto& setByType : setWalletUTXOByType) {
+        setByType.clear();
+    }
+    for (const auto& pair : mapWallet) {
+        for (unsigned int i = 0; i < pair.second.tx->vout.size(); ++i) {
+            if (IsMine(pair.second.tx->vout[i]) && !IsSpent(pair.first, i)) {
+                AddWalletUTXO(COutPoint(pair.first, i), pair.second.tx->vout[i].nValue);
+            }
+        }
+    }
+    fWalletUTXODirty = false;
+}
+
+void CWallet::EnsureWalletUTXO() const
+{
+    if (fWalletUTXODirty)
+        RebuildWalletUTXO();
+}
+
+void CWallet::GetWalletUTXOCandidates(AvailableCoinsType nCoinType, std::vector<COutPoint>& vecRet) const
+{
+    AssertLockHeld(cs_wallet);
+
+    vecRet.clear();
+    switch (nCoinType) {
+    case ONLY_DENOMINATED:
+        vecRet.assign(setWalletUTXOByType[WALLET_UTXO_DENOMINATED].begin(), setWalletUTXOByType[WALLET_UTXO_DENOMINATED].end());
+        break;
+    case ONLY_NONDENOMINATED: {
+        // collaterals are not used here either
+        const auto& setOther = setWalletUTXOByType[WALLET_UTXO_OTHER];
+        const auto& setMasternode = setWalletUTXOByType[WALLET_UTXO_MASTERNODE];
+        vecRet.reserve(setOther.size() + setMasternode.size());
+        std::merge(setOther.begin(), setOther.end(), setMasternode.begin(), setMasternode.end(), std::back_inserter(vecRet));
+        break;
+    }
+    case ONLY_1000:
+        vecRet.assign(setWalletUTXOByType[WALLET_UTXO_MASTERNODE].begin(), setWalletUTXOByType[WALLET_UTXO_MASTERNODE].end());
+        break;
+    case ONLY_PRIVATESEND_COLLATERAL:
+        vecRet.assign(setWalletUTXOByType[WALLET_UTXO_COLLATERAL].begin(), setWalletUTXOByType[WALLET_UTXO_COLLATERAL].end());
+        break;
+    default:
+        vecRet.assign(setWalletUTXO.begin(), setWalletUTXO.end());
+        break;
+    }
+}
+
 bool CWallet::EncryptWallet(const SecureString& strWalletPassphrase)
 {
     if (IsCrypted())
@@ -1024,10 +1136,16 @@ void CWallet::MarkDirty()
         LOCK(cs_wallet);
         BOOST_FOREACH(PAIRTYPE(const uint256, CWalletTx)& item, mapWallet)
             item.second.MarkDirty();
+        // outputs may have become ours, e.g. through imported keys
+        fWalletUTXODirty = true;
     }
 
+    // inputs may have become ours as well, which changes the rounds of their descendants
+    ClearPrivateSendRoundsCache();
+
     fAnonymizableTallyCached = false;
     fAnonymizableTallyCachedNonDenom = false;
+    fBalanceTallyCached = false;
 }
 
 bool CWallet::AddToWallet(const CWalletTx& wtxIn, bool fFlushOnClose)
@@ -1051,10 +1169,16 @@ bool CWallet::AddToWallet(const CWalletTx& wtxIn, bool fFlushOnClose)
         wtx.nTimeSmart = ComputeTimeSmart(wtx);
         AddToSpends(hash);
 
+        // Rounds of wallet outputs spending this transaction were computed without it
+        TxSpends::const_iterator itSpend = mapTxSpends.lower_bound(COutPoint(hash, 0));
+        if (itSpend != mapTxSpends.end() && itSpend->first.hash == hash) {
+            ClearPrivateSendRoundsCache();
+        }
+
         auto mnList = deterministicMNManager->GetListAtChainTip();
         for(unsigned int i = 0; i < wtx.tx->vout.size(); ++i) {
             if (IsMine(wtx.tx->vout[i]) && !IsSpent(hash, i)) {
-                setWalletUTXO.insert(COutPoint(hash, i));
+                AddWalletUTXO(COutPoint(hash, i), wtx.tx->vout[i].nValue);
                 if (deterministicMNManager->IsProTxWithCollateral(wtx.tx, i) || mnList.HasMNByCollateral(COutPoint(hash, i))) {
                     LockCoin(COutPoint(hash, i));
                 }
@@ -1114,6 +1238,7 @@ bool CWallet::AddToWallet(const CWalletTx& wtxIn, bool fFlushOnClose)
 
     fAnonymizableTallyCached = false;
     fAnonymizableTallyCachedNonDenom = false;
+    fBalanceTallyCached = false;
 
     return true;
 }
@@ -1237,11 +1362,13 @@ bool CWallet::AbandonTransaction(const uint256& hashTx)
                 if (mapWallet.count(txin.prevout.hash))
                     mapWallet[txin.prevout.hash].MarkDirty();
             }
+            ReaddWalletUTXOSpentBy(wtx);
         }
     }
 
     fAnonymizableTallyCached = false;
     fAnonymizableTallyCachedNonDenom = false;
+    fBalanceTallyCached = false;
 
     return true;
 }
@@ -1301,11 +1428,13 @@ void CWallet::MarkConflicted(const uint256& hashBlock, const uint256& hashTx)
                 if (mapWallet.count(txin.prevout.hash))
                     mapWallet[txin.prevout.hash].MarkDirty();
             }
+            ReaddWalletUTXOSpentBy(wtx);
         }
     }
 
     fAnonymizableTallyCached = false;
     fAnonymizableTallyCachedNonDenom = false;
+    fBalanceTallyCached = false;
 }
 
 void CWallet::SyncTransaction(const CTransaction& tx, const CBlockIndex *pindex, int posInBlock)
@@ -1316,6 +1445,12 @@ void CWallet::SyncTransaction(const CTransaction& tx, const CBlockIndex *pindex,
     if (pindex != nullptr && (posInBlock == 0 || posInBlock == CMainSignals::SYNC_TRANSACTION_NOT_IN_BLOCK)) {
         fAnonymizableTallyCached = false;
         fAnonymizableTallyCachedNonDenom = false;
+        fBalanceTallyCached = false;
+    }
+
+    // a reorg can replace the transactions the cached PrivateSend rounds were computed from
+    if (pindex != nullptr && posInBlock == CMainSignals::SYNC_TRANSACTION_NOT_IN_BLOCK) {
+        ClearPrivateSendRoundsCache();
     }
 
     if (!AddToWalletIfInvolvingMe(tx, pindex, posInBlock, true))
@@ -1332,6 +1467,7 @@ void CWallet::SyncTransaction(const CTransaction& tx, const CBlockIndex *pindex,
 
     fAnonymizableTallyCached = false;
     fAnonymizableTallyCachedNonDenom = false;
+    fBalanceTallyCached = false;
 }
 
 
@@ -1368,86 +1504,155 @@ CAmount CWallet::GetDebit(const CTxIn &txin, const isminefilter& filter) const
     return 0;
 }
 
-// Recursively determine the rounds of a given input (How deep is the PrivateSend chain for a given input)
-int CWallet::GetRealOutpointPrivateSendRounds(const COutPoint& outpoint, int nRounds) const
+/**
+ * Rounds of a wallet output which don't depend on the transaction inputs. Returns false
+ * if they do, i.e. if all outputs of the transaction are denominated.
+ */
+static bool GetOutpointPrivateSendRoundsDirect(const CWalletTx& wtx, unsigned int nout, int& nRoundsRet)
 {
-    static std::map<uint256, CMutableTransaction> mDenomWtxes;
-
-    if(nRounds >= MAX_PRIVATESEND_ROUNDS) {
-        // there can only be MAX_PRIVATESEND_ROUNDS rounds max
-        return MAX_PRIVATESEND_ROUNDS - 1;
+    if (CPrivateSend::IsCollateralAmount(wtx.tx->vout[nout].nValue)) {
+        nRoundsRet = -3;
+        return true;
     }
 
-    uint256 hash = outpoint.hash;
-    unsigned int nout = outpoint.n;
+    //make sure the final output is non-denominate
+    if (!CPrivateSend::IsDenominatedAmount(wtx.tx->vout[nout].nValue)) { //NOT DENOM
+        nRoundsRet = -2;
+        return true;
+    }
 
-    const CWalletTx* wtx = GetWalletTx(hash);
-    if(wtx != NULL)
-    {
-        std::map<uint256, CMutableTransaction>::const_iterator mdwi = mDenomWtxes.find(hash);
-        if (mdwi == mDenomWtxes.end()) {
-            // not known yet, let's add it
-            LogPrint("privatesend", "GetRealOutpointPrivateSendRounds INSERTING %s\n", hash.ToString());
-            mDenomWtxes[hash] = CMutableTransaction(*wtx);
-        } else if(mDenomWtxes[hash].vout[nout].nRounds != -10) {
-            // found and it's not an initial value, just return it
-            return mDenomWtxes[hash].vout[nout].nRounds;
+    // this one is denominated but there is another non-denominated output found in the same tx
+    for (const auto& out : wtx.tx->vout) {
+        if (!CPrivateSend::IsDenominatedAmount(out.nValue)) {
+            nRoundsRet = 0;
+            return true;
         }
+    }
+
+    return false;
+}
 
+// Determine the rounds of a given input (How deep is the PrivateSend chain for a given input).
+// Outpoints which are not cached yet are computed inputs first in one pass over the part of
+// the wallet they depend on, and stored in the wallet database so they survive restarts.
+int CWallet::GetRealOutpointPrivateSendRounds(const COutPoint& outpoint) const
+{
+    LOCK(cs_wallet);
 
-        // bounds check
-        if (nout >= wtx->tx->vout.size()) {
-            // should never actually hit this
-            LogPrint("privatesend", "GetRealOutpointPrivateSendRounds UPDATED   %s %3d %3d\n", hash.ToString(), nout, -4);
-            return -4;
-        }
+    auto itCached = mapOutpointRoundsCache.find(outpoint);
+    if (itCached != mapOutpointRoundsCache.end()) {
+        return itCached->second;
+    }
 
-        if (CPrivateSend::IsCollateralAmount(wtx->tx->vout[nout].nValue)) {
-            mDenomWtxes[hash].vout[nout].nRounds = -3;
-            LogPrint("privatesend", "GetRealOutpointPrivateSendRounds UPDATED   %s %3d %3d\n", hash.ToString(), nout, mDenomWtxes[hash].vout[nout].nRounds);
-            return mDenomWtxes[hash].vout[nout].nRounds;
+    const CWalletTx* wtx = GetWalletTx(outpoint.hash);
+    if (wtx == NULL) {
+        return -1;
+    }
+    if (outpoint.n >= wtx->tx->vout.size()) {
+        // should never actually hit this
+        return -4;
+    }
+
+    std::vector<std::pair<COutPoint, int> > vecComputed;
+
+    // depth-first, an outpoint is computed once all of its inputs are (second == true)
+    std::vector<std::pair<COutPoint, bool> > vecStack;
+    vecStack.emplace_back(outpoint, false);
+    while (!vecStack.empty()) {
+        const COutPoint current = vecStack.back().first;
+        const bool fInputsDone = vecStack.back().second;
+
+        if (mapOutpointRoundsCache.count(current)) {
+            vecStack.pop_back();
+            continue;
         }
 
-        //make sure the final output is non-denominate
-        if (!CPrivateSend::IsDenominatedAmount(wtx->tx->vout[nout].nValue)) { //NOT DENOM
-            mDenomWtxes[hash].vout[nout].nRounds = -2;
-            LogPrint("privatesend", "GetRealOutpointPrivateSendRounds UPDATED   %s %3d %3d\n", hash.ToString(), nout, mDenomWtxes[hash].vout[nout].nRounds);
-            return mDenomWtxes[hash].vout[nout].nRounds;
+        const CWalletTx* pcoin = GetWalletTx(current.hash);
+        if (pcoin == NULL || current.n >= pcoin->tx->vout.size()) {
+            vecStack.pop_back();
+            continue;
         }
 
-        bool fAllDenoms = true;
-        for (const auto& out : wtx->tx->vout) {
-            fAllDenoms = fAllDenoms && CPrivateSend::IsDenominatedAmount(out.nValue);
+        int nRoundsResult;
+        if (GetOutpointPrivateSendRoundsDirect(*pcoin, current.n, nRoundsResult)) {
+            vecStack.pop_back();
+            mapOutpointRoundsCache.emplace(current, nRoundsResult);
+            vecComputed.emplace_back(current, nRoundsResult);
+            continue;
         }
 
-        // this one is denominated but there is another non-denominated output found in the same tx
-        if (!fAllDenoms) {
-            mDenomWtxes[hash].vout[nout].nRounds = 0;
-            LogPrint("privatesend", "GetRealOutpointPrivateSendRounds UPDATED   %s %3d %3d\n", hash.ToString(), nout, mDenomWtxes[hash].vout[nout].nRounds);
-            return mDenomWtxes[hash].vout[nout].nRounds;
+        // only denoms here so let's look up
+        if (!fInputsDone) {
+            vecStack.back().second = true;
+            for (const auto& txinNext : pcoin->tx->vin) {
+                if (IsMine(txinNext) && !mapOutpointRoundsCache.count(txinNext.prevout)) {
+                    vecStack.emplace_back(txinNext.prevout, false);
+                }
+            }
+            continue;
         }
+        vecStack.pop_back();
 
         int nShortest = -10; // an initial value, should be no way to get this by calculations
         bool fDenomFound = false;
-        // only denoms here so let's look up
-        for (const auto& txinNext : wtx->tx->vin) {
-            if (IsMine(txinNext)) {
-                int n = GetRealOutpointPrivateSendRounds(txinNext.prevout, nRounds + 1);
-                // denom found, find the shortest chain or initially assign nShortest with the first found value
-                if(n >= 0 && (n < nShortest || nShortest == -10)) {
-                    nShortest = n;
-                    fDenomFound = true;
-                }
+        for (const auto& txinNext : pcoin->tx->vin) {
+            if (!IsMine(txinNext)) continue;
+            auto it = mapOutpointRoundsCache.find(txinNext.prevout);
+            if (it == mapOutpointRoundsCache.end()) continue;
+            int n = it->second;
+            // denom found, find the shortest chain or initially assign nShortest with the first found value
+            if(n >= 0 && (n < nShortest || nShortest == -10)) {
+                nShortest = n;
+                fDenomFound = true;
             }
         }
-        mDenomWtxes[hash].vout[nout].nRounds = fDenomFound
+        nRoundsResult = fDenomFound
                 ? (nShortest >= MAX_PRIVATESEND_ROUNDS - 1 ? MAX_PRIVATESEND_ROUNDS : nShortest + 1) // good, we a +1 to the shortest one but only MAX_PRIVATESEND_ROUNDS rounds max allowed
                 : 0;            // too bad, we are the fist one in that chain
-        LogPrint("privatesend", "GetRealOutpointPrivateSendRounds UPDATED   %s %3d %3d\n", hash.ToString(), nout, mDenomWtxes[hash].vout[nout].nRounds);
-        return mDenomWtxes[hash].vout[nout].nRounds;
+        mapOutpointRoundsCache.emplace(current, nRoundsResult);
+        vecComputed.emplace_back(current, nRoundsResult);
+    }
+
+    if (fFileBacked && !vecComputed.empty()) {
+        CWalletDB walletdb(strWalletFile, "r+", false);
+        for (const auto& pair : vecComputed) {
+            walletdb.WritePrivateSendRounds(pair.first, nPrivateSendRoundsGeneration, pair.second);
+        }
     }
+    LogPrint("privatesend", "GetRealOutpointPrivateSendRounds -- %s: computed %d outpoints\n", outpoint.ToStringShort(), vecComputed.size());
 
-    return nRounds - 1;
+    itCached = mapOutpointRoundsCache.find(outpoint);
+    return itCached != mapOutpointRoundsCache.end() ? itCached->second : -4;
+}
+
+void CWallet::LoadPrivateSendRounds(const COutPoint& outpoint, int nRounds)
+{
+    LOCK(cs_wallet);
+    mapOutpointRoundsCache[outpoint] = nRounds;
+}
+
+void CWallet::LoadPrivateSendRoundsGeneration(int nGeneration)
+{
+    LOCK(cs_wallet);
+    nPrivateSendRoundsGeneration = nGeneration;
+}
+
+void CWallet::ClearPrivateSendRoundsCache()
+{
+    LOCK(cs_wallet);
+
+    // every record of the current generation is in memory, so there is nothing on disk to invalidate either
+    if (mapOutpointRoundsCache.empty())
+        return;
+
+    // This runs under cs_main on every reorg, so don't erase the records one by one. Bumping the
+    // generation marks them all stale, they are overwritten when recomputed or dropped on the next load.
+    nPrivateSendRoundsGeneration++;
+    if (fFileBacked) {
+        CWalletDB walletdb(strWalletFile, "r+", false);
+        walletdb.WritePrivateSendRoundsGeneration(nPrivateSendRoundsGeneration);
+    }
+    mapOutpointRoundsCache.clear();
 }
 
 // respect current settings
@@ -1820,56 +2025,283 @@ void CWalletTx::GetAccountAmounts(const std::string& strAccount, CAmount& nRecei
     }
 }
 
+namespace {
+
+/**
+ * Read-only copy of the parts of a keystore that ::IsMine looks at. CWallet::HaveKey
+ * takes cs_wallet, which is held for the whole rescan, so rescan workers match
+ * scripts against this copy instead.
+ */
+class CKeyStoreSnapshot : public CKeyStore
+{
+public:
+    std::set<CKeyID> setKeys;
+    ScriptMap mapScripts;
+    WatchOnlySet setWatchOnly;
+
+    bool AddKeyPubKey(const CKey& key, const CPubKey& pubkey) override { return false; }
+    bool HaveKey(const CKeyID& address) const override { return setKeys.count(address) > 0; }
+    bool GetKey(const CKeyID& address, CKey& keyOut) const override { return false; }
+    void GetKeys(std::set<CKeyID>& setAddress) const override { setAddress = setKeys; }
+    bool GetPubKey(const CKeyID& address, CPubKey& vchPubKeyOut) const override { return false; }
+
+    bool AddCScript(const CScript& redeemScript) override { return false; }
+    bool HaveCScript(const CScriptID& hash) const override { return mapScripts.count(hash) > 0; }
+    bool GetCScript(const CScriptID& hash, CScript& redeemScriptOut) const override
+    {
+        ScriptMap::const_iterator mi = mapScripts.find(hash);
+        if (mi == mapScripts.end())
+            return false;
+        redeemScriptOut = mi->second;
+        return true;
+    }
+
+    bool AddWatchOnly(const CScript& dest) override { return false; }
+    bool RemoveWatchOnly(const CScript& dest) override { return false; }
+    bool HaveWatchOnly(const CScript& dest) const override { return setWatchOnly.count(dest) > 0; }
+    bool HaveWatchOnly() const override { return !setWatchOnly.empty(); }
+};
+
+/**
+ * Reads the blocks of a rescan from disk and matches their outputs against a
+ * keystore on worker threads. Workers stay at most RESCAN_PREFETCH_BLOCKS ahead
+ * of the consumer, which picks up the results in chain order via Wait/Release.
+ */
+class CRescanPipeline
+{
+public:
+    struct Block
+    {
+        bool fRead{false};
+        CBlock block;
+        //! per transaction: whether any output is ours
+        std::vector<bool> vfMine;
+    };
+
+private:
+    const std::vector<CBlockIndex*>& vIndex;
+    const CKeyStore& keystore;
+    const Consensus::Params& consensusParams;
+
+    std::vector<Block> vSlots;
+    std::vector<bool> vfSlotReady;
+
+    std::mutex cs;
+    std::condition_variable cvReady;
+    std::condition_variable cvReleased;
+    //! next block to hand out to a worker
+    size_t nNext{0};
+    //! number of blocks released by the consumer
+    size_t nReleased{0};
+    bool fStop{false};
+
+    std::vector<std::thread> vThreads;
+
+    void Work()
+    {
+        RenameThread("alterdot-rescan");
+
+        while (true) {
+            size_t i;
+            {
+                std::unique_lock<std::mutex> lock(cs);
+                cvReleased.wait(lock, [this] { return fStop || nNext >= vIndex.size() || nNext < nReleased + vSlots.size(); });
+                if (fStop || nNext >= vIndex.size())
+                    return;
+                i = nNext++;
+            }
+
+            Block& slot = vSlots[i % vSlots.size()];
+            slot.block.SetNull();
+            slot.vfMine.clear();
+            slot.fRead = ReadBlockFromDisk(slot.block, vIndex[i], consensusParams);
+            if (slot.fRead) {
+                slot.vfMine.reserve(slot.block.vtx.size());
+                for (const auto& tx : slot.block.vtx) {
+                    bool fMine = false;
+                    for (const CTxOut& txout : tx->vout) {
+                        if (::IsMine(keystore, txout.scriptPubKey) != ISMINE_NO) {
+                            fMine = true;
+                            break;
+                        }
+                    }
+                    slot.vfMine.push_back(fMine);
+                }
+            }
+
+            {
+                std::lock_guard<std::mutex> lock(cs);
+                vfSlotReady[i % vSlots.size()] = true;
+            }
+            cvReady.notify_all();
+        }
+    }
+
+public:
+    CRescanPipeline(const std::vector<CBlockIndex*>& vIndexIn, const CKeyStore& keystoreIn, const Consensus::Params& consensusParamsIn, int nThreads) :
+        vIndex(vIndexIn),
+        keystore(keystoreIn),
+        consensusParams(consensusParamsIn)
+    {
+        if (nThreads <= 0)
+            nThreads = GetNumCores();
+        nThreads = std::max(1, std::min(nThreads, MAX_RESCAN_THREADS));
+        nThreads = std::min((size_t)nThreads, vIndex.size());
+
+        vSlots.resize(std::min((size_t)RESCAN_PREFETCH_BLOCKS, vIndex.size()));
+        vfSlotReady.resize(vSlots.size(), false);
+
+        for (int i = 0; i < nThreads; i++) {
+            vThreads.emplace_back([this] { Work(); });
+        }
+    }
+
+    ~CRescanPipeline()
+    {
+        {
+            std::lock_guard<std::mutex> lock(cs);
+            fStop = true;
+        }
+        cvReleased.notify_all();
+        for (auto& thread : vThreads) {
+            thread.join();
+        }
+    }
+
+    //! Blocks until block i has been read and matched
+    const Block& Wait(size_t i)
+    {
+        std::unique_lock<std::mutex> lock(cs);
+        cvReady.wait(lock, [this, i] { return (bool)vfSlotReady[i % vSlots.size()]; });
+        return vSlots[i % vSlots.size()];
+    }
+
+    //! Hands the slot of block i, which must be the oldest unreleased one, back to the workers
+    void Release(size_t i)
+    {
+        {
+            std::lock_guard<std::mutex> lock(cs);
+            assert(i == nReleased);
+            vfSlotReady[i % vSlots.size()] = false;
+            nReleased++;
+        }
+        cvReleased.notify_all();
+    }
+};
+
+} // namespace
+
+/**
+ * Whether AddToWalletIfInvolvingMe has to look at tx even if none of its outputs
+ * are ours: the wallet already has it, or it spends or conflicts with outputs of
+ * wallet transactions.
+ */
+bool CWallet::IsKnownOrSpendsKnown(const CTransaction& tx) const
+{
+    AssertLockHeld(cs_wallet);
+
+    if (mapWallet.count(tx.GetHash()))
+        return true;
+    for (const CTxIn& txin : tx.vin) {
+        if (mapWallet.count(txin.prevout.hash) || mapTxSpends.count(txin.prevout))
+            return true;
+    }
+    return false;
+}
+
 /**
  * Scan the block chain (starting in pindexStart) for transactions
  * from or to us. If fUpdate is true, found transactions that already
  * exist in the wallet will be updated.
  *
+ * Blocks are read and matched against a snapshot of the keystore by
+ * -rescanthreads worker threads, while transactions are added to the
+ * wallet in chain order on the calling thread. The scan stops early on
+ * AbortRescan or shutdown, in which case ppindexInterrupted (if given) is
+ * set to the first block that wasn't scanned. Otherwise it is set to NULL.
+ *
  * Returns pointer to the first block in the last contiguous range that was
  * successfully scanned.
  *
  */
-CBlockIndex* CWallet::ScanForWalletTransactions(CBlockIndex* pindexStart, bool fUpdate)
+CBlockIndex* CWallet::ScanForWalletTransactions(CBlockIndex* pindexStart, bool fUpdate, CBlockIndex** ppindexInterrupted)
 {
     CBlockIndex* ret = nullptr;
+    if (ppindexInterrupted)
+        *ppindexInterrupted = nullptr;
     int64_t nNow = GetTime();
     const CChainParams& chainParams = Params();
 
     CBlockIndex* pindex = pindexStart;
     {
         LOCK2(cs_main, cs_wallet);
+        fAbortRescan = false;
+        fScanningWallet = true;
 
         // no need to read and scan block, if block was created before
         // our wallet birthday (as adjusted for block time variability)
         while (pindex && nTimeFirstKey && (pindex->GetBlockTime() < (nTimeFirstKey - TIMESTAMP_WINDOW)))
             pindex = chainActive.Next(pindex);
 
+        // the chain can't change while we hold cs_main
+        std::vector<CBlockIndex*> vIndex;
+        for (CBlockIndex* pindexScan = pindex; pindexScan; pindexScan = chainActive.Next(pindexScan))
+            vIndex.push_back(pindexScan);
+
+        // nor can the keystore while we hold cs_wallet
+        CKeyStoreSnapshot keystore;
+        {
+            LOCK(cs_KeyStore);
+            GetKeys(keystore.setKeys);
+            for (const auto& pair : mapHdPubKeys)
+                keystore.setKeys.insert(pair.first);
+            keystore.mapScripts = mapScripts;
+            keystore.setWatchOnly = setWatchOnly;
+        }
+
         ShowProgress(_("Rescanning..."), 0); // show rescan progress in GUI as dialog or on splashscreen, if -rescan on startup
         double dProgressStart = GuessVerificationProgress(chainParams.TxData(), pindex);
         double dProgressTip = GuessVerificationProgress(chainParams.TxData(), chainActive.Tip());
-        while (pindex)
+        size_t i = 0;
         {
-            if (pindex->nHeight % 100 == 0 && dProgressTip - dProgressStart > 0.0)
-                ShowProgress(_("Rescanning..."), std::max(1, std::min(99, (int)((GuessVerificationProgress(chainParams.TxData(), pindex) - dProgressStart) / (dProgressTip - dProgressStart) * 100))));
-            if (GetTime() >= nNow + 60) {
-                nNow = GetTime();
-                LogPrintf("Still rescanning. At block %d. Progress=%f\n", pindex->nHeight, GuessVerificationProgress(chainParams.TxData(), pindex));
-            }
-
-            CBlock block;
-            if (ReadBlockFromDisk(block, pindex, Params().GetConsensus())) {
-                for (size_t posInBlock = 0; posInBlock < block.vtx.size(); ++posInBlock) {
-                    AddToWalletIfInvolvingMe(*block.vtx[posInBlock], pindex, posInBlock, fUpdate);
+            CRescanPipeline pipeline(vIndex, keystore, chainParams.GetConsensus(), nRescanThreads);
+            for (; i < vIndex.size() && !fAbortRescan && !ShutdownRequested(); i++)
+            {
+                pindex = vIndex[i];
+                if (pindex->nHeight % 100 == 0 && dProgressTip - dProgressStart > 0.0)
+                    ShowProgress(_("Rescanning..."), std::max(1, std::min(99, (int)((GuessVerificationProgress(chainParams.TxData(), pindex) - dProgressStart) / (dProgressTip - dProgressStart) * 100))));
+                if (GetTime() >= nNow + 60) {
+                    nNow = GetTime();
+                    LogPrintf("Still rescanning. At block %d. Progress=%f\n", pindex->nHeight, GuessVerificationProgress(chainParams.TxData(), pindex));
                 }
-                if (!ret) {
-                    ret = pindex;
+
+                const CRescanPipeline::Block& scanned = pipeline.Wait(i);
+                if (scanned.fRead) {
+                    for (size_t posInBlock = 0; posInBlock < scanned.block.vtx.size(); ++posInBlock) {
+                        const CTransaction& tx = *scanned.block.vtx[posInBlock];
+                        if (scanned.vfMine[posInBlock] || IsKnownOrSpendsKnown(tx))
+                            AddToWalletIfInvolvingMe(tx, pindex, posInBlock, fUpdate);
+                    }
+                    if (!ret) {
+                        ret = pindex;
+                    }
+                } else {
+                    ret = nullptr;
                 }
+                pipeline.Release(i);
+            }
+        }
+        if (i < vIndex.size()) {
+            if (ppindexInterrupted)
+                *ppindexInterrupted = vIndex[i];
+            if (fAbortRescan) {
+                LogPrintf("Rescan aborted at block %d. Progress=%f\n", vIndex[i]->nHeight, GuessVerificationProgress(chainParams.TxData(), vIndex[i]));
             } else {
-                ret = nullptr;
+                LogPrintf("Rescan interrupted by shutdown request at block %d. Progress=%f\n", vIndex[i]->nHeight, GuessVerificationProgress(chainParams.TxData(), vIndex[i]));
             }
-            pindex = chainActive.Next(pindex);
         }
         ShowProgress(_("Rescanning..."), 100); // hide progress dialog in GUI
+        fScanningWallet = false;
     }
     return ret;
 }
@@ -2296,26 +2728,108 @@ void CWallet::ResendWalletTransactions(int64_t nBestBlockTime, CConnman* connman
  */
 
 
-CAmount CWallet::GetBalance() const
+bool CWallet::CBalanceTally::operator==(const CBalanceTally& other) const
 {
-    CAmount nTotal = 0;
-    {
-        LOCK2(cs_main, cs_wallet);
-        for (std::map<uint256, CWalletTx>::const_iterator it = mapWallet.begin(); it != mapWallet.end(); ++it)
-        {
-            const CWalletTx* pcoin = &(*it).second;
-            if (pcoin->IsTrusted())
-                nTotal += pcoin->GetAvailableCredit();
+    return nBalance == other.nBalance &&
+           nUnconfirmed == other.nUnconfirmed &&
+           nImmature == other.nImmature &&
+           nWatchOnly == other.nWatchOnly &&
+           nUnconfirmedWatchOnly == other.nUnconfirmedWatchOnly &&
+           nImmatureWatchOnly == other.nImmatureWatchOnly &&
+           nAnonymized == other.nAnonymized &&
+           nNormalizedAnonymized == other.nNormalizedAnonymized &&
+           nDenominated == other.nDenominated &&
+           nDenominatedUnconfirmed == other.nDenominatedUnconfirmed;
+}
+
+void CWallet::TallyBalances(CBalanceTally& tallyRet) const
+{
+    AssertLockHeld(cs_main);
+    AssertLockHeld(cs_wallet);
+
+    tallyRet = CBalanceTally();
+    tallyRet.nPrivateSendRounds = privateSendClient.nPrivateSendRounds;
+
+    for (const auto& pair : mapWallet) {
+        const CWalletTx* pcoin = &pair.second;
+        if (pcoin->IsTrusted()) {
+            tallyRet.nBalance += pcoin->GetAvailableCredit();
+            tallyRet.nWatchOnly += pcoin->GetAvailableWatchOnlyCredit();
+        } else if (pcoin->GetDepthInMainChain() == 0 && !pcoin->IsLockedByInstantSend() && pcoin->InMempool()) {
+            tallyRet.nUnconfirmed += pcoin->GetAvailableCredit();
+            tallyRet.nUnconfirmedWatchOnly += pcoin->GetAvailableWatchOnlyCredit();
         }
+        tallyRet.nImmature += pcoin->GetImmatureCredit();
+        tallyRet.nImmatureWatchOnly += pcoin->GetImmatureWatchOnlyCredit();
     }
 
-    return nTotal;
+    if (fLiteMode) return;
+
+    EnsureWalletUTXO();
+
+    std::set<uint256> setWalletTxesCounted;
+    for (const auto& outpoint : setWalletUTXO) {
+        const auto it = mapWallet.find(outpoint.hash);
+        if (it == mapWallet.end()) continue;
+
+        // credits are per transaction, count each of them once
+        if (setWalletTxesCounted.emplace(outpoint.hash).second) {
+            if (it->second.IsTrusted())
+                tallyRet.nAnonymized += it->second.GetAnonymizedCredit();
+            tallyRet.nDenominated += it->second.GetDenominatedCredit(false);
+            tallyRet.nDenominatedUnconfirmed += it->second.GetDenominatedCredit(true);
+        }
+
+        // Note: calculated including unconfirmed,
+        // that's ok as long as we use it for informational purposes only
+        CAmount nValue = it->second.tx->vout[outpoint.n].nValue;
+        if (!CPrivateSend::IsDenominatedAmount(nValue)) continue;
+        if (it->second.GetDepthInMainChain() < 0) continue;
+
+        int nRounds = GetCappedOutpointPrivateSendRounds(outpoint);
+        tallyRet.nNormalizedAnonymized += nValue * nRounds / tallyRet.nPrivateSendRounds;
+    }
 }
 
-CAmount CWallet::GetAnonymizableBalance(bool fSkipDenominated, bool fSkipUnconfirmed) const
+CWallet::CBalanceTally& CWallet::GetBalanceTally() const
 {
-    if(fLiteMode) return 0;
+    AssertLockHeld(cs_main);
+    AssertLockHeld(cs_wallet);
+
+    if (fBalanceTallyCached && balanceTallyCached.nPrivateSendRounds != privateSendClient.nPrivateSendRounds) {
+        fBalanceTallyCached = false;
+    }
+
+    if (fBalanceTallyCached && !fWalletBalanceCheck) {
+        return balanceTallyCached;
+    }
+
+    CBalanceTally tally;
+    TallyBalances(tally);
+    if (fBalanceTallyCached && !(tally == balanceTallyCached)) {
+        LogPrintf("CWallet::%s -- ERROR: cached balances diverged from the wallet: balance %d/%d, unconfirmed %d/%d, immature %d/%d, anonymized %d/%d, denominated %d/%d\n", __func__,
+                  balanceTallyCached.nBalance, tally.nBalance, balanceTallyCached.nUnconfirmed, tally.nUnconfirmed,
+                  balanceTallyCached.nImmature, tally.nImmature, balanceTallyCached.nAnonymized, tally.nAnonymized,
+                  balanceTallyCached.nDenominated, tally.nDenominated);
+    }
+    if (fBalanceTallyCached) {
+        // keep the anonymizable balances, they are cross-checked on their own
+        tally.mapAnonymizable.swap(balanceTallyCached.mapAnonymizable);
+    }
+    balanceTallyCached = std::move(tally);
+    fBalanceTallyCached = true;
+
+    return balanceTallyCached;
+}
 
+CAmount CWallet::GetBalance() const
+{
+    LOCK2(cs_main, cs_wallet);
+    return GetBalanceTally().nBalance;
+}
+
+CAmount CWallet::TallyAnonymizableBalance(bool fSkipDenominated, bool fSkipUnconfirmed) const
+{
     std::vector<CompactTallyItem> vecTally;
     if(!SelectCoinsGroupedByAddresses(vecTally, fSkipDenominated, true, fSkipUnconfirmed)) return 0;
 
@@ -2334,28 +2848,39 @@ CAmount CWallet::GetAnonymizableBalance(bool fSkipDenominated, bool fSkipUnconfi
     return nTotal;
 }
 
-CAmount CWallet::GetAnonymizedBalance() const
+CAmount CWallet::GetAnonymizableBalance(bool fSkipDenominated, bool fSkipUnconfirmed) const
 {
     if(fLiteMode) return 0;
 
-    CAmount nTotal = 0;
-
     LOCK2(cs_main, cs_wallet);
 
-    std::set<uint256> setWalletTxesCounted;
-    for (const auto& outpoint : setWalletUTXO) {
-
-        if (!setWalletTxesCounted.emplace(outpoint.hash).second) continue;
-
-        const auto it = mapWallet.find(outpoint.hash);
-        if (it == mapWallet.end() || !it->second.IsTrusted()) continue;
-
-        nTotal += it->second.GetAnonymizedCredit();
+    auto& mapAnonymizable = GetBalanceTally().mapAnonymizable;
+    auto key = std::make_pair(fSkipDenominated, fSkipUnconfirmed);
+    auto it = mapAnonymizable.find(key);
+    if (it != mapAnonymizable.end()) {
+        if (fWalletBalanceCheck) {
+            CAmount nTotal = TallyAnonymizableBalance(fSkipDenominated, fSkipUnconfirmed);
+            if (nTotal != it->second) {
+                LogPrintf("CWallet::%s -- ERROR: cached anonymizable balance diverged from the wallet: %d/%d\n", __func__, it->second, nTotal);
+                it->second = nTotal;
+            }
+        }
+        return it->second;
     }
 
+    CAmount nTotal = TallyAnonymizableBalance(fSkipDenominated, fSkipUnconfirmed);
+    mapAnonymizable.emplace(key, nTotal);
     return nTotal;
 }
 
+CAmount CWallet::GetAnonymizedBalance() const
+{
+    if(fLiteMode) return 0;
+
+    LOCK2(cs_main, cs_wallet);
+    return GetBalanceTally().nAnonymized;
+}
+
 // Note: calculated including unconfirmed,
 // that's ok as long as we use it for informational purposes only
 float CWallet::GetAverageAnonymizedRounds() const
@@ -2366,6 +2891,7 @@ float CWallet::GetAverageAnonymizedRounds() const
     int nCount = 0;
 
     LOCK2(cs_main, cs_wallet);
+    EnsureWalletUTXO();
     for (const auto& outpoint : setWalletUTXO) {
         if(!IsDenominated(outpoint)) continue;
 
@@ -2384,117 +2910,47 @@ CAmount CWallet::GetNormalizedAnonymizedBalance() const
 {
     if(fLiteMode) return 0;
 
-    CAmount nTotal = 0;
-
     LOCK2(cs_main, cs_wallet);
-    for (const auto& outpoint : setWalletUTXO) {
-        const auto it = mapWallet.find(outpoint.hash);
-        if (it == mapWallet.end()) continue;
-
-        CAmount nValue = it->second.tx->vout[outpoint.n].nValue;
-        if (!CPrivateSend::IsDenominatedAmount(nValue)) continue;
-        if (it->second.GetDepthInMainChain() < 0) continue;
-
-        int nRounds = GetCappedOutpointPrivateSendRounds(outpoint);
-        nTotal += nValue * nRounds / privateSendClient.nPrivateSendRounds;
-    }
-
-    return nTotal;
+    return GetBalanceTally().nNormalizedAnonymized;
 }
 
 CAmount CWallet::GetDenominatedBalance(bool unconfirmed) const
 {
     if(fLiteMode) return 0;
 
-    CAmount nTotal = 0;
-
     LOCK2(cs_main, cs_wallet);
-
-    std::set<uint256> setWalletTxesCounted;
-    for (const auto& outpoint : setWalletUTXO) {
-        if (!setWalletTxesCounted.emplace(outpoint.hash).second) continue;
-
-        const auto it = mapWallet.find(outpoint.hash);
-        if (it == mapWallet.end()) continue;
-
-        nTotal += it->second.GetDenominatedCredit(unconfirmed);
-    }
-
-    return nTotal;
+    const CBalanceTally& tally = GetBalanceTally();
+    return unconfirmed ? tally.nDenominatedUnconfirmed : tally.nDenominated;
 }
 
 CAmount CWallet::GetUnconfirmedBalance() const
 {
-    CAmount nTotal = 0;
-    {
-        LOCK2(cs_main, cs_wallet);
-        for (std::map<uint256, CWalletTx>::const_iterator it = mapWallet.begin(); it != mapWallet.end(); ++it)
-        {
-            const CWalletTx* pcoin = &(*it).second;
-            if (!pcoin->IsTrusted() && pcoin->GetDepthInMainChain() == 0 && !pcoin->IsLockedByInstantSend() && pcoin->InMempool())
-                nTotal += pcoin->GetAvailableCredit();
-        }
-    }
-    return nTotal;
+    LOCK2(cs_main, cs_wallet);
+    return GetBalanceTally().nUnconfirmed;
 }
 
 CAmount CWallet::GetImmatureBalance() const
 {
-    CAmount nTotal = 0;
-    {
-        LOCK2(cs_main, cs_wallet);
-        for (std::map<uint256, CWalletTx>::const_iterator it = mapWallet.begin(); it != mapWallet.end(); ++it)
-        {
-            const CWalletTx* pcoin = &(*it).second;
-            nTotal += pcoin->GetImmatureCredit();
-        }
-    }
-    return nTotal;
+    LOCK2(cs_main, cs_wallet);
+    return GetBalanceTally().nImmature;
 }
 
 CAmount CWallet::GetWatchOnlyBalance() const
 {
-    CAmount nTotal = 0;
-    {
-        LOCK2(cs_main, cs_wallet);
-        for (std::map<uint256, CWalletTx>::const_iterator it = mapWallet.begin(); it != mapWallet.end(); ++it)
-        {
-            const CWalletTx* pcoin = &(*it).second;
-            if (pcoin->IsTrusted())
-                nTotal += pcoin->GetAvailableWatchOnlyCredit();
-        }
-    }
-
-    return nTotal;
+    LOCK2(cs_main, cs_wallet);
+    return GetBalanceTally().nWatchOnly;
 }
 
 CAmount CWallet::GetUnconfirmedWatchOnlyBalance() const
 {
-    CAmount nTotal = 0;
-    {
-        LOCK2(cs_main, cs_wallet);
-        for (std::map<uint256, CWalletTx>::const_iterator it = mapWallet.begin(); it != mapWallet.end(); ++it)
-        {
-            const CWalletTx* pcoin = &(*it).second;
-            if (!pcoin->IsTrusted() && pcoin->GetDepthInMainChain() == 0 && !pcoin->IsLockedByInstantSend() && pcoin->InMempool())
-                nTotal += pcoin->GetAvailableWatchOnlyCredit();
-        }
-    }
-    return nTotal;
+    LOCK2(cs_main, cs_wallet);
+    return GetBalanceTally().nUnconfirmedWatchOnly;
 }
 
 CAmount CWallet::GetImmatureWatchOnlyBalance() const
 {
-    CAmount nTotal = 0;
-    {
-        LOCK2(cs_main, cs_wallet);
-        for (std::map<uint256, CWalletTx>::const_iterator it = mapWallet.begin(); it != mapWallet.end(); ++it)
-        {
-            const CWalletTx* pcoin = &(*it).second;
-            nTotal += pcoin->GetImmatureWatchOnlyCredit();
-        }
-    }
-    return nTotal;
+    LOCK2(cs_main, cs_wallet);
+    return GetBalanceTally().nImmatureWatchOnly;
 }
 
 void CWallet::AvailableCoins(std::vector<COutput>& vCoins, bool fOnlySafe, const CCoinControl *coinControl, bool fIncludeZeroValue, AvailableCoinsType nCoinType, bool fUseInstantSend) const
@@ -2505,59 +2961,68 @@ void CWallet::AvailableCoins(std::vector<COutput>& vCoins, bool fOnlySafe, const
         LOCK2(cs_main, cs_wallet);
         int nInstantSendConfirmationsRequired = Params().GetConsensus().nInstantSendConfirmationsRequired;
 
-        for (std::map<uint256, CWalletTx>::const_iterator it = mapWallet.begin(); it != mapWallet.end(); ++it)
+        EnsureWalletUTXO();
+
+        // Only unspent outputs of the requested type are visited. Outputs of the same
+        // transaction are adjacent, so the transaction is checked once for all of them.
+        std::vector<COutPoint> vecCandidates;
+        GetWalletUTXOCandidates(nCoinType, vecCandidates);
+
+        uint256 hashLast;
+        const CWalletTx* pcoin = NULL; // NULL if the outputs of hashLast can't be used
+        int nDepth = 0;
+        bool safeTx = false;
+        for (const auto& outpoint : vecCandidates)
         {
-            const uint256& wtxid = it->first;
-            const CWalletTx* pcoin = &(*it).second;
+            if (outpoint.hash != hashLast) {
+                hashLast = outpoint.hash;
+                pcoin = NULL;
 
-            if (!CheckFinalTx(*pcoin))
-                continue;
+                std::map<uint256, CWalletTx>::const_iterator it = mapWallet.find(outpoint.hash);
+                if (it == mapWallet.end())
+                    continue;
+                const CWalletTx* ptx = &(*it).second;
 
-            if (pcoin->IsCoinBase() && pcoin->GetBlocksToMaturity() > 0)
-                continue;
+                if (!CheckFinalTx(*ptx))
+                    continue;
 
-            int nDepth = pcoin->GetDepthInMainChain();
-            // do not use IX for inputs that have less then nInstantSendConfirmationsRequired blockchain confirmations
-            if (fUseInstantSend && nDepth < nInstantSendConfirmationsRequired)
-                continue;
+                if (ptx->IsCoinBase() && ptx->GetBlocksToMaturity() > 0)
+                    continue;
 
-            // We should not consider coins which aren't at least in our mempool
-            // It's possible for these to be conflicted via ancestors which we may never be able to detect
-            if (nDepth == 0 && !pcoin->InMempool())
-                continue;
+                nDepth = ptx->GetDepthInMainChain();
+                // do not use IX for inputs that have less then nInstantSendConfirmationsRequired blockchain confirmations
+                if (fUseInstantSend && nDepth < nInstantSendConfirmationsRequired)
+                    continue;
 
-            bool safeTx = pcoin->IsTrusted();
+                // We should not consider coins which aren't at least in our mempool
+                // It's possible for these to be conflicted via ancestors which we may never be able to detect
+                if (nDepth == 0 && !ptx->InMempool())
+                    continue;
 
-            if (fOnlySafe && !safeTx) {
-                continue;
-            }
+                safeTx = ptx->IsTrusted();
 
-            for (unsigned int i = 0; i < pcoin->tx->vout.size(); i++) {
-                bool found = false;
-                if(nCoinType == ONLY_DENOMINATED) {
-                    found = CPrivateSend::IsDenominatedAmount(pcoin->tx->vout[i].nValue);
-                } else if(nCoinType == ONLY_NONDENOMINATED) {
-                    if (CPrivateSend::IsCollateralAmount(pcoin->tx->vout[i].nValue)) continue; // do not use collateral amounts
-                    found = !CPrivateSend::IsDenominatedAmount(pcoin->tx->vout[i].nValue);
-                } else if(nCoinType == ONLY_1000) {
-                    found = pcoin->tx->vout[i].nValue == 10000*COIN;
-                } else if(nCoinType == ONLY_PRIVATESEND_COLLATERAL) {
-                    found = CPrivateSend::IsCollateralAmount(pcoin->tx->vout[i].nValue);
-                } else {
-                    found = true;
+                if (fOnlySafe && !safeTx) {
+                    continue;
                 }
-                if(!found) continue;
-
-                isminetype mine = IsMine(pcoin->tx->vout[i]);
-                if (!(IsSpent(wtxid, i)) && mine != ISMINE_NO &&
-                    (!IsLockedCoin((*it).first, i) || nCoinType == ONLY_1000) &&
-                    (pcoin->tx->vout[i].nValue > 0 || fIncludeZeroValue) &&
-                    (!coinControl || !coinControl->HasSelected() || coinControl->fAllowOtherInputs || coinControl->IsSelected(COutPoint((*it).first, i))))
-                        vCoins.push_back(COutput(pcoin, i, nDepth,
-                                                 ((mine & ISMINE_SPENDABLE) != ISMINE_NO) ||
-                                                  (coinControl && coinControl->fAllowWatchOnly && (mine & ISMINE_WATCH_SOLVABLE) != ISMINE_NO),
-                                                 (mine & (ISMINE_SPENDABLE | ISMINE_WATCH_SOLVABLE)) != ISMINE_NO, safeTx));
+
+                pcoin = ptx;
             }
+            if (pcoin == NULL)
+                continue;
+
+            unsigned int i = outpoint.n;
+            if (i >= pcoin->tx->vout.size())
+                continue;
+
+            isminetype mine = IsMine(pcoin->tx->vout[i]);
+            if (!(IsSpent(outpoint.hash, i)) && mine != ISMINE_NO &&
+                (!IsLockedCoin(outpoint.hash, i) || nCoinType == ONLY_1000) &&
+                (pcoin->tx->vout[i].nValue > 0 || fIncludeZeroValue) &&
+                (!coinControl || !coinControl->HasSelected() || coinControl->fAllowOtherInputs || coinControl->IsSelected(outpoint)))
+                    vCoins.push_back(COutput(pcoin, i, nDepth,
+                                             ((mine & ISMINE_SPENDABLE) != ISMINE_NO) ||
+                                              (coinControl && coinControl->fAllowWatchOnly && (mine & ISMINE_WATCH_SOLVABLE) != ISMINE_NO),
+                                             (mine & (ISMINE_SPENDABLE | ISMINE_WATCH_SOLVABLE)) != ISMINE_NO, safeTx));
         }
     }
 }
@@ -2647,7 +3112,7 @@ bool less_then_denom (const COutput& out1, const COutput& out2)
     return (!found1 && found2);
 }
 
-bool CWallet::SelectCoinsMinConf(const CAmount& nTargetValue, const int nConfMine, const int nConfTheirs, const uint64_t nMaxAncestors, std::vector<COutput> vCoins,
+bool CWallet::SelectCoinsMinConf(const CAmount& nTargetValue, const int nConfMine, const int nConfTheirs, const uint64_t nMaxAncestors, const std::vector<COutput>& vAvailableCoins,
                                  std::set<std::pair<const CWalletTx*,unsigned int> >& setCoinsRet, CAmount& nValueRet, AvailableCoinsType nCoinType, bool fUseInstantSend) const
 {
     setCoinsRet.clear();
@@ -2668,6 +3133,12 @@ bool CWallet::SelectCoinsMinConf(const CAmount& nTargetValue, const int nConfMin
     std::vector<std::pair<CAmount, std::pair<const CWalletTx*,unsigned int> > > vValue;
     CAmount nTotalLower = 0;
 
+    // shuffle and sort pointers, SelectCoins calls this several times with the same coins
+    std::vector<const COutput*> vCoins;
+    vCoins.reserve(vAvailableCoins.size());
+    for (const auto& output : vAvailableCoins)
+        vCoins.push_back(&output);
+
     random_shuffle(vCoins.begin(), vCoins.end(), GetRandInt);
 
     int tryDenomStart = 0;
@@ -2675,7 +3146,7 @@ bool CWallet::SelectCoinsMinConf(const CAmount& nTargetValue, const int nConfMin
 
     if (nCoinType == ONLY_DENOMINATED) {
         // larger denoms first
-        std::sort(vCoins.rbegin(), vCoins.rend(), CompareByPriority());
+        std::sort(vCoins.rbegin(), vCoins.rend(), [](const COutput* a, const COutput* b) { return CompareByPriority()(*a, *b); });
         // we actually want denoms only, so let's skip "non-denom only" step
         tryDenomStart = 1;
         // no change is allowed
@@ -2683,7 +3154,7 @@ bool CWallet::SelectCoinsMinConf(const CAmount& nTargetValue, const int nConfMin
     } else {
         // move denoms down on the list
         // try not to use denominated coins when not needed, save denoms for privatesend
-        std::sort(vCoins.begin(), vCoins.end(), less_then_denom);
+        std::sort(vCoins.begin(), vCoins.end(), [](const COutput* a, const COutput* b) { return less_then_denom(*a, *b); });
     }
 
     // try to find nondenom first to prevent unneeded spending of mixed coins
@@ -2692,8 +3163,9 @@ bool CWallet::SelectCoinsMinConf(const CAmount& nTargetValue, const int nConfMin
         LogPrint("selectcoins", "tryDenom: %d\n", tryDenom);
         vValue.clear();
         nTotalLower = 0;
-        BOOST_FOREACH(const COutput &output, vCoins)
+        for (const COutput* poutput : vCoins)
         {
+            const COutput& output = *poutput;
             if (!output.fSpendable)
                 continue;
 
@@ -3029,6 +3501,8 @@ bool CWallet::SelectCoinsGroupedByAddresses(std::vector<CompactTallyItem>& vecTa
 
     CAmount nSmallestDenom = CPrivateSend::GetSmallestDenomination();
 
+    EnsureWalletUTXO();
+
     // Tally
     std::map<CTxDestination, CompactTallyItem> mapTally;
     std::set<uint256> setWalletTxesCounted;
@@ -3226,7 +3700,9 @@ int CWallet::CountInputsWithAmount(CAmount nInputAmount) const
 
     LOCK2(cs_main, cs_wallet);
 
-    for (const auto& outpoint : setWalletUTXO) {
+    EnsureWalletUTXO();
+    const auto& setCandidates = setWalletUTXOByType[GetWalletUTXOType(nInputAmount)];
+    for (const auto& outpoint : setCandidates) {
         const auto it = mapWallet.find(outpoint.hash);
         if (it == mapWallet.end()) continue;
         if (it->second.tx->vout[outpoint.n].nValue != nInputAmount) continue;
@@ -3872,13 +4348,8 @@ DBErrors CWallet::LoadWallet(bool& fFirstRunRet)
 
     {
         LOCK2(cs_main, cs_wallet);
-        for (auto& pair : mapWallet) {
-            for(unsigned int i = 0; i < pair.second.tx->vout.size(); ++i) {
-                if (IsMine(pair.second.tx->vout[i]) && !IsSpent(pair.first, i)) {
-                    setWalletUTXO.insert(COutPoint(pair.first, i));
-                }
-            }
-        }
+        RebuildWalletUTXO();
+        fBalanceTallyCached = false;
     }
 
     if (nLoadWalletRet != DB_LOAD_OK)
@@ -4581,6 +5052,7 @@ void CWallet::LockCoin(const COutPoint& output)
 
     fAnonymizableTallyCached = false;
     fAnonymizableTallyCachedNonDenom = false;
+    fBalanceTallyCached = false;
 }
 
 void CWallet::UnlockCoin(const COutPoint& output)
@@ -4592,6 +5064,7 @@ void CWallet::UnlockCoin(const COutPoint& output)
 
     fAnonymizableTallyCached = false;
     fAnonymizableTallyCachedNonDenom = false;
+    fBalanceTallyCached = false;
 }
 
 void CWallet::UnlockAllCoins()
@@ -4622,7 +5095,9 @@ void CWallet::ListProTxCoins(std::vector<COutPoint>& vOutpts)
 {
     auto mnList = deterministicMNManager->GetListAtChainTip();
 
+    AssertLockHeld(cs_main);
     AssertLockHeld(cs_wallet);
+    EnsureWalletUTXO();
     for (const auto &o : setWalletUTXO) {
         if (mapWallet.count(o.hash)) {
             const auto &p = mapWallet[o.hash];
@@ -4868,6 +5343,9 @@ std::string CWallet::GetWalletHelpString(bool showDebug)
         strUsage += HelpMessageOpt("-dblogsize=<n>", strprintf("Flush wallet database activity from memory to disk log every <n> megabytes (default: %u)", DEFAULT_WALLET_DBLOGSIZE));
         strUsage += HelpMessageOpt("-flushwallet", strprintf("Run a thread to flush wallet periodically (default: %u)", DEFAULT_FLUSHWALLET));
         strUsage += HelpMessageOpt("-privdb", strprintf("Sets the DB_PRIVATE flag in the wallet db environment (default: %u)", DEFAULT_WALLET_PRIVDB));
+        strUsage += HelpMessageOpt("-rescanthreads=<n>", strprintf("Number of threads reading and matching blocks during a wallet rescan (0 = one per core, max %d, default: %d)", MAX_RESCAN_THREADS, DEFAULT_RESCAN_THREADS));
+        strUsage += HelpMessageOpt("-walletbalancecheck", strprintf("Cross-check the cached wallet balances against a full wallet scan on every request (default: %u)", DEFAULT_WALLET_BALANCE_CHECK));
+        strUsage += HelpMessageOpt("-walletasyncnotify", strprintf("Process block and transaction notifications for the wallet on the scheduler thread, wallet RPCs may briefly lag behind the chain tip (default: %u)", DEFAULT_WALLET_ASYNC_NOTIFY));
         strUsage += HelpMessageOpt("-walletrejectlongchains", strprintf(_("Wallet will not create transactions that violate mempool chain limits (default: %u)"), DEFAULT_WALLET_REJECT_LONG_CHAINS));
     }
 
@@ -5006,7 +5484,7 @@ CWallet* CWallet::CreateWalletFromFile(const std::string walletFile)
 
     LogPrintf(" wallet      %15dms\n", GetTimeMillis() - nStart);
 
-    RegisterValidationInterface(walletInstance);
+    RegisterValidationInterface(walletInstance, GetBoolArg("-walletasyncnotify", DEFAULT_WALLET_ASYNC_NOTIFY));
 
     CBlockIndex *pindexRescan = chainActive.Genesis();
     if (!GetBoolArg("-rescan", false))
@@ -5036,9 +5514,16 @@ CWallet* CWallet::CreateWalletFromFile(const std::string walletFile)
         uiInterface.InitMessage(_("Rescanning..."));
         LogPrintf("Rescanning last %i blocks (from block %i)...\n", chainActive.Height() - pindexRescan->nHeight, pindexRescan->nHeight);
         nStart = GetTimeMillis();
-        walletInstance->ScanForWalletTransactions(pindexRescan, true);
+        CBlockIndex* pindexInterrupted = nullptr;
+        walletInstance->ScanForWalletTransactions(pindexRescan, true, &pindexInterrupted);
         LogPrintf(" rescan      %15dms\n", GetTimeMillis() - nStart);
-        walletInstance->SetBestChain(chainActive.GetLocator());
+        if (pindexInterrupted) {
+            // only record what was scanned, the next start continues from there
+            walletInstance->SetBestChain(pindexInterrupted->pprev ? chainActive.GetLocator(pindexInterrupted->pprev) : CBlockLocator());
+            walletInstance->fRescanIncomplete = true;
+        } else {
+            walletInstance->SetBestChain(chainActive.GetLocator());
+        }
         CWalletDB::IncrementUpdateCounter();
 
         // Restore wallet transaction metadata after -zapwallettxes=1
@@ -5198,6 +5683,8 @@ bool CWallet::ParameterInteraction()
     }
     nTxConfirmTarget = GetArg("-txconfirmtarget", DEFAULT_TX_CONFIRM_TARGET);
     bSpendZeroConfChange = GetBoolArg("-spendzeroconfchange", DEFAULT_SPEND_ZEROCONF_CHANGE);
+    fWalletBalanceCheck = GetBoolArg("-walletbalancecheck", DEFAULT_WALLET_BALANCE_CHECK);
+    nRescanThreads = GetArg("-rescanthreads", DEFAULT_RESCAN_THREADS);
 
     if (IsArgSet("-walletbackupsdir")) {
         if (!boost::filesystem::is_directory(GetArg("-walletbackupsdir", ""))) {
@@ -5403,6 +5890,8 @@ void CWallet::NotifyTransactionLock(const CTransaction &tx)
     // Only notify UI if this transaction is in this wallet
     std::map<uint256, CWalletTx>::const_iterator mi = mapWallet.find(tx.GetHash());
     if (mi != mapWallet.end()){
+        // a lock makes the transaction trusted even without confirmations
+        fBalanceTallyCached = false;
         NotifyISLockReceived();
     }
 }
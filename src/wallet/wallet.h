@@ -43,6 +43,8 @@ extern CWallet* pwalletMain;
 extern CFeeRate payTxFee;
 extern unsigned int nTxConfirmTarget;
 extern bool bSpendZeroConfChange;
+extern bool fWalletBalanceCheck;
+extern int nRescanThreads;
 
 static const unsigned int DEFAULT_KEYPOOL_SIZE = 1000;
 //! -paytxfee default
@@ -64,6 +66,16 @@ static const bool DEFAULT_WALLET_REJECT_LONG_CHAINS = false;
 //! -txconfirmtarget default
 static const unsigned int DEFAULT_TX_CONFIRM_TARGET = 2;
 static const bool DEFAULT_WALLETBROADCAST = true;
+//! Default for -walletbalancecheck
+static const bool DEFAULT_WALLET_BALANCE_CHECK = false;
+//! Default for -walletasyncnotify
+static const bool DEFAULT_WALLET_ASYNC_NOTIFY = false;
+//! -rescanthreads default (0 = one thread per core)
+static const int DEFAULT_RESCAN_THREADS = 0;
+//! Maximum number of rescan worker threads
+static const int MAX_RESCAN_THREADS = 16;
+//! Number of blocks rescan workers may read ahead of the wallet
+static const int RESCAN_PREFETCH_BLOCKS = 64;
 static const bool DEFAULT_DISABLE_WALLET = false;
 
 extern const char * DEFAULT_WALLET_DAT;
@@ -697,6 +709,43 @@ private:
     mutable bool fAnonymizableTallyCachedNonDenom;
     mutable std::vector<CompactTallyItem> vecAnonymizableTallyCachedNonDenom;
 
+    /**
+     * Wallet balances per category. They are tallied in one pass over the wallet the first time
+     * they are requested after the wallet or the chain changed and served from here until then.
+     */
+    struct CBalanceTally
+    {
+        CAmount nBalance = 0;
+        CAmount nUnconfirmed = 0;
+        CAmount nImmature = 0;
+        CAmount nWatchOnly = 0;
+        CAmount nUnconfirmedWatchOnly = 0;
+        CAmount nImmatureWatchOnly = 0;
+        CAmount nAnonymized = 0;
+        CAmount nNormalizedAnonymized = 0;
+        CAmount nDenominated = 0;
+        CAmount nDenominatedUnconfirmed = 0;
+        // the mixing rounds the anonymized balances were tallied for
+        int nPrivateSendRounds = 0;
+        // GetAnonymizableBalance results by (fSkipDenominated, fSkipUnconfirmed), filled on demand
+        std::map<std::pair<bool, bool>, CAmount> mapAnonymizable;
+
+        bool operator==(const CBalanceTally& other) const;
+    };
+    mutable bool fBalanceTallyCached;
+    mutable CBalanceTally balanceTallyCached;
+
+    void TallyBalances(CBalanceTally& tallyRet) const;
+    CBalanceTally& GetBalanceTally() const;
+    CAmount TallyAnonymizableBalance(bool fSkipDenominated, bool fSkipUnconfirmed) const;
+
+    std::atomic<bool> fAbortRescan{false};
+    std::atomic<bool> fScanningWallet{false};
+    //! Set when the startup rescan was interrupted, the best block then stays where the rescan stopped
+    std::atomic<bool> fRescanIncomplete{false};
+
+    bool IsKnownOrSpendsKnown(const CTransaction& tx) const;
+
     /**
      * Used to keep track of spent outpoints, and
      * detect and report conflicts (double-spends or
@@ -707,7 +756,36 @@ private:
     void AddToSpends(const COutPoint& outpoint, const uint256& wtxid);
     void AddToSpends(const uint256& wtxid);
 
-    std::set<COutPoint> setWalletUTXO;
+    /** PrivateSend rounds of wallet outpoints, mirrored in the wallet database */
+    mutable std::map<COutPoint, int> mapOutpointRoundsCache;
+    /** Bumped whenever the rounds cache is dropped, records on disk from older generations are stale */
+    int nPrivateSendRoundsGeneration{0};
+
+    mutable std::set<COutPoint> setWalletUTXO;
+
+    /** Coin types setWalletUTXO is split into, derived from the output amount */
+    enum WalletUTXOType {
+        WALLET_UTXO_DENOMINATED,
+        WALLET_UTXO_COLLATERAL,
+        WALLET_UTXO_MASTERNODE,
+        WALLET_UTXO_OTHER,
+        WALLET_UTXO_TYPE_COUNT
+    };
+    /** setWalletUTXO by coin type. Like setWalletUTXO these hold candidates, whether an output is spendable is checked on use. */
+    mutable std::set<COutPoint> setWalletUTXOByType[WALLET_UTXO_TYPE_COUNT];
+    /** setWalletUTXO must be rebuilt from mapWallet before it is used next, e.g. after keys were imported */
+    mutable bool fWalletUTXODirty;
+
+    static WalletUTXOType GetWalletUTXOType(const CAmount& nValue);
+    void AddWalletUTXO(const COutPoint& outpoint, const CAmount& nValue) const;
+    void EraseWalletUTXO(const COutPoint& outpoint) const;
+    /** Put the outputs spent by wtx back into setWalletUTXO when they became unspent again */
+    void ReaddWalletUTXOSpentBy(const CWalletTx& wtx);
+    void RebuildWalletUTXO() const;
+    /** Rebuild setWalletUTXO if it was marked dirty */
+    void EnsureWalletUTXO() const;
+    /** The outpoints of setWalletUTXO that can match nCoinType, in setWalletUTXO order */
+    void GetWalletUTXOCandidates(AvailableCoinsType nCoinType, std::vector<COutPoint>& vecRet) const;
 
     /* Mark a transaction (and its in-wallet descendants) as conflicting with a particular block. */
     void MarkConflicted(const uint256& hashBlock, const uint256& hashTx);
@@ -806,6 +884,8 @@ public:
         fAnonymizableTallyCachedNonDenom = false;
         vecAnonymizableTallyCached.clear();
         vecAnonymizableTallyCachedNonDenom.clear();
+        fBalanceTallyCached = false;
+        fWalletUTXODirty = false;
     }
 
     std::map<uint256, CWalletTx> mapWallet;
@@ -844,7 +924,7 @@ public:
      * completion the coin set and corresponding actual target value is
      * assembled
      */
-    bool SelectCoinsMinConf(const CAmount& nTargetValue, int nConfMine, int nConfTheirs, uint64_t nMaxAncestors, std::vector<COutput> vCoins, std::set<std::pair<const CWalletTx*,unsigned int> >& setCoinsRet, CAmount& nValueRet, AvailableCoinsType nCoinType=ALL_COINS, bool fUseInstantSend = false) const;
+    bool SelectCoinsMinConf(const CAmount& nTargetValue, int nConfMine, int nConfTheirs, uint64_t nMaxAncestors, const std::vector<COutput>& vCoins, std::set<std::pair<const CWalletTx*,unsigned int> >& setCoinsRet, CAmount& nValueRet, AvailableCoinsType nCoinType=ALL_COINS, bool fUseInstantSend = false) const;
 
     // Coin selection
     bool SelectPSInOutPairsByDenominations(int nDenom, CAmount nValueMin, CAmount nValueMax, std::vector< std::pair<CTxDSIn, CTxOut> >& vecPSInOutPairsRet);
@@ -862,7 +942,13 @@ public:
     int  CountInputsWithAmount(CAmount nInputAmount) const;
 
     // get the PrivateSend chain depth for a given input
-    int GetRealOutpointPrivateSendRounds(const COutPoint& outpoint, int nRounds = 0) const;
+    int GetRealOutpointPrivateSendRounds(const COutPoint& outpoint) const;
+    //! Adds PrivateSend rounds of an outpoint to the cache, without saving them to disk
+    void LoadPrivateSendRounds(const COutPoint& outpoint, int nRounds);
+    //! Sets the PrivateSend rounds cache generation read from disk
+    void LoadPrivateSendRoundsGeneration(int nGeneration);
+    //! Drops all cached PrivateSend rounds. Their records on disk are marked stale and removed on the next load.
+    void ClearPrivateSendRoundsCache();
     // respect current settings
     int GetCappedOutpointPrivateSendRounds(const COutPoint& outpoint) const;
 
@@ -949,7 +1035,10 @@ public:
     bool LoadToWallet(const CWalletTx& wtxIn);
     void SyncTransaction(const CTransaction& tx, const CBlockIndex *pindex, int posInBlock) override;
     bool AddToWalletIfInvolvingMe(const CTransaction& tx, const CBlockIndex* pIndex, int posInBlock, bool fUpdate);
-    CBlockIndex* ScanForWalletTransactions(CBlockIndex* pindexStart, bool fUpdate = false);
+    CBlockIndex* ScanForWalletTransactions(CBlockIndex* pindexStart, bool fUpdate = false, CBlockIndex** ppindexInterrupted = nullptr);
+    void AbortRescan() { fAbortRescan = true; }
+    bool IsAbortingRescan() const { return fAbortRescan; }
+    bool IsScanning() const { return fScanningWallet; }
     void ReacceptWalletTransactions();
     void ResendWalletTransactions(int64_t nBestBlockTime, CConnman* connman) override;
     std::vector<uint256> ResendWalletTransactionsBefore(int64_t nTime, CConnman* connman);
@@ -267,12 +267,15 @@ public:
     bool fAnyUnordered;
     int nFileVersion;
     std::vector<uint256> vWalletUpgrade;
+    int nPrivateSendRoundsGeneration;
+    std::vector<std::pair<COutPoint, std::pair<int, int> > > vPrivateSendRounds;
 
     CWalletScanState() {
         nKeys = nCKeys = nWatchKeys = nKeyMeta = 0;
         fIsEncrypted = false;
         fAnyUnordered = false;
         nFileVersion = 0;
+        nPrivateSendRoundsGeneration = 0;
     }
 };
 
@@ -526,6 +529,19 @@ ReadKeyValue(CWallet* pwallet, CDataStream& ssKey, CDataStream& ssValue,
                 return false;
             }
         }
+        else if (strType == "psrounds")
+        {
+            // (generation, rounds), sorted out once the generation is known
+            COutPoint outpoint;
+            std::pair<int, int> value;
+            ssKey >> outpoint;
+            ssValue >> value;
+            wss.vPrivateSendRounds.emplace_back(outpoint, value);
+        }
+        else if (strType == "psroundsgen")
+        {
+            ssValue >> wss.nPrivateSendRoundsGeneration;
+        }
         else if (strType == "hdchain")
         {
             CHDChain chain;
@@ -671,6 +687,20 @@ DBErrors CWalletDB::LoadWallet(CWallet* pwallet)
     BOOST_FOREACH(uint256 hash, wss.vWalletUpgrade)
         WriteTx(pwallet->mapWallet[hash]);
 
+    // PrivateSend rounds invalidated since they were written are only dropped now
+    pwallet->LoadPrivateSendRoundsGeneration(wss.nPrivateSendRoundsGeneration);
+    size_t nStaleRounds = 0;
+    for (const auto& entry : wss.vPrivateSendRounds) {
+        if (entry.second.first == wss.nPrivateSendRoundsGeneration) {
+            pwallet->LoadPrivateSendRounds(entry.first, entry.second.second);
+        } else {
+            ErasePrivateSendRounds(entry.first);
+            nStaleRounds++;
+        }
+    }
+    if (nStaleRounds > 0)
+        LogPrintf("Dropped %u stale PrivateSend rounds records\n", nStaleRounds);
+
     // Rewrite encrypted wallets of versions 0.4.0 and 0.5.0rc:
     if (wss.fIsEncrypted && (wss.nFileVersion == 40000 || wss.nFileVersion == 50000))
         return DB_NEED_REWRITE;
@@ -897,6 +927,24 @@ bool CWalletDB::EraseDestData(const std::string &address, const std::string &key
     return Erase(std::make_pair(std::string("destdata"), std::make_pair(address, key)));
 }
 
+bool CWalletDB::WritePrivateSendRounds(const COutPoint& outpoint, int nGeneration, int nRounds)
+{
+    nWalletDBUpdateCounter++;
+    return Write(std::make_pair(std::string("psrounds"), outpoint), std::make_pair(nGeneration, nRounds));
+}
+
+bool CWalletDB::ErasePrivateSendRounds(const COutPoint& outpoint)
+{
+    nWalletDBUpdateCounter++;
+    return Erase(std::make_pair(std::string("psrounds"), outpoint));
+}
+
+bool CWalletDB::WritePrivateSendRoundsGeneration(int nGeneration)
+{
+    nWalletDBUpdateCounter++;
+    return Write(std::string("psroundsgen"), nGeneration);
+}
+
 bool CWalletDB::WriteHDChain(const CHDChain& chain)
 {
     nWalletDBUpdateCounter++;
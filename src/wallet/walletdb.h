@@ -24,6 +24,7 @@ class CAccountingEntry;
 struct CBlockLocator;
 class CKeyPool;
 class CMasterKey;
+class COutPoint;
 class CScript;
 class CWallet;
 class CWalletTx;
@@ -124,6 +125,13 @@ public:
     /// Erase destination data tuple from wallet database
     bool EraseDestData(const std::string &address, const std::string &key);
 
+    /// Write the PrivateSend rounds of a wallet outpoint, computed in the given cache generation
+    bool WritePrivateSendRounds(const COutPoint& outpoint, int nGeneration, int nRounds);
+    /// Erase the PrivateSend rounds of a wallet outpoint
+    bool ErasePrivateSendRounds(const COutPoint& outpoint);
+    /// Write the current PrivateSend rounds cache generation, records of other generations are stale
+    bool WritePrivateSendRoundsGeneration(int nGeneration);
+
     CAmount GetAccountCreditDebit(const std::string& strAccount);
     void ListAccountCreditDebit(const std::string& strAccount, std::list<CAccountingEntry>& acentries);
 